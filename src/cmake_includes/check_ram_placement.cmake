@@ -0,0 +1,75 @@
+# CMAKE script (run with -P) for checking symbol placement in the map file
+# Each symbol in SYMBOLS must have been linked from a .time_critical.<symbol>
+# section (from __not_in_flash_func or __not_in_flash) to an SRAM address.
+#
+# Expects:
+#   MAP_FILES        - comma-separated list of candidate map file paths
+#   SYMBOLS          - comma-separated list of symbols to check
+#   OPTIONAL_SYMBOLS - comma-separated list of symbols to check only if they were linked
+
+cmake_minimum_required(VERSION 3.25.1 FATAL_ERROR)
+
+string(REPLACE "," ";" MAP_FILES "${MAP_FILES}")
+string(REPLACE "," ";" SYMBOLS "${SYMBOLS}")
+string(REPLACE "," ";" OPTIONAL_SYMBOLS "${OPTIONAL_SYMBOLS}")
+
+set(MAP_FILE "")
+foreach(candidate IN LISTS MAP_FILES)
+  if(EXISTS "${candidate}")
+    set(MAP_FILE "${candidate}")
+    break()
+  endif()
+endforeach()
+
+if(NOT MAP_FILE)
+  message(FATAL_ERROR "Unable to find the linker map file to verify SRAM placement (looked in: ${MAP_FILES})")
+endif()
+
+file(READ "${MAP_FILE}" MAP_CONTENTS)
+
+# Discarded input sections are listed first with a zero address, so only look
+# at the memory map itself.
+string(FIND "${MAP_CONTENTS}" "Linker script and memory map" MAP_START)
+if(MAP_START GREATER -1)
+  string(SUBSTRING "${MAP_CONTENTS}" ${MAP_START} -1 MAP_CONTENTS)
+endif()
+
+# Finds the address a symbol's section was linked to, from .time_critical.<symbol>, or from
+# .text.<symbol> (in flash) if it lost its marker.  ADDR is left empty if it wasn't linked at all.
+function(find_symbol_section symbol ADDR)
+  set(${ADDR} "" PARENT_SCOPE)
+  foreach(section time_critical text)
+    string(REGEX MATCH "\\.${section}\\.${symbol}[ \t\r\n]+0x([0-9a-fA-F]+)" SECTION_MATCH "${MAP_CONTENTS}")
+    if(SECTION_MATCH)
+      set(${ADDR} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+      return()
+    endif()
+  endforeach()
+endfunction()
+
+# Optional symbols which weren't linked were garbage collected, as nothing in this build uses them.
+set(CHECKED_SYMBOLS "")
+set(MISPLACED_SYMBOLS "")
+foreach(symbol IN LISTS SYMBOLS OPTIONAL_SYMBOLS)
+  find_symbol_section(${symbol} SECTION_ADDR)
+  if(NOT SECTION_ADDR)
+    if(NOT symbol IN_LIST OPTIONAL_SYMBOLS)
+      list(APPEND MISPLACED_SYMBOLS "${symbol} (not found)")
+    endif()
+    continue()
+  endif()
+  list(APPEND CHECKED_SYMBOLS ${symbol})
+
+  # SRAM on the RP2040 starts at 0x20000000.
+  if(NOT SECTION_ADDR MATCHES "^0*2[0-9a-fA-F][0-9a-fA-F][0-9a-fA-F][0-9a-fA-F][0-9a-fA-F][0-9a-fA-F][0-9a-fA-F]$")
+    list(APPEND MISPLACED_SYMBOLS "${symbol} (0x${SECTION_ADDR})")
+  endif()
+endforeach()
+
+if(MISPLACED_SYMBOLS)
+  string(REPLACE ";" "\n  " MISPLACED_SYMBOLS "${MISPLACED_SYMBOLS}")
+  message(FATAL_ERROR "The following symbols were not placed in SRAM:\n  ${MISPLACED_SYMBOLS}")
+endif()
+
+list(LENGTH CHECKED_SYMBOLS SYMBOL_COUNT)
+message("SRAM placement verified for ${SYMBOL_COUNT} symbols in ${MAP_FILE}")
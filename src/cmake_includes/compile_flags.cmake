@@ -1,8 +1,11 @@
 # Common compile options for all targets
 
 target_link_libraries(${PROJECT_NAME} PUBLIC
+  hardware_dma
+  hardware_flash
   hardware_pio
   hardware_pwm
+  pico_multicore
   pico_stdlib
   pico_unique_id
   tinyusb_board
@@ -23,4 +26,7 @@ target_compile_options(${PROJECT_NAME} PUBLIC
   -Wextra
   -Wunused
   -O2
+  # Emit per-function stack usage and call graphs, used to report worst-case stack depth.
+  -fstack-usage
+  -fcallgraph-info=su
 )
\ No newline at end of file
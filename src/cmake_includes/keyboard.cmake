@@ -64,6 +64,10 @@ add_definitions(-D_KEYBOARD_MAKE="${KEYBOARD_MAKE}")
 add_definitions(-D_KEYBOARD_DESCRIPTION="${KEYBOARD_DESCRIPTION}")
 add_definitions(-D_KEYBOARD_MODEL="${KEYBOARD_MODEL}")
 add_definitions(-D_KEYBOARD_PROTOCOL="${KEYBOARD_PROTOCOL}")
+# Also define the protocol as an identifier (e.g. _KEYBOARD_PROTOCOL_AT_PS2) for config.h to check
+string(MAKE_C_IDENTIFIER "${KEYBOARD_PROTOCOL}" KEYBOARD_PROTOCOL_ID)
+string(TOUPPER "${KEYBOARD_PROTOCOL_ID}" KEYBOARD_PROTOCOL_ID)
+add_definitions(-D_KEYBOARD_PROTOCOL_${KEYBOARD_PROTOCOL_ID}=1)
 add_definitions(-D_KEYBOARD_CODESET="${KEYBOARD_CODESET}")
 
 set(REQUIRED_KEYBOARD_FILES
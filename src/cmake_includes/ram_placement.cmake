@@ -0,0 +1,59 @@
+# CMAKE script for verifying SRAM placement when running from flash
+# When RUN_FROM_FLASH is set, only the functions and tables on the input
+# path are placed in SRAM.  This script lists the symbols which must end up
+# there and adds a post-build step which checks them against the map file.
+
+# Only list symbols which can't be inlined away (externally visible functions,
+# IRQ handlers and tables).  Static helpers on the same path are also marked,
+# but will either be inlined into one of these or placed in SRAM alongside them.
+set(RAM_PLACEMENT_SYMBOLS
+  ringbuf_get
+  ringbuf_put
+  ringbuf_is_empty
+  ringbuf_is_full
+  state_word_publish
+  converter_set_state
+  converter_report_error
+  pio_resync
+  flood_guard_byte
+  flood_guard_error
+)
+
+if(KEYBOARD)
+  list(APPEND RAM_PLACEMENT_SYMBOLS
+    keyboard_input_event_handler
+    process_scancode
+    keymap_get_key_val
+    keymap_map
+    keymap_actions
+    handle_keyboard_report
+  )
+endif()
+
+if(MOUSE)
+  list(APPEND RAM_PLACEMENT_SYMBOLS
+    mouse_input_event_handler
+    mouse_event_processor
+    handle_mouse_report
+  )
+endif()
+
+# Symbols only referenced when enabled in config.h, which can't be seen from here.  These are only
+# checked if they were linked at all, so a build without them still passes.
+set(RAM_PLACEMENT_OPTIONAL_SYMBOLS
+  interface_oversample_decode
+  pio_majority_vote
+)
+
+# The pico-sdk writes the map file relative to the link directory, named after the target.
+string(REPLACE ";" "," RAM_PLACEMENT_SYMBOLS "${RAM_PLACEMENT_SYMBOLS}")
+string(REPLACE ";" "," RAM_PLACEMENT_OPTIONAL_SYMBOLS "${RAM_PLACEMENT_OPTIONAL_SYMBOLS}")
+add_custom_command(TARGET ${PROJECT_NAME} POST_BUILD
+  COMMAND ${CMAKE_COMMAND}
+    -DMAP_FILES=${CMAKE_CURRENT_BINARY_DIR}/${PROJECT_NAME}.elf.map,$<TARGET_FILE:${PROJECT_NAME}>.map
+    -DSYMBOLS=${RAM_PLACEMENT_SYMBOLS}
+    -DOPTIONAL_SYMBOLS=${RAM_PLACEMENT_OPTIONAL_SYMBOLS}
+    -P ${CMAKE_SOURCE_DIR}/cmake_includes/check_ram_placement.cmake
+  COMMENT "Verifying SRAM placement of the input path"
+  VERBATIM
+)
@@ -0,0 +1,208 @@
+# CMAKE script (run with -P) for aggregating static stack usage
+# Reads the .ci call graph files written by -fcallgraph-info=su and walks the
+# call tree below each root, summing the largest stack frame chain.  Calls into
+# code without a call graph (such as the precompiled newlib printf), indirect
+# calls, recursion and dynamically sized frames can't be bounded, so these are
+# listed against the root rather than silently counted as zero.
+#
+# Expects:
+#   CALLGRAPH_DIR - directory to search for .ci files
+#   THREAD_ROOTS  - comma-separated list of Core 0 thread entry points (normally main)
+#   CORE1_ROOTS   - comma-separated list of Core 1 thread entry points
+#   ISR_ROOTS     - comma-separated list of interrupt handlers, as <priority>:<root>
+#   REPORT_FILE   - path of the report file to write
+
+cmake_minimum_required(VERSION 3.25.1 FATAL_ERROR)
+
+# Registers stacked by the Cortex-M0+ on exception entry.
+set(EXCEPTION_FRAME_BYTES 32)
+
+string(REPLACE "," ";" THREAD_ROOTS "${THREAD_ROOTS}")
+string(REPLACE "," ";" CORE1_ROOTS "${CORE1_ROOTS}")
+string(REPLACE "," ";" ISR_ROOTS "${ISR_ROOTS}")
+
+file(GLOB_RECURSE CALLGRAPH_FILES "${CALLGRAPH_DIR}/*.ci")
+if(NOT CALLGRAPH_FILES)
+  message(FATAL_ERROR "No call graph files found in ${CALLGRAPH_DIR}, has -fcallgraph-info=su been set?")
+endif()
+
+# Static functions are titled "<file>:<name>", so keep a map from each function
+# name back to its node title(s) for looking up the roots.
+foreach(callgraph IN LISTS CALLGRAPH_FILES)
+  file(STRINGS "${callgraph}" CALLGRAPH_LINES REGEX "^(node|edge): ")
+  foreach(line IN LISTS CALLGRAPH_LINES)
+    if(line MATCHES "^node: { title: \"([^\"]+)\" label: \"([^\"\\\\]+)\\\\n.*\\\\n([0-9]+) bytes \\(([a-z,]+)\\)")
+      set(FRAME_${CMAKE_MATCH_1} ${CMAKE_MATCH_3})
+      list(APPEND TITLES_${CMAKE_MATCH_2} "${CMAKE_MATCH_1}")
+      if(CMAKE_MATCH_4 STREQUAL "dynamic")
+        set(DYNAMIC_${CMAKE_MATCH_1} TRUE)
+      endif()
+    elseif(line MATCHES "^edge: { sourcename: \"([^\"]+)\" targetname: \"([^\"]+)\"")
+      list(APPEND CALLS_${CMAKE_MATCH_1} "${CMAKE_MATCH_2}")
+    endif()
+  endforeach()
+endforeach()
+
+# Computes the worst-case stack depth below a node, memoised in global properties
+# as DEPTH_<node>, along with the deepest callee and anything left unbounded.
+function(stack_depth node path)
+  get_property(done GLOBAL PROPERTY DEPTH_${node} SET)
+  if(done)
+    return()
+  endif()
+
+  if(NOT DEFINED FRAME_${node})
+    set_property(GLOBAL PROPERTY DEPTH_${node} 0)
+    if(node STREQUAL "__indirect_call")
+      set_property(GLOBAL PROPERTY UNBOUNDED_${node} "indirect call")
+    else()
+      set_property(GLOBAL PROPERTY UNBOUNDED_${node} "${node} (no call graph)")
+    endif()
+    return()
+  endif()
+
+  set(worst 0)
+  set(worst_callee "")
+  set(unbounded "")
+  if(DYNAMIC_${node})
+    list(APPEND unbounded "${node} (dynamic frame)")
+  endif()
+
+  list(APPEND path "${node}")
+  list(REMOVE_DUPLICATES CALLS_${node})
+  foreach(callee IN LISTS CALLS_${node})
+    if(callee IN_LIST path)
+      list(APPEND unbounded "${callee} (recursive)")
+      continue()
+    endif()
+    stack_depth("${callee}" "${path}")
+    get_property(depth GLOBAL PROPERTY DEPTH_${callee})
+    get_property(callee_unbounded GLOBAL PROPERTY UNBOUNDED_${callee})
+    list(APPEND unbounded ${callee_unbounded})
+    if(depth GREATER worst)
+      set(worst ${depth})
+      set(worst_callee "${callee}")
+    endif()
+  endforeach()
+
+  math(EXPR depth "${FRAME_${node}} + ${worst}")
+  list(REMOVE_DUPLICATES unbounded)
+  set_property(GLOBAL PROPERTY DEPTH_${node} ${depth})
+  set_property(GLOBAL PROPERTY WORST_${node} "${worst_callee}")
+  set_property(GLOBAL PROPERTY UNBOUNDED_${node} "${unbounded}")
+endfunction()
+
+# Reports a single root, appending to REPORT and setting <result> to its depth.
+# A root given as <dispatcher>+<callback> stacks the callback's depth on the
+# dispatcher's, as the call between them is made through a pointer.  A root
+# ending in ? is only built when enabled in config.h, so is skipped if absent.
+function(report_root root extra_bytes result)
+  set(${result} 0 PARENT_SCOPE)
+  string(REGEX REPLACE "\\?$" "" name "${root}")
+  string(REPLACE "+" ";" parts "${name}")
+  foreach(part IN LISTS parts)
+    list(LENGTH TITLES_${part} title_count)
+    if(title_count EQUAL 0)
+      if(name STREQUAL root)
+        message(WARNING "No call graph found for '${part}'")
+      endif()
+      return()
+    endif()
+  endforeach()
+
+  set(depth ${extra_bytes})
+  set(chain "")
+  set(unbounded "")
+  foreach(part IN LISTS parts)
+    list(GET TITLES_${part} 0 node)
+    stack_depth("${node}" "")
+    get_property(part_depth GLOBAL PROPERTY DEPTH_${node})
+    get_property(part_unbounded GLOBAL PROPERTY UNBOUNDED_${node})
+    math(EXPR depth "${depth} + ${part_depth}")
+    list(APPEND unbounded ${part_unbounded})
+
+    # Walk the deepest chain for the report.
+    set(current "${node}")
+    while(current)
+      string(REGEX REPLACE "^.*:" "" current_name "${current}")
+      list(APPEND chain "${current_name}")
+      get_property(current GLOBAL PROPERTY WORST_${current})
+    endwhile()
+  endforeach()
+  string(REPLACE ";" " > " chain "${chain}")
+  list(REMOVE_DUPLICATES unbounded)
+
+  set(${result} ${depth} PARENT_SCOPE)
+
+  # A root which can run at several priorities is only listed once.
+  get_property(reported GLOBAL PROPERTY REPORTED_${name} SET)
+  if(reported)
+    return()
+  endif()
+  set_property(GLOBAL PROPERTY REPORTED_${name} TRUE)
+
+  string(REPLACE ";" " + " name "${parts}")
+  string(APPEND REPORT "${name}: ${depth} bytes\n  deepest: ${chain}\n")
+  if(unbounded)
+    string(REPLACE ";" ", " unbounded "${unbounded}")
+    string(APPEND REPORT "  unbounded: ${unbounded}\n")
+  endif()
+  set(REPORT "${REPORT}" PARENT_SCOPE)
+endfunction()
+
+set(REPORT "")
+
+set(THREAD_DEPTH 0)
+foreach(root IN LISTS THREAD_ROOTS)
+  report_root(${root} 0 depth)
+  if(depth GREATER THREAD_DEPTH)
+    set(THREAD_DEPTH ${depth})
+  endif()
+endforeach()
+
+# The Cortex-M0+ only implements the top two bits of each priority, giving four
+# levels.  Handlers at the same level can't preempt each other, so only the
+# deepest at each level can be stacked, but each level can preempt those below.
+set(LEVEL_PRIORITIES 0x00 0x40 0x80 0xC0)
+set(ISR_DEPTH 0)
+foreach(level RANGE 3)
+  set(LEVEL_DEPTH 0)
+  set(LEVEL_ROOT "")
+  foreach(entry IN LISTS ISR_ROOTS)
+    string(REGEX MATCH "^(0x[0-9A-Fa-f]+):(.+)$" _ "${entry}")
+    set(root "${CMAKE_MATCH_2}")
+    math(EXPR entry_level "(${CMAKE_MATCH_1} >> 6) & 3")
+    if(NOT entry_level EQUAL level)
+      continue()
+    endif()
+    report_root(${root} ${EXCEPTION_FRAME_BYTES} depth)
+    if(depth GREATER LEVEL_DEPTH)
+      set(LEVEL_DEPTH ${depth})
+      string(REGEX REPLACE "\\?$" "" LEVEL_ROOT "${root}")
+      string(REPLACE "+" " + " LEVEL_ROOT "${LEVEL_ROOT}")
+    endif()
+  endforeach()
+  if(LEVEL_DEPTH GREATER 0)
+    list(GET LEVEL_PRIORITIES ${level} level_priority)
+    string(APPEND REPORT "Priority ${level_priority} worst case: ${LEVEL_DEPTH} bytes (${LEVEL_ROOT})\n")
+    math(EXPR ISR_DEPTH "${ISR_DEPTH} + ${LEVEL_DEPTH}")
+  endif()
+endforeach()
+
+math(EXPR TOTAL_DEPTH "${THREAD_DEPTH} + ${ISR_DEPTH}")
+string(APPEND REPORT "Core 0 worst case (excluding unbounded calls): ${TOTAL_DEPTH} bytes\n")
+
+# Core 1 takes no interrupts, so its worst case is its deepest thread alone.
+set(CORE1_DEPTH 0)
+foreach(root IN LISTS CORE1_ROOTS)
+  report_root(${root} 0 depth)
+  if(depth GREATER CORE1_DEPTH)
+    set(CORE1_DEPTH ${depth})
+  endif()
+endforeach()
+if(CORE1_DEPTH GREATER 0)
+  string(APPEND REPORT "Core 1 worst case (excluding unbounded calls): ${CORE1_DEPTH} bytes\n")
+endif()
+
+file(WRITE "${REPORT_FILE}" "${REPORT}")
+message("${REPORT}Stack usage report written to ${REPORT_FILE}")
@@ -0,0 +1,63 @@
+# CMAKE script for reporting static stack usage
+# Every source is compiled with -fstack-usage and -fcallgraph-info=su, so each
+# object has a call graph annotated with per-function stack frame sizes.  This
+# adds a post-build step which aggregates these into a worst-case stack depth
+# for the main loop and each interrupt handler call tree.
+
+# The priority of each interrupt source is read from config.h, as handlers
+# can only be stacked on top of those at a lower priority.
+file(STRINGS "${CMAKE_SOURCE_DIR}/config.h" IRQ_PRIORITY_DEFINES
+  REGEX "^#define CONVERTER_IRQ_PRIORITY_[A-Z]+ +0x[0-9A-Fa-f]+"
+)
+foreach(line IN LISTS IRQ_PRIORITY_DEFINES)
+  string(REGEX MATCH "^#define CONVERTER_IRQ_PRIORITY_([A-Z]+) +(0x[0-9A-Fa-f]+)" _ "${line}")
+  set(IRQ_PRIORITY_${CMAKE_MATCH_1} ${CMAKE_MATCH_2})
+endforeach()
+
+# The main loop is the thread root on Core 0.  Core 1 only runs while a
+# Firmware Update (CONVERTER_FW_UPDATE) is being programmed, with no
+# interrupts enabled, so its thread is reported on its own.
+set(STACK_USAGE_THREAD_ROOTS main)
+set(STACK_USAGE_CORE1_ROOTS fw_update_core1?)
+
+# Interrupt handler roots, as <priority>:<root>.  Handlers which dispatch to a
+# callback through a pointer are given as <dispatcher>+<callback>, so the
+# callback's depth is stacked on the dispatcher's.  Roots ending in ? are only
+# built when enabled in config.h, and are skipped when absent.
+set(STACK_USAGE_ISR_ROOTS
+  # TinyUSB's USB Controller handler, which also runs the tud_* callbacks.
+  ${IRQ_PRIORITY_USB}:dcd_rp2040_irq
+  # The default alarm pool, which runs the Buzzer's sequence callbacks.
+  ${IRQ_PRIORITY_HOUSEKEEPING}:alarm_pool_irq_handler+_buzzer_non_blocking_callback?
+  # The Load Generator's hardware alarm (CONVERTER_LOADGEN).
+  ${IRQ_PRIORITY_PIO}:hardware_alarm_irq_handler+loadgen_alarm_callback?
+)
+# No DMA completion handlers are installed, as every DMA transfer is polled.
+
+# The IRQ latency probe (CONVERTER_IRQ_STATS) cycles through every priority.
+foreach(priority IN ITEMS ${IRQ_PRIORITY_PIO} ${IRQ_PRIORITY_USB} ${IRQ_PRIORITY_HOUSEKEEPING})
+  list(APPEND STACK_USAGE_ISR_ROOTS ${priority}:hardware_alarm_irq_handler+irq_probe_callback?)
+endforeach()
+
+if(KEYBOARD)
+  list(APPEND STACK_USAGE_ISR_ROOTS ${IRQ_PRIORITY_PIO}:keyboard_input_event_handler)
+endif()
+
+if(MOUSE)
+  list(APPEND STACK_USAGE_ISR_ROOTS ${IRQ_PRIORITY_PIO}:mouse_input_event_handler)
+endif()
+
+string(REPLACE ";" "," STACK_USAGE_THREAD_ROOTS "${STACK_USAGE_THREAD_ROOTS}")
+string(REPLACE ";" "," STACK_USAGE_CORE1_ROOTS "${STACK_USAGE_CORE1_ROOTS}")
+string(REPLACE ";" "," STACK_USAGE_ISR_ROOTS "${STACK_USAGE_ISR_ROOTS}")
+add_custom_command(TARGET ${PROJECT_NAME} POST_BUILD
+  COMMAND ${CMAKE_COMMAND}
+    -DCALLGRAPH_DIR=${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${PROJECT_NAME}.dir
+    -DTHREAD_ROOTS=${STACK_USAGE_THREAD_ROOTS}
+    -DCORE1_ROOTS=${STACK_USAGE_CORE1_ROOTS}
+    -DISR_ROOTS=${STACK_USAGE_ISR_ROOTS}
+    -DREPORT_FILE=$<TARGET_FILE_DIR:${PROJECT_NAME}>/${PROJECT_NAME}.stack_usage.txt
+    -P ${CMAKE_SOURCE_DIR}/cmake_includes/report_stack_usage.cmake
+  COMMENT "Aggregating static stack usage"
+  VERBATIM
+)
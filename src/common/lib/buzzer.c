@@ -23,14 +23,20 @@
 
 #include "buzzer.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "config.h"
 #include "hardware/clocks.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 #include "hardware/sync.h"
 #include "pico/time.h"
 
+#ifdef CONVERTER_TIMELINE
+#include "timeline.h"
+#endif
+
 #define TOP_MAX 65534
 
 note READY_SEQUENCE[] = {
@@ -55,6 +61,26 @@ struct non_blocking_seq {
 
 static volatile uint running_non_blocking_sequences = 0;
 
+#ifdef CONVERTER_KEYCLICK
+// Keyclick sound profiles, indexed by keyclick_class.  Each click is a short burst of a single tone,
+// with the frequency and duration tuned per class of key.
+static struct {
+  uint freq;             // Frequency of the click in Hz.
+  uint32_t duration_us;  // Duration of the click in microseconds.
+  sound s;               // Pre-calculated PWM parameters, set up by buzzer_init().
+} keyclick_profiles[KEYCLICK_CLASS_COUNT] = {
+    [KEYCLICK_NORMAL] = {CONVERTER_KEYCLICK_FREQ, CONVERTER_KEYCLICK_DURATION_US, 0},
+    [KEYCLICK_MODIFIER] = {CONVERTER_KEYCLICK_FREQ * 3 / 4, CONVERTER_KEYCLICK_DURATION_US / 2, 0},
+    [KEYCLICK_LARGE] = {CONVERTER_KEYCLICK_FREQ / 2, CONVERTER_KEYCLICK_DURATION_US * 2, 0},
+};
+
+// Pending Keyclick trigger.  This is 0 when idle, otherwise the triggered keyclick_class + 1.  It is
+// only ever written with a single byte store, so triggering is lock-free and safe from any context.
+static volatile uint8_t keyclick_pending = 0;
+static int keyclick_playing = -1;  // keyclick_class currently playing, or -1 if idle.
+static uint32_t keyclick_end_us = 0;
+#endif
+
 /*
  * Private Functions
  */
@@ -144,6 +170,9 @@ static int64_t _buzzer_non_blocking_callback(alarm_id_t id, void *user_data) {
   (void)id;
 
   struct non_blocking_seq *call = (struct non_blocking_seq *)user_data;
+#ifdef CONVERTER_TIMELINE
+  timeline_record(TIMELINE_BUZZER_ALARM, (uint8_t)call->current);
+#endif
 
   if (call->callid == curr_playing_id) {
     buzzer_stop_sound();
@@ -183,6 +212,7 @@ static int64_t _buzzer_non_blocking_callback(alarm_id_t id, void *user_data) {
  *         If the frequency is invalid, returns 0.
  */
 sound buzzer_calc_sound(uint freq) {
+  if (freq == 0) return 0;  // A rest between notes.
   uint32_t source_hz = clock_get_hz(clk_sys);
 
   // div is a 12 bit decimal fixed point number 8(integer).4(fractional)
@@ -239,6 +269,12 @@ void buzzer_init(uint buzzer_gpio) {
 
   buzzer_calc_sound_sequence(READY_SEQUENCE, READY_SEQUENCE);
   buzzer_calc_sound_sequence(LOCK_LED, LOCK_LED);
+
+#ifdef CONVERTER_KEYCLICK
+  for (int i = 0; i < KEYCLICK_CLASS_COUNT; i++) {
+    keyclick_profiles[i].s = buzzer_calc_sound(keyclick_profiles[i].freq);
+  }
+#endif
 }
 
 /**
@@ -257,10 +293,10 @@ bool buzzer_play_sound_sequence_non_blocking(note *notes) {
     curr_playing_id = rand();
     struct non_blocking_seq *call =
         (struct non_blocking_seq *)malloc(sizeof(struct non_blocking_seq));
+    if (call == NULL) return false;
     call->callid = curr_playing_id;
     call->current = 0;
     call->notes = notes;
-    if (call == NULL) return false;
 
     uint32_t state = save_and_disable_interrupts();
     ++running_non_blocking_sequences;
@@ -277,4 +313,46 @@ bool buzzer_play_sound_sequence_non_blocking(note *notes) {
     }
   }
   return true;
-}
\ No newline at end of file
+}
+
+#ifdef CONVERTER_KEYCLICK
+/**
+ * @brief Triggers a Keyclick for the given class of key.
+ * This only records the trigger, so it costs a single store and never blocks or allocates.  The
+ * click itself is started by buzzer_task() from the main loop.  If several keys are triggered before
+ * buzzer_task() runs, they are merged into a single click using the most recent key class.
+ *
+ * @param key_class The class of key which was pressed.
+ */
+void buzzer_keyclick(keyclick_class key_class) { keyclick_pending = (uint8_t)(key_class + 1); }
+
+/**
+ * @brief Task function for the Keyclick feedback engine.
+ * This starts any pending Keyclick and stops the current one once its duration has elapsed.  A new
+ * trigger received while a click of the same class is playing simply extends the click, otherwise
+ * the click is retriggered with the new profile.  Clicks are dropped while a sound sequence (such as
+ * the Lock LED beep) is playing, as they share the same PWM slice.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void buzzer_task(void) {
+  uint8_t pending = keyclick_pending;
+  if (pending) {
+    keyclick_pending = 0;
+    if (running_non_blocking_sequences == 0) {
+      int key_class = pending - 1;
+      if (key_class != keyclick_playing) {
+        buzzer_play_sound(keyclick_profiles[key_class].s);
+        keyclick_playing = key_class;
+      }
+      keyclick_end_us = time_us_32() + keyclick_profiles[key_class].duration_us;
+    }
+  }
+
+  if (keyclick_playing >= 0 && (int32_t)(time_us_32() - keyclick_end_us) >= 0) {
+    if (running_non_blocking_sequences == 0) buzzer_stop_sound();
+    keyclick_playing = -1;
+  }
+}
+
+#endif
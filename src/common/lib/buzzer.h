@@ -39,8 +39,18 @@ extern note LOCK_LED[];
 #define BUZZER_END_SEQUENCE \
   { 0, 0 }
 
+// Key classes used to select the Keyclick sound profile.
+typedef enum {
+  KEYCLICK_NORMAL,
+  KEYCLICK_MODIFIER,
+  KEYCLICK_LARGE,
+  KEYCLICK_CLASS_COUNT,
+} keyclick_class;
+
 sound buzzer_calc_sound(uint freq);
 void buzzer_init(uint buzzer_pin);
 bool buzzer_play_sound_sequence_non_blocking(note *notes);
+void buzzer_keyclick(keyclick_class key_class);
+void buzzer_task(void);
 
 #endif /* BUZZER_H */
\ No newline at end of file
@@ -0,0 +1,112 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "event_stamps.h"
+
+#include <string.h>
+
+#include "hardware/timer.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+
+#define EVENT_STAMPS_QUEUE_MASK (CONVERTER_EVENT_STAMPS_QUEUE - 1)
+
+static event_stamp_t event_queue[CONVERTER_EVENT_STAMPS_QUEUE];
+static uint8_t event_head = 0;      // Total number of events queued
+static uint8_t event_tail = 0;      // Total number of events sent
+static uint8_t event_seq = 0;       // Sequence number of the next event
+static uint16_t event_dropped = 0;  // Events dropped since the last packet, as the queue was full
+
+/**
+ * @brief Records the timestamps of a HID report.
+ * The event is queued for event_stamps_task() to send to the host.  If the host hasn't kept up and
+ * the queue is full, the event is dropped and counted, but still takes a sequence number, so the
+ * host can tell exactly which events are missing.
+ *
+ * @param source    The device the event came from.
+ * @param frame_us  The time the (final) frame of the event was received.
+ * @param decode_us The time the event was decoded into a HID keycode or mouse movement.
+ * @param code      Source specific code, see event_stamp_source_t.
+ * @param make      true if a key was pressed, or any Mouse button is held.
+ * @param accepted  true if the report was accepted by the USB stack.
+ *
+ * @note This is only called from task context, so the queue needs no locking.
+ */
+void __not_in_flash_func(event_stamps_record)(event_stamp_source_t source, uint32_t frame_us,
+                                              uint32_t decode_us, uint8_t code, bool make,
+                                              bool accepted) {
+  uint32_t submit_us = time_us_32();
+  uint8_t seq = event_seq++;
+
+  if ((uint8_t)(event_head - event_tail) >= CONVERTER_EVENT_STAMPS_QUEUE) {
+    if (event_dropped < UINT16_MAX) event_dropped++;
+    return;
+  }
+
+  event_stamp_t *event = &event_queue[event_head & EVENT_STAMPS_QUEUE_MASK];
+  event->source = (uint8_t)source;
+  event->flags = (uint8_t)((make ? EVENT_STAMP_MAKE : 0) | (accepted ? EVENT_STAMP_ACCEPTED : 0));
+  event->code = code;
+  event->seq = seq;
+  event->frame_us = frame_us;
+  event->decode_us = decode_us;
+  event->submit_us = submit_us;
+  event_head++;
+}
+
+/**
+ * @brief Sends any queued events to the host.
+ * Up to EVENT_STAMPS_PER_PACKET events are packed into each packet, whenever the vendor interface
+ * is ready.  Each packet starts with an 8 byte header:
+ * - [0] EVENT_STAMPS_PACKET_ID
+ * - [1] Number of events in the packet
+ * - [2..3] Number of events dropped since the previous packet
+ * - [4..7] Device time the packet was sent, from time_us_32(), for aligning the device and host
+ *   clocks
+ *
+ * Events are only dropped (rather than held until the host opens the interface) once the queue is
+ * full, so the first packet after the host starts reading may carry events from some time ago.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void event_stamps_task(void) {
+  if (event_head == event_tail && !event_dropped) return;
+
+  uint8_t instance = usb_hid_report_instance(REPORT_ID_VENDOR);
+  if (instance == USB_HID_INSTANCE_NONE || !tud_hid_n_ready(instance)) return;
+
+  uint8_t packet[EVENT_STAMPS_PACKET_SIZE] = {0};
+  uint8_t count = 0;
+  while (count < EVENT_STAMPS_PER_PACKET && event_tail != event_head) {
+    memcpy(&packet[8 + count * sizeof(event_stamp_t)],
+           &event_queue[event_tail & EVENT_STAMPS_QUEUE_MASK], sizeof(event_stamp_t));
+    event_tail++;
+    count++;
+  }
+
+  uint32_t now_us = time_us_32();
+  packet[0] = EVENT_STAMPS_PACKET_ID;
+  packet[1] = count;
+  packet[2] = (uint8_t)(event_dropped & 0xFF);
+  packet[3] = (uint8_t)(event_dropped >> 8);
+  for (int i = 0; i < 4; i++) packet[4 + i] = (uint8_t)(now_us >> (i * 8));
+
+  if (tud_hid_n_report(instance, 0, packet, sizeof(packet))) event_dropped = 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENT_STAMPS_H
+#define EVENT_STAMPS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Size of each packet sent to the host on the vendor interface.
+#define EVENT_STAMPS_PACKET_SIZE 64
+
+// First byte of each Event Stamp packet.  Firmware Update replies share the vendor interface, and
+// always echo a command below 0x80.
+#define EVENT_STAMPS_PACKET_ID 0x80
+
+// Number of events carried in each packet, after the 8 byte header.
+#define EVENT_STAMPS_PER_PACKET 3
+
+// Source of each event, in the first byte of each event.
+typedef enum {
+  EVENT_STAMP_KEYBOARD,  // Keyboard, Consumer or System report (code: HID keycode)
+  EVENT_STAMP_MOUSE,     // Mouse report (code: button bitmap)
+} event_stamp_source_t;
+
+// Flags of each event, in the second byte of each event.
+enum {
+  EVENT_STAMP_MAKE = 1u << 0,      // Key pressed, or any Mouse button held
+  EVENT_STAMP_ACCEPTED = 1u << 1,  // Report accepted by the USB stack
+};
+
+// Each event as sent to the host, 16 bytes, little endian.  All times are from time_us_32().
+typedef struct __attribute__((packed)) {
+  uint8_t source;      // event_stamp_source_t
+  uint8_t flags;       // EVENT_STAMP_* flags
+  uint8_t code;        // Source specific code
+  uint8_t seq;         // Incremented for every event recorded, including any dropped
+  uint32_t frame_us;   // Time the frame was received by the PIO IRQ handler
+  uint32_t decode_us;  // Time the scancode or packet was decoded
+  uint32_t submit_us;  // Time the HID report was submitted to the USB stack
+} event_stamp_t;
+
+void event_stamps_record(event_stamp_source_t source, uint32_t frame_us, uint32_t decode_us,
+                         uint8_t code, bool make, bool accepted);
+void event_stamps_task(void);
+
+#endif /* EVENT_STAMPS_H */
@@ -0,0 +1,180 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "flood_guard.h"
+
+#include <stdio.h>
+
+#include "bsp/board.h"
+#include "led_helper.h"
+#include "pio_helper.h"
+
+static uint8_t flood_guard_ports = 0;  // Number of ports currently inhibited
+
+/**
+ * @brief Initialises the guard of a device port.
+ * This should be called once the port's interface program has been loaded, as the guard restarts
+ * the program when it releases the port.  It is called again whenever the interface program is
+ * moved to another port, which releases the old port if it was inhibited.
+ *
+ * @param guard     The guard to initialise.
+ * @param name      The name of the port, for reporting.
+ * @param pio       The PIO instance running the port's interface program.
+ * @param sm        The state machine running the port's interface program.
+ * @param offset    The offset the interface program is restarted from.
+ * @param clock_pin The CLK pin of the port.
+ * @param max_bytes The bytes allowed within each CONVERTER_FLOOD_WINDOW_MS window before the port
+ *                  is inhibited.
+ */
+void flood_guard_init(flood_guard_t *guard, const char *name, PIO pio, uint sm, uint offset,
+                      uint clock_pin, uint16_t max_bytes) {
+  if (guard->reported && --flood_guard_ports == 0) {
+    converter_set_state(CONVERTER_PORT_FLOODED, false);
+  }
+  *guard = (flood_guard_t){
+      .name = name,
+      .pio = pio,
+      .sm = sm,
+      .offset = offset,
+      .clock_pin = clock_pin,
+      .max_bytes = max_bytes,
+      .backoff_ms = CONVERTER_FLOOD_BACKOFF_MS,
+  };
+}
+
+/**
+ * @brief Inhibits a port.
+ * The state machine is stopped, and CLK is held LOW, which AT/PS2 devices treat as the host
+ * inhibiting communication, and XT Keyboards treat as a reset request.  Either way the device stops
+ * sending, so the IRQ handler is no longer entered for each byte.  Anything left in the RX FIFO is
+ * discarded by the IRQ handler, and the rest is left to flood_guard_task().
+ *
+ * @param guard The guard of the port to inhibit.
+ */
+static void __not_in_flash_func(flood_guard_trip)(flood_guard_t *guard) {
+  uint32_t clock_mask = 1u << guard->clock_pin;
+  guard->tripped = true;
+  pio_sm_set_enabled(guard->pio, guard->sm, false);
+  pio_sm_set_pins_with_mask(guard->pio, guard->sm, 0, clock_mask);
+  pio_sm_set_pindirs_with_mask(guard->pio, guard->sm, clock_mask, clock_mask);
+}
+
+/**
+ * @brief Counts a byte received on a port, inhibiting the port if it has exceeded its byte rate.
+ * This should be called for every frame read from the port's RX FIFO, before it is validated.
+ *
+ * @param guard The guard of the port.
+ *
+ * @return true if the byte should be processed, false if the port is inhibited and the byte should
+ *         be dropped.
+ *
+ * @note This is safe to call from IRQ context, and never prints.
+ */
+bool __not_in_flash_func(flood_guard_byte)(flood_guard_t *guard) {
+  if (guard->tripped) return false;
+
+  uint32_t now_us = time_us_32();
+  if (now_us - guard->window_us >= CONVERTER_FLOOD_WINDOW_MS * 1000u) {
+    guard->window_us = now_us;
+    guard->bytes = 0;
+    guard->errors = 0;
+  }
+  if (++guard->bytes > guard->max_bytes) {
+    flood_guard_trip(guard);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Counts a receive error on a port, inhibiting the port if errors are arriving in a burst.
+ * This should be called before any error message is printed, or any recovery (a Resend command or
+ * a restart of the state machine) is attempted, as neither should be done once the port is
+ * inhibited.
+ *
+ * @param guard The guard of the port.
+ *
+ * @return true if the error should be recovered from as normal, false if the port is inhibited.
+ *
+ * @note This is safe to call from IRQ context, and never prints.
+ */
+bool __not_in_flash_func(flood_guard_error)(flood_guard_t *guard) {
+  if (guard->tripped) return false;
+
+  if (++guard->errors > CONVERTER_FLOOD_MAX_ERRORS) {
+    flood_guard_trip(guard);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Task function for the guard of a port.
+ * A newly inhibited port is reported, and released once its backoff interval has elapsed.  The
+ * backoff interval doubles each time a port trips again within CONVERTER_FLOOD_RECOVER_MS of being
+ * released, up to CONVERTER_FLOOD_BACKOFF_MAX_MS, so a device which has failed outright costs next
+ * to nothing, while one which only glitched is back in service quickly.  When released, the port's
+ * interface program is restarted, and the caller should re-initialise the device.
+ *
+ * @param guard The guard of the port.
+ *
+ * @return true while the port is inhibited, false otherwise.
+ *
+ * @note This should be called at the start of the port's interface task, which should do no other
+ *       work with the port while it is inhibited.
+ */
+bool flood_guard_task(flood_guard_t *guard) {
+  if (!guard->tripped) return false;
+
+  uint32_t now_ms = board_millis();
+  if (!guard->reported) {
+    if (guard->trip_count && now_ms - guard->release_ms < CONVERTER_FLOOD_RECOVER_MS) {
+      guard->backoff_ms *= 2;
+      if (guard->backoff_ms > CONVERTER_FLOOD_BACKOFF_MAX_MS) {
+        guard->backoff_ms = CONVERTER_FLOOD_BACKOFF_MAX_MS;
+      }
+    } else {
+      guard->backoff_ms = CONVERTER_FLOOD_BACKOFF_MS;
+    }
+    guard->release_ms = now_ms + guard->backoff_ms;
+    guard->trip_count++;
+    guard->reported = true;
+    if (flood_guard_ports++ == 0) converter_set_state(CONVERTER_PORT_FLOODED, true);
+    printf("[WARN] %s Port flooded (%u bytes, %u errors within %ums), inhibited for %lums (%lu "
+           "trips)\n",
+           guard->name, guard->bytes, guard->errors, CONVERTER_FLOOD_WINDOW_MS,
+           (unsigned long)guard->backoff_ms, (unsigned long)guard->trip_count);
+    return true;
+  }
+
+  if ((int32_t)(now_ms - guard->release_ms) < 0) return true;
+
+  printf("[INFO] Releasing %s Port\n", guard->name);
+  pio_sm_set_pindirs_with_mask(guard->pio, guard->sm, 0, 1u << guard->clock_pin);
+  pio_restart(guard->pio, guard->sm, guard->offset);
+  guard->window_us = time_us_32();
+  guard->bytes = 0;
+  guard->errors = 0;
+  guard->reported = false;
+  guard->tripped = false;
+  pio_sm_set_enabled(guard->pio, guard->sm, true);
+  if (--flood_guard_ports == 0) converter_set_state(CONVERTER_PORT_FLOODED, false);
+  return false;
+}
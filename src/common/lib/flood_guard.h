@@ -0,0 +1,64 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOOD_GUARD_H
+#define FLOOD_GUARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "hardware/pio.h"
+
+// Tracks the traffic received on a single device port, so a port which floods the converter with
+// bytes or receive errors can be inhibited, without holding up the other ports or USB.
+typedef struct {
+  const char *name;       // Name of the port, for reporting
+  PIO pio;                // PIO instance running the port's interface program
+  uint sm;                // State machine running the port's interface program
+  uint offset;            // Offset the interface program is restarted from
+  uint clock_pin;         // CLK pin, which is held LOW while the port is inhibited
+  uint16_t max_bytes;     // Bytes allowed within each window before the port is inhibited
+  uint32_t window_us;     // Start of the current counting window
+  uint16_t bytes;         // Bytes received within the current window
+  uint16_t errors;        // Receive errors within the current window
+  volatile bool tripped;  // Set once the port is inhibited, until it is released again
+  bool reported;          // Whether the current trip has been reported
+  uint32_t backoff_ms;    // Interval the port is inhibited for on its current (or last) trip
+  uint32_t trip_count;    // Total number of trips since power on
+  uint32_t release_ms;    // Time the port is due to be (or was last) released
+} flood_guard_t;
+
+void flood_guard_init(flood_guard_t *guard, const char *name, PIO pio, uint sm, uint offset,
+                      uint clock_pin, uint16_t max_bytes);
+bool flood_guard_byte(flood_guard_t *guard);
+bool flood_guard_error(flood_guard_t *guard);
+bool flood_guard_task(flood_guard_t *guard);
+
+/**
+ * @brief Checks whether a port is currently inhibited.
+ *
+ * @param guard The guard of the port.
+ *
+ * @return true if the port is inhibited, false otherwise.
+ */
+static inline bool flood_guard_tripped(const flood_guard_t *guard) { return guard->tripped; }
+
+#endif /* FLOOD_GUARD_H */
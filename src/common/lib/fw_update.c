@@ -0,0 +1,473 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "fw_update.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bsp/board.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+#include "led_helper.h"
+#include "pico/multicore.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+
+/* Flash layout.  The running firmware occupies the boot slot at the start of flash, and new images
+ * are streamed into the staging slot in the upper half.  The RP2040 can only boot from the start of
+ * flash, and has no bank swap, so once an image has been verified it is copied over the boot slot.
+ */
+#define FW_UPDATE_SLOT_SIZE (PICO_FLASH_SIZE_BYTES / 2)
+#define FW_UPDATE_STAGING_OFFSET FW_UPDATE_SLOT_SIZE
+#define FW_UPDATE_STAGING ((const uint8_t *)(XIP_BASE + FW_UPDATE_STAGING_OFFSET))
+
+// Each data packet carries an 8 byte header followed by up to 56 bytes of the image.
+#define FW_UPDATE_DATA_HEADER 8
+#define FW_UPDATE_DATA_MAX (FW_UPDATE_PACKET_SIZE - FW_UPDATE_DATA_HEADER)
+
+// Every RP2040 image starts with the 256 byte boot2 stage, ending with its own CRC32.
+#define FW_UPDATE_BOOT2_SIZE 256
+
+typedef struct {
+  uint32_t offset;                // Offset of the page within the image
+  uint8_t data[FLASH_PAGE_SIZE];  // Page contents, padded with 0xFF past the end of the image
+} fw_update_page_t;
+
+static fw_update_state_t fw_state = FW_UPDATE_IDLE;
+static uint8_t fw_error = FW_UPDATE_OK;  // Reason the last update failed
+static uint32_t fw_size = 0;             // Size of the image, as sent by the host
+static uint32_t fw_crc = 0;              // CRC32 of the image, as sent by the host
+static uint32_t fw_received = 0;         // Bytes of the image accepted so far
+static uint32_t fw_swap_ms = 0;          // Time the swap was acknowledged
+
+static uint8_t fw_reply[FW_UPDATE_PACKET_SIZE];
+static bool fw_reply_pending = false;
+
+// Pages waiting to be programmed by Core 1.  The page at the head is assembled from the received
+// data, and only published once complete.  The head is only written by Core 0, and the tail only by
+// Core 1.
+static fw_update_page_t fw_queue[CONVERTER_FW_UPDATE_QUEUE_PAGES];
+static volatile uint8_t fw_queue_head = 0;
+static volatile uint8_t fw_queue_tail = 0;
+
+static bool fw_core1_running = false;
+static volatile bool fw_flash_failed = false;      // Set by Core 1 if a page didn't read back
+static volatile bool fw_verify_requested = false;  // Cleared by Core 1 once fw_verify_crc is set
+static bool fw_verify_started = false;
+static volatile uint32_t fw_verify_crc = 0;
+
+/**
+ * @brief Reads a little endian 32-bit value from a packet.
+ *
+ * @param data Pointer to the first byte of the value.
+ *
+ * @return The value.
+ */
+static uint32_t fw_update_get32(const uint8_t *data) {
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) |
+         ((uint32_t)data[3] << 24);
+}
+
+/**
+ * @brief Writes a little endian 32-bit value into a packet.
+ *
+ * @param data  Pointer to the first byte of the value.
+ * @param value The value.
+ */
+static void fw_update_put32(uint8_t *data, uint32_t value) {
+  for (uint i = 0; i < 4; i++) data[i] = (uint8_t)(value >> (8 * i));
+}
+
+/**
+ * @brief Calculates the standard (zlib) CRC32 of a block of data.
+ *
+ * @param data Pointer to the data.
+ * @param len  Length of the data in bytes.
+ *
+ * @return The CRC32.
+ */
+static uint32_t fw_update_crc32(const uint8_t *data, uint32_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  while (len--) {
+    crc ^= *data++;
+    for (uint bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Checks the boot2 stage at the start of an image.
+ * The bootrom refuses to boot an image whose boot2 checksum doesn't match, so this catches a UF2 or
+ * ELF file being sent in place of the raw binary before anything is written to flash.
+ *
+ * @param boot2 Pointer to the first FW_UPDATE_BOOT2_SIZE bytes of the image.
+ *
+ * @return true if the boot2 checksum is valid.
+ */
+static bool fw_update_boot2_valid(const uint8_t *boot2) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint i = 0; i < FW_UPDATE_BOOT2_SIZE - 4; i++) {
+    crc ^= (uint32_t)boot2[i] << 24;
+    for (uint bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+    }
+  }
+  return crc == fw_update_get32(&boot2[FW_UPDATE_BOOT2_SIZE - 4]);
+}
+
+/**
+ * @brief Flash worker running on Core 1.
+ * Erasing a sector takes tens of milliseconds, during which flash can't be read.  As the converter
+ * runs entirely from SRAM, Core 0 carries on handling the keyboard while Core 1 erases and programs
+ * the staging slot, and reads it back.
+ */
+static void fw_update_core1(void) {
+  while (1) {
+    uint8_t tail = fw_queue_tail;
+    if (tail != fw_queue_head) {
+      const fw_update_page_t *page = &fw_queue[tail];
+      uint32_t flash_offset = FW_UPDATE_STAGING_OFFSET + page->offset;
+      // Pages always arrive in order, so each sector is erased as its first page arrives.
+      if (page->offset % FLASH_SECTOR_SIZE == 0) flash_range_erase(flash_offset, FLASH_SECTOR_SIZE);
+      flash_range_program(flash_offset, page->data, FLASH_PAGE_SIZE);
+      if (memcmp(FW_UPDATE_STAGING + page->offset, page->data, FLASH_PAGE_SIZE) != 0) {
+        fw_flash_failed = true;
+      }
+      __dmb();  // Ensure we have finished with the page before it is released.
+      fw_queue_tail = (uint8_t)((tail + 1) % CONVERTER_FW_UPDATE_QUEUE_PAGES);
+    } else if (fw_verify_requested) {
+      fw_verify_crc = fw_update_crc32(FW_UPDATE_STAGING, fw_size);
+      __dmb();
+      fw_verify_requested = false;
+    } else {
+      __wfe();  // Sleep until Core 0 publishes more work.
+    }
+  }
+}
+
+/**
+ * @brief Returns whether Core 1 has no pages left to program.
+ *
+ * @return true if the page queue is empty.
+ */
+static bool fw_update_queue_empty(void) { return fw_queue_head == fw_queue_tail; }
+
+/**
+ * @brief Returns whether the page queue can accept another page.
+ *
+ * @return true if the page queue is full.
+ */
+static bool fw_update_queue_full(void) {
+  return (fw_queue_head + 1) % CONVERTER_FW_UPDATE_QUEUE_PAGES == fw_queue_tail;
+}
+
+/**
+ * @brief Abandons the current update.
+ *
+ * @param status The reason for abandoning the update (FW_UPDATE_ERR_*), reported to the host.
+ */
+static void fw_update_fail(uint8_t status) {
+  printf("[ERR] Firmware Update failed (status %d) at offset %lu\n", status,
+         (unsigned long)fw_received);
+  fw_state = FW_UPDATE_IDLE;
+  fw_error = status;
+  converter_set_state(CONVERTER_FW_FLASH, false);
+}
+
+/**
+ * @brief Publishes the page at the head of the queue for Core 1 to program.
+ * Anything past the end of the image is padded with 0xFF, as for erased flash.
+ *
+ * @return FW_UPDATE_OK, or FW_UPDATE_ERR_IMAGE if the first page isn't a valid image.
+ */
+static uint8_t fw_update_queue_page(void) {
+  uint8_t head = fw_queue_head;
+  fw_update_page_t *page = &fw_queue[head];
+  page->offset = (fw_received - 1) & ~(FLASH_PAGE_SIZE - 1);
+
+  uint32_t used = fw_received - page->offset;
+  memset(&page->data[used], 0xFF, FLASH_PAGE_SIZE - used);
+  if (page->offset == 0 && !fw_update_boot2_valid(page->data)) return FW_UPDATE_ERR_IMAGE;
+
+  __dmb();  // Ensure the page is written before it is published.
+  fw_queue_head = (uint8_t)((head + 1) % CONVERTER_FW_UPDATE_QUEUE_PAGES);
+  __sev();
+  return FW_UPDATE_OK;
+}
+
+/**
+ * @brief Adds image data to the page being assembled, publishing it once complete.
+ * The caller ensures the queue has space, and as a packet carries less than a page of data, it
+ * completes at most one page.
+ *
+ * @param data Pointer to the image data.
+ * @param len  Length of the image data.
+ *
+ * @return FW_UPDATE_OK, or the reason the data was rejected.
+ */
+static uint8_t fw_update_write(const uint8_t *data, uint32_t len) {
+  while (len) {
+    uint32_t page_pos = fw_received % FLASH_PAGE_SIZE;
+    uint32_t count = len < FLASH_PAGE_SIZE - page_pos ? len : FLASH_PAGE_SIZE - page_pos;
+    memcpy(&fw_queue[fw_queue_head].data[page_pos], data, count);
+    fw_received += count;
+    data += count;
+    len -= count;
+
+    if (fw_received % FLASH_PAGE_SIZE == 0 || fw_received == fw_size) {
+      uint8_t status = fw_update_queue_page();
+      if (status != FW_UPDATE_OK) return status;
+    }
+  }
+  return FW_UPDATE_OK;
+}
+
+/**
+ * @brief Starts a new update.
+ *
+ * @param size Size of the image in bytes.
+ * @param crc  CRC32 of the image.
+ *
+ * @return FW_UPDATE_OK, or the reason the update can't be started.
+ */
+static uint8_t fw_update_begin(uint32_t size, uint32_t crc) {
+  if (fw_state == FW_UPDATE_SWAPPING) return FW_UPDATE_ERR_STATE;
+  if (!fw_update_queue_empty() || fw_verify_requested) return FW_UPDATE_BUSY;
+  if (size < FW_UPDATE_BOOT2_SIZE || size > FW_UPDATE_SLOT_SIZE) return FW_UPDATE_ERR_SIZE;
+
+  if (!fw_core1_running) {
+    multicore_launch_core1(fw_update_core1);
+    fw_core1_running = true;
+  }
+
+  fw_size = size;
+  fw_crc = crc;
+  fw_received = 0;
+  fw_flash_failed = false;
+  fw_verify_started = false;
+  fw_verify_crc = 0;
+  fw_error = FW_UPDATE_OK;
+  fw_state = FW_UPDATE_RECEIVING;
+  converter_set_state(CONVERTER_FW_FLASH, true);
+  printf("[INFO] Firmware Update started, %lu bytes, CRC32 0x%08lX\n", (unsigned long)size,
+         (unsigned long)crc);
+  return FW_UPDATE_OK;
+}
+
+/**
+ * @brief Handles a data packet from the host.
+ * Data must arrive in order.  A packet the host has already had accepted is acknowledged again
+ * without being written, so the host can safely resend a packet if a reply is lost.
+ *
+ * @param packet Pointer to the packet.
+ *
+ * @return The status to return to the host.
+ */
+static uint8_t fw_update_data(uint8_t const *packet) {
+  uint32_t len = packet[1];
+  uint32_t offset = fw_update_get32(&packet[4]);
+
+  if (fw_state != FW_UPDATE_RECEIVING) return FW_UPDATE_ERR_STATE;
+  if (fw_flash_failed) return FW_UPDATE_ERR_FLASH;
+  if (len == 0 || len > FW_UPDATE_DATA_MAX || offset + len > fw_size) return FW_UPDATE_ERR_SIZE;
+  if (offset + len <= fw_received) return FW_UPDATE_OK;
+  if (offset != fw_received) return FW_UPDATE_ERR_OFFSET;
+  if (fw_update_queue_full()) return FW_UPDATE_BUSY;
+
+  return fw_update_write(&packet[FW_UPDATE_DATA_HEADER], len);
+}
+
+/**
+ * @brief Handles a packet received from the host on the vendor interface.
+ * Every packet is answered with a status reply, sent from fw_update_task().  The host waits for the
+ * reply before sending the next packet, which paces the transfer to the rate flash can be written.
+ *
+ * @param packet Pointer to the packet.
+ * @param len    Length of the packet.
+ */
+void fw_update_receive(uint8_t const *packet, uint16_t len) {
+  if (len < FW_UPDATE_PACKET_SIZE) return;
+
+  uint8_t command = packet[0];
+  uint8_t status = FW_UPDATE_OK;
+
+  switch (command) {
+    case FW_UPDATE_CMD_BEGIN:
+      status = fw_update_begin(fw_update_get32(&packet[4]), fw_update_get32(&packet[8]));
+      break;
+
+    case FW_UPDATE_CMD_DATA:
+      status = fw_update_data(packet);
+      break;
+
+    case FW_UPDATE_CMD_FINISH:
+      if (fw_state != FW_UPDATE_RECEIVING || fw_received != fw_size) {
+        status = FW_UPDATE_ERR_STATE;
+      } else {
+        fw_state = FW_UPDATE_VERIFYING;  // fw_update_task() starts verifying once Core 1 is idle.
+      }
+      break;
+
+    case FW_UPDATE_CMD_SWAP:
+      if (fw_state != FW_UPDATE_VERIFIED) {
+        status = FW_UPDATE_ERR_STATE;
+      } else {
+        fw_state = FW_UPDATE_SWAPPING;
+        fw_swap_ms = board_millis();
+      }
+      break;
+
+    case FW_UPDATE_CMD_ABORT:
+      if (fw_state == FW_UPDATE_SWAPPING) {
+        status = FW_UPDATE_ERR_STATE;
+      } else if (fw_state != FW_UPDATE_IDLE) {
+        printf("[INFO] Firmware Update aborted by host\n");
+        fw_state = FW_UPDATE_IDLE;
+        converter_set_state(CONVERTER_FW_FLASH, false);
+      }
+      break;
+
+    case FW_UPDATE_CMD_STATUS:
+      if (fw_state == FW_UPDATE_VERIFYING) {
+        status = FW_UPDATE_BUSY;
+      } else if (fw_state == FW_UPDATE_IDLE) {
+        status = fw_error;
+      }
+      break;
+
+    default:
+      status = FW_UPDATE_ERR_COMMAND;
+      break;
+  }
+
+  // Anything else leaves the update in place, so the host can resend from the reported offset.
+  if (status == FW_UPDATE_ERR_IMAGE || status == FW_UPDATE_ERR_FLASH) fw_update_fail(status);
+
+  memset(fw_reply, 0, sizeof(fw_reply));
+  fw_reply[0] = command;
+  fw_reply[1] = status;
+  fw_reply[2] = (uint8_t)fw_state;
+  fw_update_put32(&fw_reply[4], fw_received);
+  fw_update_put32(&fw_reply[8], fw_verify_crc);
+  fw_update_put32(&fw_reply[12], FW_UPDATE_SLOT_SIZE);
+  fw_reply_pending = true;
+}
+
+/**
+ * @brief Copies a single page of the verified image from the staging slot to the boot slot.
+ * The page is copied through SRAM, as the staging slot can't be read while flash is being
+ * programmed.
+ *
+ * @param offset Offset of the page within the image.
+ * @param buffer A page sized buffer in SRAM.
+ */
+static void __no_inline_not_in_flash_func(fw_update_swap_page)(uint32_t offset, uint8_t *buffer) {
+  memcpy(buffer, FW_UPDATE_STAGING + offset, FLASH_PAGE_SIZE);
+  flash_range_program(offset, buffer, FLASH_PAGE_SIZE);
+}
+
+/**
+ * @brief Copies the verified image over the boot slot, and reboots into it.
+ * Interrupts are disabled and Core 1 is stopped, so nothing else runs while the boot slot is
+ * rewritten.  The first sector, which holds the boot2 stage, is erased before anything else, and
+ * boot2 itself is the very last page programmed.  If power is lost part way through, the bootrom
+ * finds no valid boot2 stage and starts in BOOTSEL mode, so the converter can still be recovered
+ * with a UF2, rather than booting a valid boot2 stage into a partly copied image.
+ */
+static void __no_inline_not_in_flash_func(fw_update_swap)(void) {
+  uint8_t *buffer = fw_queue[0].data;
+  uint32_t first_sector_end = fw_size < FLASH_SECTOR_SIZE ? fw_size : FLASH_SECTOR_SIZE;
+
+  multicore_reset_core1();
+  save_and_disable_interrupts();
+
+  flash_range_erase(0, FLASH_SECTOR_SIZE);
+  for (uint32_t offset = FLASH_SECTOR_SIZE; offset < fw_size; offset += FLASH_PAGE_SIZE) {
+    if (offset % FLASH_SECTOR_SIZE == 0) flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    fw_update_swap_page(offset, buffer);
+  }
+  for (uint32_t offset = FLASH_PAGE_SIZE; offset < first_sector_end; offset += FLASH_PAGE_SIZE) {
+    fw_update_swap_page(offset, buffer);
+  }
+  fw_update_swap_page(0, buffer);
+
+  watchdog_reboot(0, 0, 10);
+  while (1) tight_loop_contents();
+}
+
+/**
+ * @brief Task function for the Firmware Update.
+ * This sends any pending reply to the host, checks the progress of Core 1, and once verified and
+ * requested by the host, performs the swap.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void fw_update_task(void) {
+  if (fw_reply_pending) {
+    uint8_t instance = usb_hid_report_instance(REPORT_ID_VENDOR);
+    if (instance == USB_HID_INSTANCE_NONE) {
+      fw_reply_pending = false;
+    } else if (tud_hid_n_ready(instance)) {
+      tud_hid_n_report(instance, 0, fw_reply, sizeof(fw_reply));
+      fw_reply_pending = false;
+    }
+  }
+
+  switch (fw_state) {
+    case FW_UPDATE_RECEIVING:
+      if (fw_flash_failed) fw_update_fail(FW_UPDATE_ERR_FLASH);
+      break;
+
+    case FW_UPDATE_VERIFYING:
+      if (!fw_verify_started) {
+        if (!fw_update_queue_empty()) break;
+        if (fw_flash_failed) {
+          fw_update_fail(FW_UPDATE_ERR_FLASH);
+          break;
+        }
+        fw_verify_started = true;
+        fw_verify_requested = true;
+        __sev();
+      } else if (!fw_verify_requested) {
+        if (fw_verify_crc != fw_crc) {
+          printf("[ERR] Firmware Update CRC32 0x%08lX, expected 0x%08lX\n",
+                 (unsigned long)fw_verify_crc, (unsigned long)fw_crc);
+          fw_update_fail(FW_UPDATE_ERR_CRC);
+        } else {
+          printf("[INFO] Firmware Update verified, waiting for swap\n");
+          fw_state = FW_UPDATE_VERIFIED;
+        }
+      }
+      break;
+
+    case FW_UPDATE_SWAPPING:
+      if (board_millis() - fw_swap_ms < CONVERTER_FW_UPDATE_SWAP_DELAY_MS) break;
+      printf("[INFO] Firmware Update swapping %lu bytes into the boot slot, and rebooting\n",
+             (unsigned long)fw_size);
+      tud_disconnect();
+      fw_update_swap();
+      break;
+
+    default:
+      break;
+  }
+}
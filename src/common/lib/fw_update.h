@@ -0,0 +1,66 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FW_UPDATE_H
+#define FW_UPDATE_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Size of each packet exchanged with the host on the vendor interface.
+#define FW_UPDATE_PACKET_SIZE 64
+
+// Commands sent by the host, in the first byte of each packet.  Fields are little endian.
+enum {
+  FW_UPDATE_CMD_BEGIN = 0x01,   // Start an update: [4..7] image size, [8..11] image CRC32
+  FW_UPDATE_CMD_DATA = 0x02,    // Image data: [1] length, [4..7] offset, [8..63] data
+  FW_UPDATE_CMD_FINISH = 0x03,  // Program the final page, then verify the staging slot
+  FW_UPDATE_CMD_SWAP = 0x04,    // Copy the verified image over the running firmware and reboot
+  FW_UPDATE_CMD_ABORT = 0x05,   // Abandon the update
+  FW_UPDATE_CMD_STATUS = 0x06,  // Report the current status
+};
+
+// Status returned to the host in the second byte of each reply.
+enum {
+  FW_UPDATE_OK,
+  FW_UPDATE_BUSY,         // Not ready yet, resend the same packet
+  FW_UPDATE_ERR_STATE,    // Command not valid in the current state
+  FW_UPDATE_ERR_SIZE,     // Image is too small, or larger than the staging slot
+  FW_UPDATE_ERR_OFFSET,   // Data did not follow on from the last accepted offset
+  FW_UPDATE_ERR_IMAGE,    // Image does not start with a valid RP2040 boot2 stage
+  FW_UPDATE_ERR_FLASH,    // Staging slot did not read back as programmed
+  FW_UPDATE_ERR_CRC,      // CRC32 of the staging slot did not match the host
+  FW_UPDATE_ERR_COMMAND,  // Unknown command
+};
+
+// States of the update, returned to the host in the third byte of each reply.
+typedef enum {
+  FW_UPDATE_IDLE,
+  FW_UPDATE_RECEIVING,
+  FW_UPDATE_VERIFYING,
+  FW_UPDATE_VERIFIED,
+  FW_UPDATE_SWAPPING,
+} fw_update_state_t;
+
+void fw_update_receive(uint8_t const *packet, uint16_t len);
+void fw_update_task(void);
+
+#endif /* FW_UPDATE_H */
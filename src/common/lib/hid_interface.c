@@ -21,16 +21,58 @@
 #include "hid_interface.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include "bsp/board.h"
+#include "buzzer.h"
 #include "config.h"
 #include "hid_keycodes.h"
 #include "keymaps.h"
 #include "led_helper.h"
 #include "pico/bootrom.h"
+#include "ringbuf.h"
 #include "tusb.h"
 #include "usb_descriptors.h"
 
+#ifdef CONVERTER_TIMELINE
+#include "timeline.h"
+#endif
+#ifdef CONVERTER_FW_UPDATE
+#include "fw_update.h"
+#endif
+#ifdef CONVERTER_MOUSEKEYS
+#include "mousekeys.h"
+#endif
+#ifdef CONVERTER_EVENT_STAMPS
+#include "event_stamps.h"
+#include "hardware/timer.h"
+#endif
+#ifdef CONVERTER_LOADGEN
+#include "loadgen.h"
+#endif
+#if defined(CONVERTER_REPORT_TRACE) || defined(CONVERTER_KEYCLICK_BENCHMARK)
+#include "perf_counters.h"
+#endif
+
+// Time the device is held disconnected for, so the host registers the disconnect before we
+// re-enumerate with a new set of interfaces.
+#define USB_REENUMERATE_MS 100
+
+// Functions exposed from power on, regardless of which devices have been detected.  Mouse Keys
+// need the mouse function whether or not a Mouse is ever connected.
+#ifdef CONVERTER_VENDOR_INTERFACE
+#define USB_FUNC_BASE_VENDOR USB_FUNC_VENDOR
+#else
+#define USB_FUNC_BASE_VENDOR 0
+#endif
+#ifdef CONVERTER_MOUSEKEYS
+#define USB_FUNC_BASE_MOUSE USB_FUNC_MOUSE
+#else
+#define USB_FUNC_BASE_MOUSE 0
+#endif
+#define USB_FUNC_BASE \
+  ((KEYBOARD_ENABLED ? USB_FUNC_KEYBOARD : 0) | USB_FUNC_BASE_MOUSE | USB_FUNC_BASE_VENDOR)
+
 enum {
   USAGE_PAGE_KEYBOARD = 0x0,
   USAGE_PAGE_CONSUMER = 0xC,
@@ -38,6 +80,51 @@ enum {
 
 static hid_keyboard_report_t keyboard_report;
 static hid_mouse_report_t mouse_report;
+static uint8_t mouse_device_buttons = 0;  // Buttons last reported by the Mouse itself
+
+#ifdef CONVERTER_USB_COMPACT
+// Reports waiting to be sent on the shared interface, in the order they were submitted.
+#define HID_SHARED_QUEUE_SIZE 8
+#define HID_SHARED_REPORT_MAX 8
+
+typedef struct {
+  uint8_t report_id;
+  uint8_t len;
+  uint8_t data[HID_SHARED_REPORT_MAX];
+} hid_shared_report_t;
+
+static hid_shared_report_t hid_shared_queue[HID_SHARED_QUEUE_SIZE];
+static uint8_t hid_shared_head = 0;
+static uint8_t hid_shared_tail = 0;
+static uint8_t hid_shared_count = 0;
+static uint8_t hid_shared_mouse_queued = 0;
+#endif
+
+#ifdef CONVERTER_KEYCLICK
+/**
+ * @brief Determines the Keyclick class for a given HID keycode.
+ *
+ * @param code The HID keycode which was pressed.
+ *
+ * @return The keyclick_class to use for the key.
+ */
+static inline keyclick_class hid_keyclick_class(uint8_t code) {
+  if (IS_MOD(code)) return KEYCLICK_MODIFIER;
+  if (code == KC_SPC || code == KC_ENT || code == KC_BSPC) return KEYCLICK_LARGE;
+  return KEYCLICK_NORMAL;
+}
+
+#ifdef CONVERTER_KEYCLICK_BENCHMARK
+// Number of key presses timed with, and then without, the Keyclick.
+#define KEYCLICK_BENCHMARK_PRESSES 100
+
+// Cleared while the benchmark measures the report path without the Keyclick.
+static bool hid_keyclick_enabled = true;
+#define HID_KEYCLICK_ENABLED hid_keyclick_enabled
+#else
+#define HID_KEYCLICK_ENABLED true
+#endif
+#endif
 
 /**
  * @brief Prints the contents of a HID report.
@@ -58,6 +145,72 @@ static void hid_print_report(void* report, size_t size, const char* message) {
   printf("\n");
 }
 
+#ifdef CONVERTER_REPORT_TRACE
+/**
+ * @brief Prints a HID report in a stable format, for capturing and comparing report streams.
+ * Each report is printed on a single line holding the report ID, the interface key position which
+ * produced it, whether it was a make (M) or break (B), and the raw report bytes.  A stream captured
+ * while pressing every key can then be compared against a known good capture for the same keyboard.
+ *
+ * @param report_id The report ID of the report.
+ * @param pos       The interface key position (as passed to keymap_get_key_val).
+ * @param make      Whether the key was pressed (true) or released (false).
+ * @param report    Pointer to the report data.
+ * @param size      Size of the report data.
+ */
+static void hid_trace_report(uint8_t report_id, uint8_t pos, bool make, const void* report,
+                             size_t size) {
+  const uint8_t* bytes = (const uint8_t*)report;
+  printf("[TRACE] %02X %02X %c", report_id, pos, make ? 'M' : 'B');
+  for (size_t i = 0; i < size; i++) printf(" %02X", bytes[i]);
+  printf("\n");
+}
+#endif
+
+#if defined(CONVERTER_REPORT_TRACE) && KEYBOARD_ENABLED
+static perf_stat_t hid_decode_stats = {0};
+static uint32_t hid_decode_start = 0;   // Cycle counter when the current scancode's decode began
+static uint32_t hid_decode_cycles = 0;  // Decode cycles of earlier scancodes of the same sequence
+static bool hid_decode_timing = false;  // Set while a scancode from the Keyboard is being decoded
+
+/**
+ * @brief Starts timing the decode of a scancode received from the Keyboard.
+ * This should be called just before the scancode is passed to process_scancode().
+ */
+void __not_in_flash_func(hid_decode_begin)(void) {
+  hid_decode_start = perf_cycles_now();
+  hid_decode_timing = true;
+}
+
+/**
+ * @brief Records the decode cost of a report, once it has been built but before it is submitted.
+ * Only the scancode processing, keymap lookup and report assembly are counted, leaving out the USB
+ * submission and the trace output.  Any prefix bytes of the same sequence are included.
+ */
+static void __not_in_flash_func(hid_decode_done)(void) {
+  if (!hid_decode_timing) return;
+  perf_stat_add(&hid_decode_stats, hid_decode_cycles + perf_cycles_since(hid_decode_start));
+  hid_decode_cycles = 0;
+  hid_decode_timing = false;
+}
+
+/**
+ * @brief Stops timing the decode of a scancode, and reports the decode cost every batch of reports.
+ * This should be called once process_scancode() returns.  A scancode which didn't produce a report,
+ * such as a prefix byte, has its decode cost carried over to the report its sequence produces.
+ */
+void hid_decode_end(void) {
+  if (hid_decode_timing) {
+    hid_decode_cycles += perf_cycles_since(hid_decode_start);
+    hid_decode_timing = false;
+  }
+  if (hid_decode_stats.count >= CONVERTER_REPORT_TRACE_DECODE_BATCH) {
+    perf_stat_print("Decode " KEYBOARD_MAKE " " KEYBOARD_MODEL " (" KEYBOARD_CODESET ")",
+                    &hid_decode_stats);
+  }
+}
+#endif
+
 /**
  * @brief Adds a key to the HID keyboard report.
  * This function is responsible for adding a key to the HID keyboard report. The HID keyboard report
@@ -73,7 +226,7 @@ static void hid_print_report(void* report, size_t size, const char* message) {
  *
  * @return True if the key was successfully added, false otherwise.
  */
-static bool hid_keyboard_add_key(uint8_t key) {
+static bool __not_in_flash_func(hid_keyboard_add_key)(uint8_t key) {
   if (IS_MOD(key)) {
     if ((keyboard_report.modifier & (uint8_t)(1 << (key & 0x7))) == 0) {
       keyboard_report.modifier |= (uint8_t)(1 << (key & 0x7));
@@ -102,7 +255,7 @@ static bool hid_keyboard_add_key(uint8_t key) {
  *
  * @return true if the keycode was successfully removed, false otherwise.
  */
-static bool hid_keyboard_del_key(uint8_t key) {
+static bool __not_in_flash_func(hid_keyboard_del_key)(uint8_t key) {
   if (IS_MOD(key)) {
     uint8_t modifier_bit = (uint8_t)(1 << (key & 0x7));
     if ((keyboard_report.modifier & modifier_bit) != 0) {
@@ -121,6 +274,80 @@ static bool hid_keyboard_del_key(uint8_t key) {
   return false;
 }
 
+#ifdef CONVERTER_USB_COMPACT
+/**
+ * @brief Sends queued reports on the shared interface.
+ * The shared interface has a single endpoint, so it can only carry one report per polling interval.
+ * Reports are sent strictly in the order they were submitted, and as handle_mouse_report() only
+ * ever queues a single mouse report, a Consumer or System report never waits behind more than one
+ * mouse report.  Reports for an interface which is no longer enumerated are discarded.
+ */
+static void hid_shared_flush(void) {
+  while (hid_shared_count) {
+    hid_shared_report_t* entry = &hid_shared_queue[hid_shared_tail];
+    uint8_t instance = usb_hid_report_instance(entry->report_id);
+    if (instance != USB_HID_INSTANCE_NONE) {
+      if (!tud_hid_n_ready(instance)) return;
+      if (!tud_hid_n_report(instance, entry->report_id, entry->data, entry->len)) {
+        printf("[ERR] Shared HID Report Failed (Report ID %d):\n", entry->report_id);
+        hid_print_report(entry->data, entry->len, "hid_shared_flush");
+      }
+    }
+    if (entry->report_id == REPORT_ID_MOUSE) hid_shared_mouse_queued--;
+    hid_shared_tail = (hid_shared_tail + 1) % HID_SHARED_QUEUE_SIZE;
+    hid_shared_count--;
+  }
+}
+#endif
+
+/**
+ * @brief Submits a Consumer, System or Mouse report to the host.
+ * In compact mode these reports share a single interface, so they are queued and sent by
+ * hid_shared_flush() as the endpoint becomes free.  Otherwise, they are sent directly on their own
+ * interface.
+ *
+ * @param report_id The report ID of the report.
+ * @param report    Pointer to the report data.
+ * @param len       Length of the report data.
+ *
+ * @return true if the report was sent or queued, false otherwise.
+ */
+static bool __not_in_flash_func(hid_report_submit)(uint8_t report_id, const void* report,
+                                                   uint8_t len) {
+#ifdef CONVERTER_USB_COMPACT
+  if (usb_hid_report_instance(report_id) == USB_HID_INSTANCE_NONE) return false;
+  if (hid_shared_count == HID_SHARED_QUEUE_SIZE || len > HID_SHARED_REPORT_MAX) return false;
+
+  hid_shared_report_t* entry = &hid_shared_queue[hid_shared_head];
+  entry->report_id = report_id;
+  entry->len = len;
+  memcpy(entry->data, report, len);
+  if (report_id == REPORT_ID_MOUSE) hid_shared_mouse_queued++;
+  hid_shared_head = (hid_shared_head + 1) % HID_SHARED_QUEUE_SIZE;
+  hid_shared_count++;
+
+  hid_shared_flush();
+  return true;
+#else
+  uint8_t instance = usb_hid_report_instance(report_id);
+  if (instance == USB_HID_INSTANCE_NONE) return false;
+  return tud_hid_n_report(instance, report_id, report, len);
+#endif
+}
+
+/**
+ * @brief Checks whether the Keyboard interface can hand over its next scancode.
+ * Scancodes are held back while the Keyboard report can't be sent, so none are lost while the host
+ * is busy or the bus is suspended.  While the device isn't mounted at all, such as when it is
+ * re-enumerating, nothing would be sent anyway, so scancodes are still decoded, keeping the report
+ * in step with the keys held down.  The host is sent the report once it has mounted the device.
+ *
+ * @return true if the next scancode can be processed.
+ */
+bool __not_in_flash_func(hid_keyboard_ready)(void) {
+  return !tud_mounted() || tud_hid_n_ready(usb_hid_report_instance(REPORT_ID_KEYBOARD));
+}
+
 /**
  * @brief Handles input reports for the keyboard usage page.
  * Only if the Keyboard Report changes do we then call `hid_send_report_with_retry`. Some PS2
@@ -131,9 +358,18 @@ static bool hid_keyboard_del_key(uint8_t key) {
  * @param code The interface scancode of the key.
  * @param make A boolean indicating whether the key is being pressed (true) or released (false).
  */
-void handle_keyboard_report(uint8_t code, bool make) {
+void __not_in_flash_func(handle_keyboard_report)(uint8_t code, bool make) {
+  const uint8_t pos = code;
   // Convert the Interface Scancode to a HID Keycode
   code = keymap_get_key_val(code, make);
+#ifdef CONVERTER_EVENT_STAMPS
+  const uint32_t decode_us = time_us_32();
+#endif
+#ifdef CONVERTER_MOUSEKEYS
+  if (mousekeys_handle_key(pos, code, make)) return;
+#else
+  (void)pos;
+#endif
   if (IS_KEY(code) || IS_MOD(code)) {
     bool report_modified = false;
     if (make) {
@@ -141,6 +377,9 @@ void handle_keyboard_report(uint8_t code, bool make) {
     } else {
       report_modified = hid_keyboard_del_key(code);
     }
+#if defined(CONVERTER_REPORT_TRACE) && KEYBOARD_ENABLED
+    hid_decode_done();
+#endif
 
     // Check for any Macro Combinations here
     if (keymap_is_action_key_pressed()) {
@@ -152,7 +391,7 @@ void handle_keyboard_report(uint8_t code, bool make) {
           printf("[INFO] Initiate Bootloader\n");
 #ifdef CONVERTER_LEDS
           // Set Status LED to indicate Bootloader Mode
-          converter.state.fw_flash = 1;
+          converter_set_state(CONVERTER_FW_FLASH, true);
           update_converter_status();
 #endif
           // Reboot into Bootloader
@@ -162,12 +401,33 @@ void handle_keyboard_report(uint8_t code, bool make) {
     }
 
     if (report_modified) {
-      bool res = tud_hid_n_report(ITF_NUM_KEYBOARD, REPORT_ID_KEYBOARD, &keyboard_report,
-                                  sizeof(keyboard_report));
-      if (!res) {
-        printf("[ERR] Keyboard HID Report Failed:\n");
-        hid_print_report(&keyboard_report, sizeof(keyboard_report), "handle_keyboard_report");
+      // While the host is away, the report is only kept up to date, and is sent once it's back.
+      bool res = false;
+      if (tud_mounted()) {
+        res = tud_hid_n_report(usb_hid_report_instance(REPORT_ID_KEYBOARD), REPORT_ID_KEYBOARD,
+                               &keyboard_report, sizeof(keyboard_report));
+        if (!res) {
+          printf("[ERR] Keyboard HID Report Failed:\n");
+          hid_print_report(&keyboard_report, sizeof(keyboard_report), "handle_keyboard_report");
+        }
       }
+#ifdef CONVERTER_REPORT_TRACE
+      hid_trace_report(REPORT_ID_KEYBOARD, pos, make, &keyboard_report, sizeof(keyboard_report));
+#endif
+#ifdef CONVERTER_TIMELINE
+      timeline_record(TIMELINE_HID_KEYBOARD, res);
+#endif
+#ifdef CONVERTER_EVENT_STAMPS
+      event_stamps_record(EVENT_STAMP_KEYBOARD, ringbuf_get_time_us(), decode_us, code, make, res);
+#endif
+#ifdef CONVERTER_LOADGEN
+      loadgen_record_report(LOADGEN_KEYBOARD, ringbuf_get_time_us(), res);
+#endif
+      if (make) converter_report_activity();
+#ifdef CONVERTER_KEYCLICK
+      // Trigger the Keyclick only once the report has been submitted, so it never delays it.
+      if (make && HID_KEYCLICK_ENABLED) buzzer_keyclick(hid_keyclick_class(code));
+#endif
     }
   } else if (IS_CONSUMER(code)) {
     uint16_t usage;
@@ -176,11 +436,46 @@ void handle_keyboard_report(uint8_t code, bool make) {
     } else {
       usage = 0;
     }
-    bool res = tud_hid_n_report(ITF_NUM_CONSUMER_CONTROL, REPORT_ID_CONSUMER_CONTROL, &usage,
-                                sizeof(usage));
+#if defined(CONVERTER_REPORT_TRACE) && KEYBOARD_ENABLED
+    hid_decode_done();
+#endif
+    bool res = hid_report_submit(REPORT_ID_CONSUMER_CONTROL, &usage, sizeof(usage));
     if (!res) {
       printf("[ERR] Consumer HID Report Failed: 0x%04X\n", usage);
     }
+#ifdef CONVERTER_REPORT_TRACE
+    hid_trace_report(REPORT_ID_CONSUMER_CONTROL, pos, make, &usage, sizeof(usage));
+#endif
+#ifdef CONVERTER_EVENT_STAMPS
+    event_stamps_record(EVENT_STAMP_KEYBOARD, ringbuf_get_time_us(), decode_us, code, make, res);
+#endif
+#ifdef CONVERTER_LOADGEN
+    loadgen_record_report(LOADGEN_KEYBOARD, ringbuf_get_time_us(), res);
+#endif
+  } else if (IS_SYSTEM(code)) {
+    // System Control reports carry the usage as an index from 1, with 0 meaning no usage.
+    uint8_t usage;
+    if (make) {
+      usage = (uint8_t)(CODE_TO_SYSTEM(code) - SYSTEM_POWER_DOWN + 1);
+    } else {
+      usage = 0;
+    }
+#if defined(CONVERTER_REPORT_TRACE) && KEYBOARD_ENABLED
+    hid_decode_done();
+#endif
+    bool res = hid_report_submit(REPORT_ID_SYSTEM_CONTROL, &usage, sizeof(usage));
+    if (!res) {
+      printf("[ERR] System HID Report Failed: 0x%02X\n", usage);
+    }
+#ifdef CONVERTER_REPORT_TRACE
+    hid_trace_report(REPORT_ID_SYSTEM_CONTROL, pos, make, &usage, sizeof(usage));
+#endif
+#ifdef CONVERTER_EVENT_STAMPS
+    event_stamps_record(EVENT_STAMP_KEYBOARD, ringbuf_get_time_us(), decode_us, code, make, res);
+#endif
+#ifdef CONVERTER_LOADGEN
+    loadgen_record_report(LOADGEN_KEYBOARD, ringbuf_get_time_us(), res);
+#endif
   }
 }
 
@@ -191,22 +486,53 @@ void handle_keyboard_report(uint8_t code, bool make) {
  * using the tud_hid_n_report function. If the report fails to send, an error message is printed and
  * the report is printed for debugging purposes.
  *
- * @param buttons An array of uint8_t representing the button states.
+ * With CONVERTER_MOUSEKEYS, any held Mouse Key buttons and pending Mouse Key motion are merged
+ * into every report, so Mouse Keys and a real Mouse can be used together.
+ *
+ * @param buttons An array of uint8_t representing the button states, or NULL to keep the buttons
+ *                last reported by the Mouse (used when Mouse Keys send a report of their own).
  * @param pos An array of int8_t representing the mouse position values (x, y, wheel).
+ *
+ * @return true if the report was sent (or queued for the shared interface), false if the interface
+ *         was not ready or the send failed.  If the interface was not ready, the caller may retry
+ *         with the same report later.
  */
-void handle_mouse_report(const uint8_t buttons[5], int8_t pos[3]) {
+bool __not_in_flash_func(handle_mouse_report)(const uint8_t buttons[5], int8_t pos[3]) {
+#ifdef CONVERTER_USB_COMPACT
+  // Only hold one mouse report in the shared queue, so movement keeps merging until it is sent.
+  if (hid_shared_mouse_queued) return false;
+#else
+  uint8_t instance = usb_hid_report_instance(REPORT_ID_MOUSE);
+  if (instance == USB_HID_INSTANCE_NONE || !tud_hid_n_ready(instance)) return false;
+#endif
+
   // Handle Mouse Report
-  mouse_report.buttons =
-      buttons[0] | (buttons[1] << 1) | (buttons[2] << 2) | (buttons[3] << 3) | (buttons[4] << 4);
-  mouse_report.x = pos[0];
-  mouse_report.y = pos[1];
-  mouse_report.wheel = pos[2];
-  bool res = tud_hid_n_report(KEYBOARD_ENABLED ? ITF_NUM_MOUSE : ITF_NUM_KEYBOARD, REPORT_ID_MOUSE,
-                              &mouse_report, sizeof(mouse_report));
+  if (buttons) {
+    mouse_device_buttons = (uint8_t)(buttons[0] | (buttons[1] << 1) | (buttons[2] << 2) |
+                                     (buttons[3] << 3) | (buttons[4] << 4));
+  }
+  mouse_report.buttons = mouse_device_buttons;
+  // The caller's movement is left untouched, as the Mouse subtracts what it sent from its pending
+  // movement.
+  int8_t motion[3] = {pos[0], pos[1], pos[2]};
+#ifdef CONVERTER_MOUSEKEYS
+  mousekeys_merge(&mouse_report.buttons, motion);
+#endif
+  mouse_report.x = motion[0];
+  mouse_report.y = motion[1];
+  mouse_report.wheel = motion[2];
+  bool res = hid_report_submit(REPORT_ID_MOUSE, &mouse_report, sizeof(mouse_report));
+#ifdef CONVERTER_TIMELINE
+  timeline_record(TIMELINE_HID_MOUSE, res);
+#endif
   if (!res) {
     printf("[ERR] Mouse HID Report Failed:\n");
     hid_print_report(&mouse_report, sizeof(mouse_report), "handle_mouse_report");
   }
+#ifdef CONVERTER_MOUSEKEYS
+  if (res) mousekeys_merged();  // Only now is the merged Mouse Key state known to be reported.
+#endif
+  return res;
 }
 
 /**
@@ -251,13 +577,20 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
  * @param buffer      Pointer to the buffer containing the received HID report data.
  * @param bufsize     The size of the received HID report data buffer.
  *
- * @note This function only handles the keyboard LED report.
+ * @note This function only handles the keyboard LED report, and any Firmware Update packets.
  */
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
                            uint8_t const* buffer, uint16_t bufsize) {
   (void)buffer;
 
-  if (instance != ITF_NUM_KEYBOARD) return;
+#ifdef CONVERTER_FW_UPDATE
+  if (instance == usb_hid_report_instance(REPORT_ID_VENDOR)) {
+    fw_update_receive(buffer, bufsize);
+    return;
+  }
+#endif
+
+  if (instance != usb_hid_report_instance(REPORT_ID_KEYBOARD)) return;
 
   if (report_type == HID_REPORT_TYPE_OUTPUT) {
     // Set keyboard LED e.g Capslock, Numlock etc...
@@ -269,12 +602,180 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
   }
 }
 
+#ifdef CONVERTER_USB_COMPACT
+/**
+ * @brief Callback function invoked when a report has been sent to the host.
+ * On the shared interface, this frees the endpoint for the next queued report.
+ *
+ * @param instance The instance number of the HID interface.
+ * @param report   Pointer to the report which was sent.
+ * @param len      Length of the report which was sent.
+ */
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len) {
+  (void)instance;
+  (void)report;
+  (void)len;
+  hid_shared_flush();
+}
+#endif
+
+/**
+ * @brief Callback function invoked when the USB bus is suspended.
+ * Within 7ms, the device must draw an average of less than 2.5 mA from the bus, so we publish the
+ * suspended state to pause any LED animation.
+ *
+ * @param remote_wakeup_en Whether the host allows us to perform a remote wakeup.
+ */
+void tud_suspend_cb(bool remote_wakeup_en) {
+  (void)remote_wakeup_en;
+  converter_set_state(CONVERTER_USB_SUSPENDED, true);
+}
+
+/**
+ * @brief Callback function invoked when the USB bus is resumed.
+ */
+void tud_resume_cb(void) { converter_set_state(CONVERTER_USB_SUSPENDED, false); }
+
+/**
+ * @brief Determines which USB functions should currently be exposed to the host.
+ * The keyboard function is always exposed when built for a keyboard, so that it is available to the
+ * host (and any BIOS) from power on.  The mouse function is only exposed once a mouse has been
+ * detected (or from power on, with Mouse Keys enabled).  As AT/PS2 has no way of signalling that a
+ * device has been unplugged, it then remains exposed until the converter is reset.
+ *
+ * @return Bitmap of USB_FUNC_* functions to expose.
+ */
+static uint8_t hid_device_functions(void) {
+  static uint8_t functions = USB_FUNC_BASE;
+
+  if (MOUSE_ENABLED && (state_word_get(&converter_state) & CONVERTER_MOUSE_READY)) {
+    functions |= USB_FUNC_MOUSE;
+  }
+
+  return functions;
+}
+
 /**
  * @brief Sets up the HID device by initializing the board and the tinyusb stack.
  * This function should be called before using any HID device functionality. It initializes the
- * board and the tinyusb stack, allowing the device to communicate with the host.
+ * board and the tinyusb stack, allowing the device to communicate with the host.  If there are no
+ * functions to expose yet (a Mouse only build, before the mouse is detected), the device stays
+ * disconnected from the host until hid_device_task() finds one.
  */
 void hid_device_setup(void) {
   board_init();
+  // The mouse ready state is only meaningful once the mouse interface has been set up, so we always
+  // start with just the base functions, and let hid_device_task() add the mouse once detected.
+  usb_descriptors_build(USB_FUNC_BASE);
   tusb_init();
+  if (!usb_active_functions()) tud_disconnect();
 }
+
+/**
+ * @brief Task function for the HID device.
+ * This rebuilds the USB descriptors whenever the set of functions to expose changes.  The device is
+ * disconnected from the host, and once the host has had time to register the disconnect, the
+ * descriptors are rebuilt and the device reconnected, so the host enumerates the new set of
+ * interfaces under its own Product ID.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void hid_device_task(void) {
+  static bool reenumerating = false;
+  static uint32_t disconnect_ms = 0;
+
+#ifdef CONVERTER_USB_COMPACT
+  hid_shared_flush();  // Send any reports still waiting for the shared endpoint.
+#endif
+
+#if KEYBOARD_ENABLED
+  // Whenever the host mounts the device, it assumes no keys are held, so if any are, such as keys
+  // pressed while it was away, it is sent the Keyboard report as it stands.
+  static const hid_keyboard_report_t no_keys = {0};
+  static bool mounted = false;
+  static bool keyboard_report_unsent = false;
+  if (tud_mounted() != mounted) {
+    mounted = !mounted;
+    keyboard_report_unsent =
+        mounted && memcmp(&keyboard_report, &no_keys, sizeof(keyboard_report)) != 0;
+  }
+  if (keyboard_report_unsent && tud_hid_n_ready(usb_hid_report_instance(REPORT_ID_KEYBOARD))) {
+    keyboard_report_unsent =
+        !tud_hid_n_report(usb_hid_report_instance(REPORT_ID_KEYBOARD), REPORT_ID_KEYBOARD,
+                          &keyboard_report, sizeof(keyboard_report));
+  }
+#endif
+
+  if (!reenumerating) {
+    if (hid_device_functions() == usb_active_functions()) return;
+    // Let the Keyboard interface catch up first, so the host isn't left waiting on keys which
+    // arrived just before the disconnect.
+    if (KEYBOARD_ENABLED && !ringbuf_is_empty()) return;
+    printf("[INFO] USB Functions changed, re-enumerating\n");
+    tud_disconnect();
+#ifdef CONVERTER_TIMELINE
+    timeline_record(TIMELINE_USB_DISCONNECT, 0);
+#endif
+    disconnect_ms = board_millis();
+    reenumerating = true;
+  } else if (board_millis() - disconnect_ms >= USB_REENUMERATE_MS) {
+    usb_descriptors_build(hid_device_functions());
+    if (usb_active_functions()) tud_connect();
+#ifdef CONVERTER_TIMELINE
+    timeline_record(TIMELINE_USB_CONNECT, usb_active_functions());
+#endif
+    reenumerating = false;
+  }
+}
+
+#ifdef CONVERTER_KEYCLICK_BENCHMARK
+/**
+ * @brief Measures the cost of the Keyclick on the Keyboard report path.
+ * Once the host has enumerated the Keyboard, this presses and releases the first modifier found in
+ * the base layer of the keymap through handle_keyboard_report(), exactly as a scancode would.  Each
+ * press is timed, first with the Keyclick disabled and then with it enabled, and both costs are
+ * reported once at the end.  Only a modifier is pressed, so nothing is typed on the host, but the
+ * Keyboard should be left alone while it runs.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void hid_keyclick_benchmark_task(void) {
+  static bool done = false;
+  static int pos = -1;
+  static uint32_t events = 0;
+  static perf_stat_t stats[2];  // Cost of each press without, and then with, the Keyclick.
+
+  if (done || !tud_mounted() || !tud_hid_n_ready(usb_hid_report_instance(REPORT_ID_KEYBOARD))) {
+    return;
+  }
+
+  if (pos < 0) {
+    pos = 0;
+    while (pos < KEYMAP_POSITIONS && !IS_MOD(keymap_map[0][pos])) pos++;
+    if (pos == KEYMAP_POSITIONS) {
+      printf("[WARN] Keyclick benchmark needs a modifier key in the base layer of the keymap\n");
+      done = true;
+      return;
+    }
+    printf("[INFO] Keyclick benchmark running, leave the Keyboard alone\n");
+  }
+
+  // Each event is either a press or a release, and only presses can trigger the Keyclick.
+  const bool make = (events & 1) == 0;
+  hid_keyclick_enabled = events >= KEYCLICK_BENCHMARK_PRESSES * 2;
+  if (make) {
+    uint32_t start = perf_cycles_now();
+    handle_keyboard_report((uint8_t)pos, true);
+    perf_stat_add(&stats[hid_keyclick_enabled], perf_cycles_since(start));
+  } else {
+    handle_keyboard_report((uint8_t)pos, false);
+  }
+
+  if (++events == KEYCLICK_BENCHMARK_PRESSES * 4) {
+    perf_stat_print("Key press without Keyclick", &stats[0]);
+    perf_stat_print("Key press with Keyclick", &stats[1]);
+    hid_keyclick_enabled = true;
+    done = true;
+  }
+}
+#endif
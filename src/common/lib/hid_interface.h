@@ -24,8 +24,17 @@
 #include "config.h"
 #include "pico/stdlib.h"
 
+bool hid_keyboard_ready(void);
 void handle_keyboard_report(uint8_t code, bool make);
-void handle_mouse_report(const uint8_t buttons[5], int8_t pos[3]);
+bool handle_mouse_report(const uint8_t buttons[5], int8_t pos[3]);
 void hid_device_setup(void);
+void hid_device_task(void);
+#ifdef CONVERTER_REPORT_TRACE
+void hid_decode_begin(void);
+void hid_decode_end(void);
+#endif
+#ifdef CONVERTER_KEYCLICK_BENCHMARK
+void hid_keyclick_benchmark_task(void);
+#endif
 
 #endif /* HID_INTERFACE_H */
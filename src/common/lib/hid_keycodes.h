@@ -28,6 +28,7 @@
 #define IS_SPECIAL(code) ((0xA5 <= (code) && (code) <= 0xDF) || (0xE8 <= (code) && (code) <= 0xFF))
 #define IS_SYSTEM(code) (KC_PWR <= (code) && (code) <= KC_WAKE)
 #define IS_CONSUMER(code) (KC_MPLY <= (code) && (code) <= KC_BRTD)
+#define IS_MOUSEKEY(code) (KC_MS_U <= (code) && (code) <= KC_ACL2)
 
 /* Define Super Macro Toggle */
 #define SUPER_MACRO_INIT(code)                                         \
@@ -166,6 +167,21 @@
 /* Special Macro Keys */
 #define KC_SPECIAL_BOOT 0xD4
 #define KC_BOOT KC_SPECIAL_BOOT
+/* Mouse Keys */
+#define KC_MS_U KC_MOUSE_UP
+#define KC_MS_D KC_MOUSE_DOWN
+#define KC_MS_L KC_MOUSE_LEFT
+#define KC_MS_R KC_MOUSE_RIGHT
+#define KC_BTN1 KC_MOUSE_BUTTON1
+#define KC_BTN2 KC_MOUSE_BUTTON2
+#define KC_BTN3 KC_MOUSE_BUTTON3
+#define KC_BTN4 KC_MOUSE_BUTTON4
+#define KC_BTN5 KC_MOUSE_BUTTON5
+#define KC_WH_U KC_MOUSE_WHEEL_UP
+#define KC_WH_D KC_MOUSE_WHEEL_DOWN
+#define KC_ACL0 KC_MOUSE_ACCEL0
+#define KC_ACL1 KC_MOUSE_ACCEL1
+#define KC_ACL2 KC_MOUSE_ACCEL2
 
 /* HID Usage Tables */
 /* HID Generic Desktop Usage Page (0x01) */
@@ -450,6 +466,27 @@ enum internal_special_codes {
   KC_BRIGHTNESS_DEC,  // C8
 };
 
+/* Internal Mouse Key Codes
+ * These drive the Mouse report from the Keyboard, when CONVERTER_MOUSEKEYS is enabled.  They follow
+ * on from the Modifier codes, and the order of the buttons matches their bits in the Mouse report.
+ */
+enum internal_mouse_codes {
+  KC_MOUSE_UP = 0xE8,
+  KC_MOUSE_DOWN,        // E9
+  KC_MOUSE_LEFT,        // EA
+  KC_MOUSE_RIGHT,       // EB
+  KC_MOUSE_BUTTON1,     // EC
+  KC_MOUSE_BUTTON2,     // ED
+  KC_MOUSE_BUTTON3,     // EE
+  KC_MOUSE_BUTTON4,     // EF
+  KC_MOUSE_BUTTON5,     // F0
+  KC_MOUSE_WHEEL_UP,    // F1
+  KC_MOUSE_WHEEL_DOWN,  // F2
+  KC_MOUSE_ACCEL0,      // F3
+  KC_MOUSE_ACCEL1,      // F4
+  KC_MOUSE_ACCEL2,      // F5
+};
+
 // clang-format off
 
 #define CODE_TO_SYSTEM(key) \
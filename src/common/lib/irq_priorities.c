@@ -0,0 +1,182 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "irq_priorities.h"
+
+#include <stdio.h>
+
+#include "bsp/board.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#include "pico/time.h"
+
+// The Cortex-M0+ only implements the top two bits of each priority, giving four levels.
+#define IRQ_PRIORITY_LEVELS 4
+#define IRQ_PRIORITY_LEVEL(priority) ((priority) >> 6)
+
+/**
+ * @brief The IRQ priority plan.
+ * The PIO receivers run at the highest priority, as they must be serviced before the PIO RX FIFO
+ * fills, and their handlers are kept short.  USB follows, with the timer alarms (used by the Buzzer)
+ * and any DMA completion handlers lowest, as these can always wait.  Handlers at the same priority
+ * can't preempt each other, so the worst-case entry latency of each source is bounded by the longest
+ * handler at the same or a higher priority.
+ */
+static const irq_priority_t irq_priority_plan[] = {
+    {"PIO0", PIO0_IRQ_0, CONVERTER_IRQ_PRIORITY_PIO},
+    {"PIO1", PIO1_IRQ_0, CONVERTER_IRQ_PRIORITY_PIO},
+    {"USB", USBCTRL_IRQ, CONVERTER_IRQ_PRIORITY_USB},
+    {"Alarms", TIMER_IRQ_0 + PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM,
+     CONVERTER_IRQ_PRIORITY_HOUSEKEEPING},
+    {"DMA0", DMA_IRQ_0, CONVERTER_IRQ_PRIORITY_HOUSEKEEPING},
+    {"DMA1", DMA_IRQ_1, CONVERTER_IRQ_PRIORITY_HOUSEKEEPING},
+};
+
+#define IRQ_PRIORITY_PLAN_SIZE (sizeof(irq_priority_plan) / sizeof(irq_priority_plan[0]))
+
+#ifdef CONVERTER_IRQ_STATS
+static int irq_probe_alarm = -1;
+static uint8_t irq_probe_levels[IRQ_PRIORITY_LEVELS];  // Priorities in use by the plan
+static uint irq_probe_level_count = 0;
+static uint irq_probe_index = 0;                       // Index of the priority being probed
+static uint32_t irq_probe_target_us = 0;               // Time the probe alarm is due to fire
+static volatile uint32_t irq_probe_worst_us[IRQ_PRIORITY_LEVELS] = {0};
+
+/**
+ * @brief Arms the latency probe alarm at the next priority in use by the plan.
+ *
+ * @param alarm_num The hardware alarm used by the probe.
+ */
+static void __not_in_flash_func(irq_probe_schedule)(uint alarm_num) {
+  irq_probe_index = (irq_probe_index + 1) % irq_probe_level_count;
+  irq_set_priority(TIMER_IRQ_0 + alarm_num, irq_probe_levels[irq_probe_index]);
+
+  // If we were held off long enough to miss the target, just try again.
+  absolute_time_t target;
+  do {
+    target = delayed_by_us(get_absolute_time(), CONVERTER_IRQ_STATS_PROBE_US);
+    irq_probe_target_us = (uint32_t)to_us_since_boot(target);
+  } while (hardware_alarm_set_target(alarm_num, target));
+}
+
+/**
+ * @brief Latency probe alarm callback.
+ * The time the alarm actually fired is compared against the time it was due, which gives the entry
+ * latency at the priority it was running at.  This covers everything which can hold off an IRQ at
+ * that priority: handlers at the same or a higher priority, and any code running with interrupts
+ * disabled.  As every source at the same priority sees the same latency, this also measures the
+ * latency of each of those sources.
+ *
+ * @param alarm_num The hardware alarm which fired.
+ */
+static void __not_in_flash_func(irq_probe_callback)(uint alarm_num) {
+  uint32_t latency_us = time_us_32() - irq_probe_target_us;
+  uint level = IRQ_PRIORITY_LEVEL(irq_probe_levels[irq_probe_index]);
+  if (latency_us > irq_probe_worst_us[level]) irq_probe_worst_us[level] = latency_us;
+  irq_probe_schedule(alarm_num);
+}
+
+/**
+ * @brief Starts the IRQ entry latency probe.
+ * A spare hardware alarm is claimed, and fires every CONVERTER_IRQ_STATS_PROBE_US, cycling through
+ * each priority in use by the plan.
+ */
+static void irq_probe_init(void) {
+  for (uint i = 0; i < IRQ_PRIORITY_PLAN_SIZE; i++) {
+    uint8_t priority = irq_priority_plan[i].priority;
+    bool seen = false;
+    for (uint j = 0; j < irq_probe_level_count; j++) seen |= irq_probe_levels[j] == priority;
+    if (!seen) irq_probe_levels[irq_probe_level_count++] = priority;
+  }
+
+  irq_probe_alarm = hardware_alarm_claim_unused(false);
+  if (irq_probe_alarm < 0) {
+    printf("[ERR] No hardware alarm available for the IRQ latency probe\n");
+    return;
+  }
+  hardware_alarm_set_callback((uint)irq_probe_alarm, &irq_probe_callback);
+  irq_probe_schedule((uint)irq_probe_alarm);
+  printf("[INFO] IRQ latency probe running on hardware alarm %d\n", irq_probe_alarm);
+}
+#endif
+
+/**
+ * @brief Applies the IRQ priority plan.
+ * Priorities can be set whether or not a handler has been installed yet, so this is called once at
+ * boot, before any of the interfaces are set up.
+ */
+void irq_priorities_init(void) {
+  for (uint i = 0; i < IRQ_PRIORITY_PLAN_SIZE; i++) {
+    irq_set_priority(irq_priority_plan[i].irq, irq_priority_plan[i].priority);
+  }
+#ifdef CONVERTER_IRQ_STATS
+  irq_probe_init();
+#endif
+}
+
+/**
+ * @brief Checks the IRQ priority plan is still in place.
+ * This should be called once everything has been set up, to catch any library initialisation which
+ * has changed the priority of an IRQ.  Any IRQ found at the wrong priority is reported and restored.
+ */
+void irq_priorities_check(void) {
+  for (uint i = 0; i < IRQ_PRIORITY_PLAN_SIZE; i++) {
+    const irq_priority_t *entry = &irq_priority_plan[i];
+    uint priority = irq_get_priority(entry->irq);
+    if (priority != entry->priority) {
+      printf("[WARN] %s IRQ priority changed to 0x%02X, restoring 0x%02X\n", entry->name, priority,
+             entry->priority);
+      irq_set_priority(entry->irq, entry->priority);
+    }
+  }
+}
+
+/**
+ * @brief Task function for the IRQ priority plan.
+ * With CONVERTER_IRQ_STATS enabled, this reports the worst-case entry latency measured for each
+ * interrupt source whenever it increases.  Otherwise there is nothing to do.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void irq_priorities_task(void) {
+#ifdef CONVERTER_IRQ_STATS
+  static uint32_t reported_us[IRQ_PRIORITY_LEVELS] = {0};
+  static uint32_t next_report_ms = 0;
+
+  uint32_t now_ms = board_millis();
+  if ((int32_t)(now_ms - next_report_ms) < 0) return;
+  next_report_ms = now_ms + CONVERTER_IRQ_STATS_INTERVAL_MS;
+
+  bool changed = false;
+  uint32_t worst_us[IRQ_PRIORITY_LEVELS];
+  for (uint level = 0; level < IRQ_PRIORITY_LEVELS; level++) {
+    worst_us[level] = irq_probe_worst_us[level];
+    changed |= worst_us[level] > reported_us[level];
+    reported_us[level] = worst_us[level];
+  }
+  if (!changed) return;
+
+  for (uint i = 0; i < IRQ_PRIORITY_PLAN_SIZE; i++) {
+    const irq_priority_t *entry = &irq_priority_plan[i];
+    printf("[DBG] IRQ %s (priority 0x%02X) worst entry latency: %luus\n", entry->name,
+           entry->priority, (unsigned long)worst_us[IRQ_PRIORITY_LEVEL(entry->priority)]);
+  }
+#endif
+}
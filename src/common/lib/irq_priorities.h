@@ -0,0 +1,39 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IRQ_PRIORITIES_H
+#define IRQ_PRIORITIES_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "pico/types.h"
+
+typedef struct {
+  const char *name;  // Name of the interrupt source, for the diagnostics output
+  uint irq;          // The IRQ number
+  uint8_t priority;  // The priority the IRQ should run at
+} irq_priority_t;
+
+void irq_priorities_init(void);
+void irq_priorities_check(void);
+void irq_priorities_task(void);
+
+#endif /* IRQ_PRIORITIES_H */
@@ -29,24 +29,23 @@ static int keymap_layer = 0; /* TO-DO Add full Layer Switching Support */
 static bool action_key_pressed = false;
 
 /**
- * @brief Searches for the key code in the keymap based on the specified row and column.
- * This function searches for the key code in the keymap based on the specified row and column. It
- * first checks the current layer, and if the key code is KC_TRNS (transparent), it searches through
- * the previous layers until a non-transparent key code is found. If no non-transparent key code is
- * found, it returns KC_NO (no key).
+ * @brief Searches for the key code in the keymap at the specified position.
+ * This function searches for the key code in the keymap at the specified position. It first checks
+ * the current layer, and if the key code is KC_TRNS (transparent), it searches through the previous
+ * layers until a non-transparent key code is found. If no non-transparent key code is found, it
+ * returns KC_NO (no key).
  *
- * @param row The row index in the keymap.
- * @param col The column index in the keymap.
+ * @param pos The position of the key in the keymap.
  *
  * @return The key code found in the keymap.
  */
-static uint8_t keymap_search_layers(uint8_t row, uint8_t col) {
-  uint8_t key_code = keymap_map[keymap_layer][row][col];
+static uint8_t __not_in_flash_func(keymap_search_layers)(uint8_t pos) {
+  uint8_t key_code = keymap_map[keymap_layer][pos];
 
   if (keymap_layer > 0 && key_code == KC_TRNS) {
     uint8_t layer_key_code;
     for (int i = keymap_layer; i >= 0; i--) {
-      layer_key_code = keymap_map[i][row][col];
+      layer_key_code = keymap_map[i][pos];
       if (layer_key_code != KC_TRNS) {
         key_code = layer_key_code;
         break;
@@ -64,8 +63,8 @@ static uint8_t keymap_search_layers(uint8_t row, uint8_t col) {
 /**
  * @brief Retrieves the key value at the specified position in the keymap.
  * This function takes a position value and a boolean indicating whether the key is being pressed or
- * released. It calculates the row and column values from the position and searches the keymap for
- * the corresponding key code.
+ * released. Each layer holds an entry for every possible position, so the position indexes the
+ * keymap directly to find the corresponding key code.
  *
  * If the key code is KC_FN, it sets the action_key_pressed flag and returns KC_NO. Otherwise, if
  * the action_key_pressed flag is set, it checks if there is an action key code at the specified
@@ -79,10 +78,8 @@ static uint8_t keymap_search_layers(uint8_t row, uint8_t col) {
  *
  * @return The key code at the specified position in the keymap.
  */
-uint8_t keymap_get_key_val(uint8_t pos, bool make) {
-  const uint8_t row = (pos >> 4) & 0x0F;
-  const uint8_t col = pos & 0x0F;
-  uint8_t key_code = keymap_search_layers(row, col);
+uint8_t __not_in_flash_func(keymap_get_key_val)(uint8_t pos, bool make) {
+  uint8_t key_code = keymap_search_layers(pos);
 
   if (key_code == KC_FN) {
     action_key_pressed = make;
@@ -90,14 +87,14 @@ uint8_t keymap_get_key_val(uint8_t pos, bool make) {
   } else {
     if (action_key_pressed) {
       /* We need to process an Action Key event from a seperate map */
-      const uint8_t action_key_code = keymap_actions[0][row][col];
+      const uint8_t action_key_code = keymap_actions[0][pos];
       if (action_key_code != KC_TRNS) {
         key_code = action_key_code;
       }
     }
 
     if (key_code == KC_NFLP) {
-      const uint8_t flip_key_code = keymap_search_layers(row, col);
+      const uint8_t flip_key_code = keymap_search_layers(pos);
       key_code = NUMPAD_FLIP_CODE(flip_key_code);
     }
 
@@ -24,13 +24,18 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define KEYMAP_ROWS 8
-#define KEYMAP_COLS 16
+#include "pico/platform.h"
+
+// Each layer holds one entry per key position.  Positions 00-7F are the plain scancodes, and
+// 80-FF form the extended plane holding the E0-prefixed scancodes, so every key has its own slot.
+#define KEYMAP_POSITIONS 256
+#define KEYMAP_E0(code) (0x80 | (code))
 
 uint8_t keymap_get_key_val(uint8_t pos, bool make);
 bool keymap_is_action_key_pressed(void);
 
-extern const uint8_t keymap_map[][KEYMAP_ROWS][KEYMAP_COLS];
-extern const uint8_t keymap_actions[][KEYMAP_ROWS][KEYMAP_COLS];
+// Keymap tables are read on every key event, so keep them in SRAM when running from flash.
+extern const uint8_t keymap_map[][KEYMAP_POSITIONS] __not_in_flash("keymap_map");
+extern const uint8_t keymap_actions[][KEYMAP_POSITIONS] __not_in_flash("keymap_actions");
 
 #endif /* KEYMAPS_H */
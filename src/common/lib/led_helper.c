@@ -20,81 +20,273 @@
 
 #include "led_helper.h"
 
+#include <string.h>
+
+#include "bsp/board.h"
+#include "hardware/sync.h"
+
 #ifdef CONVERTER_LEDS
 #include "ws2812/ws2812.h"
 #endif
+#ifdef CONVERTER_TIMELINE
+#include "timeline.h"
+#endif
 
-// Initialize the converter state with both keyboard and mouse states set to ready
-converter_state_union converter = {.value = 0xC3};
+// Initialize the converter state with both keyboard and mouse states set to ready.  The relevant
+// interface clears its own ready bit during setup, so any device not built in stays ready.
+state_word_t converter_state = CONVERTER_KB_READY | CONVERTER_MOUSE_READY;
 
-lock_keys_union lock_leds;
+state_word_t lock_leds_state = 0;
+
+static volatile uint32_t converter_error_count = 0;
+static volatile uint32_t converter_activity_ms = 0;
 
 /**
- * @brief Updates the LEDs on the converter based on the current state.
- * This function updates the LEDs on the converter board to reflect the current state of the
- * converter. If the firmware is being flashed, it shows a specific color. If both the keyboard and
- * mouse are ready, it shows a different color. Otherwise, it shows a color indicating that the
- * converter is not ready. Additionally, if the CONVERTER_LOCK_LEDS macro is defined, it updates the
- * lock LEDs based on their states.
- *
- * @note This function includes a small delay to ensure proper timing for the WS2812 LEDs and to
- * prevent flickering.
+ * @brief Publishes new state bits to a shared state word.
+ * The bits selected by `mask` are replaced with those from `bits`.  If this changes the value, the
+ * sequence number of the word is advanced so any observers are notified of the change.  The
+ * read-modify-write is performed with interrupts disabled, so this is safe to call from both IRQ
+ * handlers and task context.
+ *
+ * @param word The state word to update.
+ * @param mask The state bits to be updated.
+ * @param bits The new values for the masked state bits.
+ *
+ * @return true if the value of the state word changed, false otherwise.
  */
-void update_converter_leds(void) {
+bool __not_in_flash_func(state_word_publish)(state_word_t *word, uint8_t mask, uint8_t bits) {
+  uint32_t irq_state = save_and_disable_interrupts();
+  uint32_t current = *word;
+  uint8_t value = (uint8_t)((state_word_value(current) & ~mask) | (bits & mask));
+  bool changed = value != state_word_value(current);
+  if (changed) {
+    *word = ((current & ~STATE_WORD_VALUE_MASK) + STATE_WORD_SEQ_INC) | value;
+  }
+  restore_interrupts(irq_state);
+  return changed;
+}
+
+/**
+ * @brief Checks whether a state word has been republished since it was last observed.
+ * The state word is read once, and compared against the snapshot held in `seen`.  The snapshot is
+ * then updated, so each change is only ever reported once to the same observer.  Observers which
+ * need to re-synchronise (for example after a device reset) can simply clear their snapshot.
+ *
+ * @param word The state word to observe.
+ * @param seen The observer's last seen snapshot of the state word.  Updated on return.
+ *
+ * @return true if the state word has changed since it was last observed, false otherwise.
+ */
+bool state_word_changed(const state_word_t *word, uint32_t *seen) {
+  uint32_t snapshot = *word;
+  if (snapshot == *seen) return false;
+  *seen = snapshot;
+  return true;
+}
+
+/**
+ * @brief Sets or clears a single converter state flag.
+ * This is safe to call from IRQ context, as it only publishes the new state.  The LEDs are then
+ * refreshed from task context by update_converter_status().
+ *
+ * @param flag The converter state flag (CONVERTER_KB_READY, CONVERTER_MOUSE_READY etc).
+ * @param set  true to set the flag, false to clear it.
+ */
+void __not_in_flash_func(converter_set_state)(uint8_t flag, bool set) {
+  state_word_publish(&converter_state, flag, set ? flag : 0);
+}
+
+/**
+ * @brief Records a receive error on one of the device interfaces.
+ * The error count drives the error-rate flash of the status LED.  This is safe to call from IRQ
+ * context, and only increments a counter.
+ */
+void __not_in_flash_func(converter_report_error)(void) {
+  uint32_t irq_state = save_and_disable_interrupts();
+  converter_error_count++;
+  restore_interrupts(irq_state);
+}
+
+/**
+ * @brief Records key activity, which is shown as a short blip on the status LED.
+ */
+void converter_report_activity(void) { converter_activity_ms = board_millis(); }
+
 #ifdef CONVERTER_LEDS
-  // Update the status LED first.
-  if (converter.state.fw_flash) {
-    ws2812_show(CONVERTER_LEDS_STATUS_FWFLASH_COLOR);
-  } else {
-    if (converter.state.kb_ready && converter.state.mouse_ready) {
-      ws2812_show(CONVERTER_LEDS_STATUS_READY_COLOR);
-    } else {
-      ws2812_show(CONVERTER_LEDS_STATUS_NOT_READY_COLOR);
-    }
+/**
+ * @brief Scales an RGB color value by the given level.
+ *
+ * @param color The RGB color value to scale.
+ * @param level The level to scale by, from 0 (off) to 256 (unchanged).
+ *
+ * @return The scaled RGB color value.
+ */
+static inline uint32_t converter_scale_color(uint32_t color, uint32_t level) {
+  uint32_t r = (((color >> 16) & 0xFF) * level) >> 8;
+  uint32_t g = (((color >> 8) & 0xFF) * level) >> 8;
+  uint32_t b = ((color & 0xFF) * level) >> 8;
+  return (r << 16) | (g << 8) | b;
+}
+
+/**
+ * @brief Waits for the WS2812 interface to be ready to accept a new frame.
+ * This is bounded to 1ms, so we never hang if the LEDs failed to initialise.
+ */
+static void converter_leds_wait_ready(void) {
+  uint32_t start_us = time_us_32();
+  while (!ws2812_is_ready() && time_us_32() - start_us < 1000) tight_loop_contents();
+}
+
+/**
+ * @brief Renders the color of the status LED for the current animation frame.
+ * - Firmware flashing is always shown as a solid color.
+ * - While a port is inhibited by flood protection, the status LED is held at the error color.
+ * - While not ready, the status LED breathes using the not ready color.
+ * - When ready, receive errors within the last second flash the status LED, faster for higher
+ *   error rates.  Otherwise each keystroke dims the status LED briefly as an activity blip.
+ *
+ * @param status The converter state bits.
+ * @param now_ms The current time in milliseconds.
+ *
+ * @return The RGB color value for the status LED.
+ */
+static uint32_t converter_render_status(uint8_t status, uint32_t now_ms) {
+  static uint32_t error_window_ms = 0;
+  static uint32_t error_window_count = 0;
+  static uint32_t error_rate = 0;
+
+  if (status & CONVERTER_FW_FLASH) return CONVERTER_LEDS_STATUS_FWFLASH_COLOR;
+  if (status & CONVERTER_PORT_FLOODED) return CONVERTER_LEDS_STATUS_ERROR_COLOR;
+
+  if (!(status & CONVERTER_KB_READY) || !(status & CONVERTER_MOUSE_READY)) {
+    // Triangle wave between 1/16th and full brightness.
+    uint32_t phase = now_ms % CONVERTER_LEDS_BREATHE_PERIOD_MS;
+    uint32_t half = CONVERTER_LEDS_BREATHE_PERIOD_MS / 2;
+    uint32_t level = phase < half ? phase : CONVERTER_LEDS_BREATHE_PERIOD_MS - phase;
+    return converter_scale_color(CONVERTER_LEDS_STATUS_NOT_READY_COLOR, 16 + (level * 240) / half);
+  }
+
+  // Sample the error count once per second to determine the error rate.
+  if (now_ms - error_window_ms >= 1000) {
+    uint32_t count = converter_error_count;
+    error_rate = count - error_window_count;
+    error_window_count = count;
+    error_window_ms = now_ms;
+  }
+  if (error_rate) {
+    uint32_t flash_ms = error_rate >= 10 ? 50 : 500 / error_rate;
+    if ((now_ms / flash_ms) & 1) return CONVERTER_LEDS_STATUS_ERROR_COLOR;
   }
 
+  if (now_ms - converter_activity_ms < CONVERTER_LEDS_ACTIVITY_BLIP_MS) {
+    return converter_scale_color(CONVERTER_LEDS_STATUS_READY_COLOR, 64);
+  }
+  return CONVERTER_LEDS_STATUS_READY_COLOR;
+}
+#endif
+
+/**
+ * @brief Renders and sends a frame to the converter LEDs.
+ * The status LED is rendered first, followed by the Lock LEDs if CONVERTER_LOCK_LEDS is defined.
+ * The frame is only sent if it differs from the previous one, and is transferred to the LEDs by
+ * DMA, so this only costs a few microseconds of CPU time.
+ *
+ * @param status    The converter state bits to display.
+ * @param lock_keys The lock LED state bits to display.
+ * @param now_ms    The current time in milliseconds.
+ *
+ * @return true if the frame has been sent (or is unchanged), false if the LEDs were busy.
+ */
+static bool update_converter_leds(uint8_t status, uint8_t lock_keys, uint32_t now_ms) {
+#ifdef CONVERTER_LEDS
+  static uint32_t last_frame[WS2812_MAX_LEDS];
+  static uint last_count = 0;
+  uint32_t frame[WS2812_MAX_LEDS];
+  uint count = 0;
+
+  if (status & CONVERTER_USB_SUSPENDED) {
+    // Blank all LEDs while the host has suspended us.
+    frame[count++] = 0;
 #ifdef CONVERTER_LOCK_LEDS
-  // Now we update the Lock LEDs.
-  // This is only done if the CONVERTER_LOCK_LEDS macro is defined.
-  ws2812_show(lock_leds.keys.numLock ? CONVERTER_LOCK_LEDS_COLOR : 0);
-  ws2812_show(lock_leds.keys.capsLock ? CONVERTER_LOCK_LEDS_COLOR : 0);
-  ws2812_show(lock_leds.keys.scrollLock ? CONVERTER_LOCK_LEDS_COLOR : 0);
+    frame[count++] = 0;
+    frame[count++] = 0;
+    frame[count++] = 0;
+#endif
+  } else {
+    frame[count++] = converter_render_status(status, now_ms);
+#ifdef CONVERTER_LOCK_LEDS
+    // Now we render the Lock LEDs.
+    // This is only done if the CONVERTER_LOCK_LEDS macro is defined.
+    frame[count++] = lock_keys & LOCK_LED_NUM ? CONVERTER_LOCK_LEDS_COLOR : 0;
+    frame[count++] = lock_keys & LOCK_LED_CAPS ? CONVERTER_LOCK_LEDS_COLOR : 0;
+    frame[count++] = lock_keys & LOCK_LED_SCROLL ? CONVERTER_LOCK_LEDS_COLOR : 0;
+#endif
+  }
+#ifndef CONVERTER_LOCK_LEDS
+  (void)lock_keys;
+#endif
+
+  if (count == last_count && memcmp(frame, last_frame, count * sizeof(frame[0])) == 0) return true;
+
+  // If we are about to reboot into the bootloader, we must ensure the frame is actually sent and
+  // latched before returning.
+  bool fw_flash = status & CONVERTER_FW_FLASH;
+  if (fw_flash) converter_leds_wait_ready();
+  if (!ws2812_show_frame(frame, count)) return false;
+#ifdef CONVERTER_TIMELINE
+  timeline_record(TIMELINE_LED_UPDATE, (uint8_t)count);
 #endif
-  // Add a small delay to ensure we respect the WS2812 timings to reset the data line, and also to
-  // prevent flickering
-  busy_wait_us(60);
+  if (fw_flash) converter_leds_wait_ready();
+
+  memcpy(last_frame, frame, count * sizeof(frame[0]));
+  last_count = count;
+  return true;
+#else
+  (void)status;
+  (void)lock_keys;
+  (void)now_ms;
+  return true;
 #endif
 }
 
 /**
- * @brief Wrapper function to update the converter status LEDs.
- * This is to ensure that the LEDs are only updated if the status has changed.  Calling the
- * update_converter_leds() function every time the status is updated can cause flickering, as well
- * as unnecessary delays.
+ * @brief Task function to update the converter status LEDs.
+ * A new frame is rendered whenever the converter or lock LED state is republished, and otherwise
+ * every CONVERTER_LEDS_FRAME_MS to drive the animations.  Rendering is paused entirely while USB is
+ * suspended, once the LEDs have been blanked.
+ *
+ * @note This must only be called from task context, never from IRQ context.
  */
 void update_converter_status(void) {
-  static uint8_t status;
-  if (status != converter.value) {
-    status = converter.value;
-    update_converter_leds();
+  static uint32_t converter_seen = 0;
+  static uint32_t lock_leds_seen = 0;
+  static uint32_t next_frame_ms = 0;
+  static bool frame_pending = false;
+
+  frame_pending |= state_word_changed(&converter_state, &converter_seen);
+  frame_pending |= state_word_changed(&lock_leds_state, &lock_leds_seen);
+
+  uint8_t status = state_word_value(converter_seen);
+  uint32_t now_ms = board_millis();
+  if (!frame_pending) {
+    if (status & CONVERTER_USB_SUSPENDED) return;
+    if ((int32_t)(now_ms - next_frame_ms) < 0) return;
+  }
+
+  if (update_converter_leds(status, state_word_value(lock_leds_seen), now_ms)) {
+    frame_pending = false;
+    next_frame_ms = now_ms + CONVERTER_LEDS_FRAME_MS;
   }
 }
 
 /**
  * @brief Sets the lock values for the keyboard LEDs based on the given HID lock value.
- * This function updates the lock values for the keyboard LEDs (num lock, caps lock, and scroll
- * lock) based on the given HID lock value. The lock values are stored in the `lock_leds` structure.
- * Additionally, we ensure any controller-specific lock values are updated, regardless of whether we
- * are building that specific controller.
+ * This function publishes the lock values for the keyboard LEDs (num lock, caps lock, and scroll
+ * lock) based on the given HID lock value.  Consumers such as the converter LEDs and the keyboard
+ * interface are notified of the change through the `lock_leds_state` state word.
  *
  * @param lock_val The HID lock value.
  */
 void set_lock_values_from_hid(uint8_t lock_val) {
-  lock_leds.keys.numLock = (unsigned char)(lock_val & 0x01);
-  lock_leds.keys.capsLock = (unsigned char)((lock_val >> 1) & 0x01);
-  lock_leds.keys.scrollLock = (unsigned char)((lock_val >> 2) & 0x01);
-
-#ifdef CONVERTER_LEDS
-  update_converter_leds();
-#endif
+  state_word_publish(&lock_leds_state, LOCK_LED_NUM | LOCK_LED_CAPS | LOCK_LED_SCROLL, lock_val);
 }
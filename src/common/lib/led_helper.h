@@ -21,38 +21,63 @@
 #ifndef LED_HELPER_H
 #define LED_HELPER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "config.h"
 
-// Define Converter State
-typedef struct converter_state {
-  unsigned char kb_ready : 1;
-  unsigned char mouse_ready : 1;
-  unsigned char fw_flash : 1;
-} converter_state;
+// Shared state words.
+// Each state word packs the current state bits into the lower 8 bits, and a change sequence number
+// into the upper 24 bits.  The whole word is read with a single load, so an observer always sees a
+// consistent value/sequence pair, and a changed sequence number is the notification that the value
+// has been republished.  Writers must only update the word through state_word_publish().
+typedef volatile uint32_t state_word_t;
 
-typedef union converter_state_union {
-  converter_state state;
-  unsigned char value;
-} converter_state_union;
+#define STATE_WORD_VALUE_MASK 0x000000FFu
+#define STATE_WORD_SEQ_INC 0x00000100u
 
-extern converter_state_union converter;
+// Define Converter State bits
+#define CONVERTER_KB_READY (1u << 0)
+#define CONVERTER_MOUSE_READY (1u << 1)
+#define CONVERTER_FW_FLASH (1u << 2)
+#define CONVERTER_USB_SUSPENDED (1u << 3)
+#define CONVERTER_PORT_FLOODED (1u << 4)
 
-// Define the LED Locklight Indicators
-typedef struct lock_keys {
-  unsigned char numLock : 1;
-  unsigned char capsLock : 1;
-  unsigned char scrollLock : 1;
-} lock_keys;
+extern state_word_t converter_state;
 
-typedef union lock_keys_union {
-  lock_keys keys;
-  unsigned char value;
-} lock_keys_union;
+// Define the LED Locklight Indicator bits.  These match the bit order of the HID LED Output Report.
+#define LOCK_LED_NUM (1u << 0)
+#define LOCK_LED_CAPS (1u << 1)
+#define LOCK_LED_SCROLL (1u << 2)
 
-extern lock_keys_union lock_leds;
+extern state_word_t lock_leds_state;
 
+/**
+ * @brief Returns the state bits held within a state word snapshot.
+ *
+ * @param snapshot A value previously read from a state word.
+ *
+ * @return The state bits of the snapshot.
+ */
+static inline uint8_t state_word_value(uint32_t snapshot) {
+  return (uint8_t)(snapshot & STATE_WORD_VALUE_MASK);
+}
+
+/**
+ * @brief Reads the current state bits from a state word.
+ *
+ * @param word The state word to observe.
+ *
+ * @return The current state bits.
+ */
+static inline uint8_t state_word_get(const state_word_t *word) { return state_word_value(*word); }
+
+bool state_word_publish(state_word_t *word, uint8_t mask, uint8_t bits);
+bool state_word_changed(const state_word_t *word, uint32_t *seen);
+
+void converter_set_state(uint8_t flag, bool set);
+void converter_report_error(void);
+void converter_report_activity(void);
 void set_lock_values_from_hid(uint8_t lock_val);
 void update_converter_status(void);
 
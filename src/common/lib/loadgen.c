@@ -0,0 +1,454 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "loadgen.h"
+
+// Only built with CONVERTER_LOADGEN, as it depends on the inject functions of each interface.
+#ifdef CONVERTER_LOADGEN
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bsp/board.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+#include "led_helper.h"
+#include "ringbuf.h"
+
+#if KEYBOARD_ENABLED
+#include "keyboard_interface.h"
+#endif
+#if MOUSE_ENABLED
+#include "mouse_interface.h"
+#endif
+#if KEYBOARD_ENABLED && CONVERTER_LOADGEN_PATTERN == LOADGEN_TRACE
+#include "loadgen_trace.h"
+#define LOADGEN_TRACE_STEPS (sizeof(loadgen_trace) / sizeof(loadgen_trace[0]))
+#endif
+
+// Time allowed for the last injected bytes to reach the host once a run has finished.
+#define LOADGEN_DRAIN_MS 100
+
+// Latency is counted in buckets which double in width every LOADGEN_SUB_BUCKETS buckets, so each
+// percentile is reported to within 1/LOADGEN_SUB_BUCKETS of its value, up to around one second.
+#define LOADGEN_SUB_BUCKETS 8
+#define LOADGEN_BUCKETS 160
+
+#if KEYBOARD_ENABLED && CONVERTER_LOADGEN_PATTERN != LOADGEN_TRACE
+// Number of keys used by the synthetic Keyboard patterns.
+#define LOADGEN_KEYS 10
+
+// The home row keys (A to ;), in Scan Code Set 1 and in Sets 2 and 3.
+static const uint8_t loadgen_keys_set1[LOADGEN_KEYS] = {0x1E, 0x1F, 0x20, 0x21, 0x22,
+                                                        0x23, 0x24, 0x25, 0x26, 0x27};
+static const uint8_t loadgen_keys_set2[LOADGEN_KEYS] = {0x1C, 0x1B, 0x23, 0x2B, 0x34,
+                                                        0x33, 0x3B, 0x42, 0x4B, 0x4C};
+#endif
+
+typedef struct {
+  uint64_t due_us;    // Time the next byte is due to be injected
+  uint32_t step;      // Number of keys or packets started
+  uint8_t bytes[4];   // Bytes of the current key or packet
+  uint8_t len;        // Number of bytes in the current key or packet
+  uint8_t index;      // Index of the next byte to inject
+  bool active;        // Cleared once the stream has finished
+  uint32_t injected;  // Bytes accepted by the interface
+  uint32_t dropped;   // Bytes rejected by the interface, as its queue was full or it was busy
+} loadgen_stream_t;
+
+typedef struct {
+  uint32_t reports;                   // Reports accepted by the USB stack
+  uint32_t failed;                    // Reports rejected by the USB stack
+  uint32_t max_us;                    // Highest latency of any report
+  uint32_t buckets[LOADGEN_BUCKETS];  // Number of reports in each latency bucket
+} loadgen_latency_t;
+
+static enum {
+  LOADGEN_IDLE,
+  LOADGEN_RUNNING,
+  LOADGEN_DRAINING,
+} loadgen_state = LOADGEN_IDLE;
+
+static int loadgen_alarm = -1;
+static uint64_t loadgen_stop_us = 0;        // Time the synthetic streams finish
+static loadgen_stream_t loadgen_keyboard = {0};
+static loadgen_stream_t loadgen_mouse = {0};
+static uint8_t loadgen_mouse_packet = 0;    // Bytes in each Mouse packet, or 0 for no Mouse load
+static volatile bool loadgen_done = false;  // Set by the alarm once every stream has finished
+static bool loadgen_measuring = false;      // Set while reports are being measured
+static loadgen_latency_t loadgen_latency[2];
+
+#if KEYBOARD_ENABLED && CONVERTER_LOADGEN_PATTERN != LOADGEN_TRACE
+/**
+ * @brief Returns the bytes of a key press or release in the Keyboard's code set.
+ *
+ * @param stream The stream to fill with the bytes.
+ * @param key    Index of the key to press or release.
+ * @param make   true to press the key, false to release it.
+ */
+static void __not_in_flash_func(loadgen_key_bytes)(loadgen_stream_t *stream, uint8_t key,
+                                                   bool make) {
+  if (strcmp(KEYBOARD_CODESET, "set1") == 0) {
+    stream->bytes[0] = (uint8_t)(loadgen_keys_set1[key] | (make ? 0 : 0x80));
+    stream->len = 1;
+  } else if (make) {
+    stream->bytes[0] = loadgen_keys_set2[key];
+    stream->len = 1;
+  } else {
+    stream->bytes[0] = 0xF0;
+    stream->bytes[1] = loadgen_keys_set2[key];
+    stream->len = 2;
+  }
+}
+#endif
+
+#if KEYBOARD_ENABLED
+/**
+ * @brief Starts the next key of the Keyboard load.
+ * Synthetic patterns only finish once the run is over and no key is held, so no key is ever left
+ * pressed on the host.
+ *
+ * @param stream The Keyboard stream.
+ * @param now_us The current time.
+ *
+ * @return The time until the first byte of the key is due, or -1 if the Keyboard load has finished.
+ */
+static int32_t __not_in_flash_func(loadgen_keyboard_next)(loadgen_stream_t *stream,
+                                                           uint64_t now_us) {
+  uint32_t step = stream->step++;
+#if CONVERTER_LOADGEN_PATTERN == LOADGEN_TRACE
+  (void)now_us;
+  if (step >= LOADGEN_TRACE_STEPS) return -1;
+  stream->bytes[0] = loadgen_trace[step].data;
+  stream->len = 1;
+  return (int32_t)loadgen_trace[step].delay_us;
+#elif CONVERTER_LOADGEN_PATTERN == LOADGEN_TYPING
+  // Each key is pressed and released before the next.
+  if (step % 2 == 0 && now_us >= loadgen_stop_us) return -1;
+  loadgen_key_bytes(stream, (uint8_t)((step / 2) % LOADGEN_KEYS), step % 2 == 0);
+  return CONVERTER_LOADGEN_BYTE_US;
+#elif CONVERTER_LOADGEN_PATTERN == LOADGEN_ROLLOVER
+  // Every key is pressed in turn, then every key is released in turn.
+  uint32_t phase = step % (LOADGEN_KEYS * 2);
+  if (phase == 0 && now_us >= loadgen_stop_us) return -1;
+  loadgen_key_bytes(stream, (uint8_t)(phase % LOADGEN_KEYS), phase < LOADGEN_KEYS);
+  return CONVERTER_LOADGEN_BYTE_US;
+#else
+#error "Unknown CONVERTER_LOADGEN_PATTERN"
+#endif
+}
+#endif
+
+#if MOUSE_ENABLED
+/**
+ * @brief Starts the next packet of the Mouse load.
+ * The pointer is moved back and forth, so it doesn't run off to one edge of the screen.
+ *
+ * @param stream The Mouse stream.
+ * @param now_us The current time.
+ *
+ * @return The time until the first byte of the packet is due, or -1 if the Mouse load has finished.
+ */
+static int32_t __not_in_flash_func(loadgen_mouse_next)(loadgen_stream_t *stream,
+                                                        uint64_t now_us) {
+  if (now_us >= loadgen_stop_us) return -1;
+  bool left = (stream->step++ / 100) % 2;
+  stream->bytes[0] = (uint8_t)(0x08 | (left ? 0x10 : 0));  // Always set, and the X Sign Bit
+  stream->bytes[1] = (uint8_t)(left ? -2 : 2);             // X Movement
+  stream->bytes[2] = 0;                                    // Y Movement
+  stream->bytes[3] = 0;                                    // Z Movement, on an IntelliMouse
+  stream->len = loadgen_mouse_packet;
+  // The packet interval is measured from the first byte of one packet to the first of the next.
+  return (int32_t)(1000000 / CONVERTER_LOADGEN_MOUSE_HZ) -
+         (int32_t)(loadgen_mouse_packet - 1) * CONVERTER_LOADGEN_BYTE_US;
+}
+#endif
+
+/**
+ * @brief Injects every byte of a stream which is now due.
+ * If the alarm was held off, the bytes which were missed are injected back to back, so the average
+ * rate is kept.
+ *
+ * @param stream The stream to service.
+ * @param now_us The current time.
+ * @param inject The interface's inject function.
+ * @param next   The stream's generator, to start the next key or packet.
+ */
+static void __not_in_flash_func(loadgen_stream_service)(loadgen_stream_t *stream, uint64_t now_us,
+                                                         bool (*inject)(uint8_t),
+                                                         int32_t (*next)(loadgen_stream_t *,
+                                                                         uint64_t)) {
+  while (stream->active && stream->due_us <= now_us) {
+    if (inject(stream->bytes[stream->index++])) {
+      stream->injected++;
+    } else {
+      stream->dropped++;
+    }
+
+    if (stream->index < stream->len) {
+      stream->due_us += CONVERTER_LOADGEN_BYTE_US;
+      continue;
+    }
+
+    int32_t delay_us = next(stream, now_us);
+    if (delay_us < 0) {
+      stream->active = false;
+    } else {
+      stream->index = 0;
+      stream->due_us += (uint32_t)delay_us;
+    }
+  }
+}
+
+/**
+ * @brief Load Generator alarm callback.
+ * This stands in for the PIO IRQ handlers, injecting each byte as it falls due, and runs at the
+ * same priority so it can't interleave with them.  The alarm is then rearmed for the next byte due
+ * on either stream.
+ *
+ * @param alarm_num The hardware alarm which fired.
+ */
+static void __not_in_flash_func(loadgen_alarm_callback)(uint alarm_num) {
+  uint64_t next_us;
+  do {
+    uint64_t now_us = time_us_64();
+#if KEYBOARD_ENABLED
+    loadgen_stream_service(&loadgen_keyboard, now_us, keyboard_interface_inject,
+                           loadgen_keyboard_next);
+#endif
+#if MOUSE_ENABLED
+    loadgen_stream_service(&loadgen_mouse, now_us, mouse_interface_inject, loadgen_mouse_next);
+#endif
+    if (!loadgen_keyboard.active && !loadgen_mouse.active) {
+      loadgen_done = true;
+      return;
+    }
+
+    next_us = UINT64_MAX;
+    if (loadgen_keyboard.active) next_us = loadgen_keyboard.due_us;
+    if (loadgen_mouse.active && loadgen_mouse.due_us < next_us) next_us = loadgen_mouse.due_us;
+  } while (hardware_alarm_set_target(alarm_num, from_us_since_boot(next_us)));
+}
+
+/**
+ * @brief Returns the latency bucket for a latency.
+ *
+ * @param latency_us The latency, in microseconds.
+ *
+ * @return The index of the bucket.
+ */
+static uint loadgen_bucket(uint32_t latency_us) {
+  if (latency_us < LOADGEN_SUB_BUCKETS) return latency_us;
+  uint msb = 31u - (uint)__builtin_clz(latency_us);
+  uint bucket = (msb - 2) * LOADGEN_SUB_BUCKETS + ((latency_us >> (msb - 3)) & 7);
+  return bucket < LOADGEN_BUCKETS ? bucket : LOADGEN_BUCKETS - 1;
+}
+
+/**
+ * @brief Returns the highest latency counted in a bucket.
+ *
+ * @param bucket The index of the bucket.
+ *
+ * @return The highest latency in the bucket, in microseconds.
+ */
+static uint32_t loadgen_bucket_max(uint bucket) {
+  if (bucket < LOADGEN_SUB_BUCKETS) return bucket;
+  uint msb = bucket / LOADGEN_SUB_BUCKETS + 2;
+  uint32_t low = (uint32_t)(LOADGEN_SUB_BUCKETS + bucket % LOADGEN_SUB_BUCKETS) << (msb - 3);
+  return low + (1u << (msb - 3)) - 1;
+}
+
+/**
+ * @brief Records a HID report produced by injected load.
+ * The latency is measured from the time the byte which completed the report was injected, to the
+ * time the report was submitted to the USB stack.  Reports are only counted while a run is being
+ * measured.
+ *
+ * @param device   The device the report was produced for.
+ * @param rx_us    The time the byte which completed the report was received (or injected).
+ * @param accepted true if the report was accepted by the USB stack.
+ */
+void loadgen_record_report(loadgen_device_t device, uint32_t rx_us, bool accepted) {
+  if (!loadgen_measuring) return;
+  loadgen_latency_t *latency = &loadgen_latency[device];
+  if (!accepted) {
+    latency->failed++;
+    return;
+  }
+
+  uint32_t latency_us = time_us_32() - rx_us;
+  latency->reports++;
+  if (latency_us > latency->max_us) latency->max_us = latency_us;
+  latency->buckets[loadgen_bucket(latency_us)]++;
+}
+
+/**
+ * @brief Returns a latency percentile.
+ *
+ * @param latency    The latency statistics.
+ * @param percentile The percentile to return, from 1 to 100.
+ *
+ * @return The latency below which the given percentage of reports fell, in microseconds.
+ */
+static uint32_t loadgen_percentile(const loadgen_latency_t *latency, uint32_t percentile) {
+  uint32_t target = (latency->reports * percentile + 99) / 100;
+  uint32_t count = 0;
+  for (uint i = 0; i < LOADGEN_BUCKETS; i++) {
+    count += latency->buckets[i];
+    if (count >= target) {
+      uint32_t value = loadgen_bucket_max(i);
+      return value < latency->max_us ? value : latency->max_us;
+    }
+  }
+  return latency->max_us;
+}
+
+/**
+ * @brief Prints the results of a run for one device.
+ *
+ * @param name       The name of the device, for the diagnostics output.
+ * @param stream     The stream injected into the device's interface.
+ * @param latency    The latency of the reports it produced.
+ * @param high_water The most bytes (or frames) held in the interface's queue at once.
+ * @param run_ms     The duration of the run.
+ */
+static void loadgen_print(const char *name, const loadgen_stream_t *stream,
+                          const loadgen_latency_t *latency, uint8_t high_water, uint32_t run_ms) {
+  if (!stream->injected && !stream->dropped) return;
+  printf("[INFO] Load %s: %lu bytes (%lu/s), %lu dropped, queue high-water %u\n", name,
+         (unsigned long)stream->injected, (unsigned long)(stream->injected * 1000u / run_ms),
+         (unsigned long)stream->dropped, high_water);
+  printf("[INFO] Load %s: %lu reports (%lu/s), %lu failed\n", name,
+         (unsigned long)latency->reports, (unsigned long)(latency->reports * 1000u / run_ms),
+         (unsigned long)latency->failed);
+  if (!latency->reports) return;
+  printf("[INFO] Load %s latency: p50=%luus p90=%luus p99=%luus max=%luus\n", name,
+         (unsigned long)loadgen_percentile(latency, 50),
+         (unsigned long)loadgen_percentile(latency, 90),
+         (unsigned long)loadgen_percentile(latency, 99), (unsigned long)latency->max_us);
+}
+
+/**
+ * @brief Starts a run.
+ * The Mouse load is only injected if a Mouse has been initialised, as the packet format depends on
+ * the type of Mouse.
+ *
+ * @return true if the run was started, false if no hardware alarm was available.
+ */
+static bool loadgen_start(void) {
+  if (loadgen_alarm < 0) {
+    loadgen_alarm = hardware_alarm_claim_unused(false);
+    if (loadgen_alarm < 0) {
+      printf("[ERR] No hardware alarm available for the Load Generator\n");
+      return false;
+    }
+    hardware_alarm_set_callback((uint)loadgen_alarm, &loadgen_alarm_callback);
+    irq_set_priority(TIMER_IRQ_0 + (uint)loadgen_alarm, CONVERTER_IRQ_PRIORITY_PIO);
+  }
+
+  // Leave time to arm the alarm before the first byte is due.
+  uint64_t now_us = time_us_64() + CONVERTER_LOADGEN_BYTE_US;
+  loadgen_stop_us = now_us + (uint64_t)CONVERTER_LOADGEN_RUN_MS * 1000u;
+  loadgen_keyboard = (loadgen_stream_t){0};
+  loadgen_mouse = (loadgen_stream_t){0};
+  memset(loadgen_latency, 0, sizeof(loadgen_latency));
+  ringbuf_take_high_water();
+
+#if KEYBOARD_ENABLED
+  int32_t delay_us = loadgen_keyboard_next(&loadgen_keyboard, now_us);
+  loadgen_keyboard.active = delay_us >= 0;
+  loadgen_keyboard.due_us = now_us + (uint32_t)(delay_us > 0 ? delay_us : 0);
+#endif
+#if MOUSE_ENABLED
+  mouse_interface_take_high_water();
+  loadgen_mouse_packet = CONVERTER_LOADGEN_MOUSE_HZ ? mouse_interface_packet_size() : 0;
+  if (loadgen_mouse_packet) {
+    loadgen_mouse_next(&loadgen_mouse, now_us);
+    loadgen_mouse.active = true;
+    loadgen_mouse.due_us = now_us;
+  } else if (CONVERTER_LOADGEN_MOUSE_HZ) {
+    printf("[WARN] No Mouse initialised, so no Mouse load will be injected\n");
+  }
+#endif
+
+  printf("[INFO] Load Generator run started\n");
+  loadgen_done = false;
+  loadgen_measuring = true;
+  // If we were held off long enough to miss the first byte, the alarm catches up once it fires.
+  uint64_t target_us = now_us;
+  while (hardware_alarm_set_target((uint)loadgen_alarm, from_us_since_boot(target_us))) {
+    target_us = time_us_64() + CONVERTER_LOADGEN_BYTE_US;
+  }
+  return true;
+}
+
+/**
+ * @brief Task function for the Load Generator.
+ * Once the devices are ready, and have been left idle for CONVERTER_LOADGEN_IDLE_MS, a run is
+ * started, injecting the configured load into the same entry points used by the PIO IRQ handlers.
+ * Once every byte has been injected, and the resulting reports have had time to reach the host,
+ * the throughput, drops, queue high-water marks and report latency percentiles of each device are
+ * reported, and the next run follows after another idle period.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void loadgen_task(void) {
+  static uint32_t state_ms = 0;
+  static uint32_t start_ms = 0;
+
+  switch (loadgen_state) {
+    case LOADGEN_IDLE:
+      if (KEYBOARD_ENABLED && !(state_word_get(&converter_state) & CONVERTER_KB_READY)) {
+        state_ms = board_millis();
+        break;
+      }
+      if (board_millis() - state_ms < CONVERTER_LOADGEN_IDLE_MS) break;
+      state_ms = board_millis();
+      if (loadgen_start()) {
+        start_ms = state_ms;
+        loadgen_state = LOADGEN_RUNNING;
+      }
+      break;
+
+    case LOADGEN_RUNNING:
+      if (!loadgen_done) break;
+      state_ms = board_millis();
+      loadgen_state = LOADGEN_DRAINING;
+      break;
+
+    case LOADGEN_DRAINING:
+      if (!ringbuf_is_empty() || board_millis() - state_ms < LOADGEN_DRAIN_MS) break;
+      loadgen_measuring = false;
+      uint32_t run_ms = state_ms - start_ms;
+      if (!run_ms) run_ms = 1;
+      printf("[INFO] Load Generator run finished after %lums\n", (unsigned long)run_ms);
+      loadgen_print("Keyboard", &loadgen_keyboard, &loadgen_latency[LOADGEN_KEYBOARD],
+                    ringbuf_take_high_water(), run_ms);
+#if MOUSE_ENABLED
+      loadgen_print("Mouse", &loadgen_mouse, &loadgen_latency[LOADGEN_MOUSE],
+                    mouse_interface_take_high_water(), run_ms);
+#endif
+      state_ms = board_millis();
+      loadgen_state = LOADGEN_IDLE;
+      break;
+  }
+}
+
+#endif /* CONVERTER_LOADGEN */
@@ -0,0 +1,48 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Keyboard load patterns, selected by CONVERTER_LOADGEN_PATTERN.
+#define LOADGEN_TRACE 0     // Play the trace in loadgen_trace.h once, with its recorded timing
+#define LOADGEN_TYPING 1    // Tap ten keys in turn, one at a time, as fast as the bus allows
+#define LOADGEN_ROLLOVER 2  // Press all ten keys, then release them all, as fast as the bus allows
+
+// A single byte of a recorded trace.
+typedef struct {
+  uint32_t delay_us;  // Time since the previous byte
+  uint8_t data;       // Byte received from the Keyboard
+} loadgen_step_t;
+
+typedef enum {
+  LOADGEN_KEYBOARD,
+  LOADGEN_MOUSE,
+} loadgen_device_t;
+
+void loadgen_record_report(loadgen_device_t device, uint32_t rx_us, bool accepted);
+void loadgen_task(void);
+
+#endif /* LOADGEN_H */
@@ -0,0 +1,71 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOADGEN_TRACE_H
+#define LOADGEN_TRACE_H
+
+#include "loadgen.h"
+#include "pico/platform.h"
+
+// Keyboard trace played by the Load Generator with CONVERTER_LOADGEN_PATTERN set to LOADGEN_TRACE.
+// Each step is the time since the previous byte, and the byte itself, as printed on each KBD>HOST
+// line of a Sniffer capture (CONVERTER_SNIFFER).  The trace is kept in flash, so it can be as long
+// as needed.  This one types "hello world" followed by Enter, in Scan Code Set 2, so should be
+// replaced with a capture in the Keyboard's own code set for anything else.
+static const loadgen_step_t loadgen_trace[] __in_flash("loadgen_trace") = {
+    {0, 0x33},       // h make
+    {90000, 0xF0},   // h break
+    {1082, 0x33},
+    {78918, 0x24},   // e make
+    {79000, 0xF0},   // e break
+    {1066, 0x24},
+    {54934, 0x4B},   // l make
+    {73000, 0xF0},   // l break
+    {1037, 0x4B},
+    {39963, 0x4B},   // l make
+    {104000, 0xF0},  // l break
+    {1090, 0x4B},
+    {10910, 0x44},   // o make
+    {93000, 0xF0},   // o break
+    {1044, 0x44},
+    {52956, 0x29},   // Space make
+    {73000, 0xF0},   // Space break
+    {1070, 0x29},
+    {93930, 0x1D},   // w make
+    {102000, 0xF0},  // w break
+    {1070, 0x1D},
+    {19930, 0x44},   // o make
+    {72000, 0xF0},   // o break
+    {1067, 0x44},
+    {41933, 0x2D},   // r make
+    {97000, 0xF0},   // r break
+    {1090, 0x2D},
+    {37910, 0x4B},   // l make
+    {74000, 0xF0},   // l break
+    {1033, 0x4B},
+    {49967, 0x23},   // d make
+    {75000, 0xF0},   // d break
+    {1066, 0x23},
+    {68934, 0x5A},   // Enter make
+    {97000, 0xF0},   // Enter break
+    {1067, 0x5A},
+};
+
+#endif /* LOADGEN_TRACE_H */
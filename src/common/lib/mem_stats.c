@@ -0,0 +1,144 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mem_stats.h"
+
+#include <malloc.h>
+#include <stdio.h>
+
+#include "bsp/board.h"
+#include "hardware/sync.h"
+
+// Stack and heap boundaries, as defined by the pico-sdk linker scripts.  The core 0 stack (also used
+// by all interrupt handlers on core 0) lives in SCRATCH_Y, and the core 1 stack in SCRATCH_X.  The
+// heap grows upwards from __end__ towards __StackLimit.
+extern char __StackBottom[], __StackTop[];
+extern char __StackOneBottom[], __StackOneTop[];
+extern char __end__[], __StackLimit[];
+
+// Bytes below the current stack pointer which are left unpainted, covering the painting loop itself.
+#define MEM_STATS_STACK_MARGIN 128
+
+static mem_stats_t mem_stats_reported = {0};
+
+/**
+ * @brief Paints a region of stack with the stack paint pattern.
+ *
+ * @param bottom The lowest address of the region to paint.
+ * @param top    The address just past the end of the region to paint.
+ */
+static void mem_stats_paint(uint32_t *bottom, const uint32_t *top) {
+  while (bottom < top) *bottom++ = MEM_STATS_STACK_PAINT;
+}
+
+/**
+ * @brief Measures the high-water mark of a painted stack.
+ * As stacks grow downwards, the high-water mark is found by scanning up from the bottom of the stack
+ * for the first word which no longer holds the paint pattern.
+ *
+ * @param bottom The lowest address of the stack.
+ * @param top    The address just past the top of the stack.
+ *
+ * @return The number of bytes of the stack which have been used.
+ */
+static uint32_t mem_stats_stack_peak(const uint32_t *bottom, const uint32_t *top) {
+  const uint32_t *p = bottom;
+  while (p < top && *p == MEM_STATS_STACK_PAINT) p++;
+  return (uint32_t)(top - p) * sizeof(uint32_t);
+}
+
+/**
+ * @brief Paints the core 0 and core 1 stacks ready for high-water mark measurement.
+ * The core 0 stack is painted from its lowest address up to just below the current stack pointer,
+ * with interrupts disabled so that no handler frame is overwritten while painting.  The core 1 stack
+ * is painted in full, as core 1 is not running at this point.
+ *
+ * @note This should be called as early as possible from main(), before any deep call chains or
+ *       interrupt handlers have run.
+ */
+void mem_stats_init(void) {
+  uint32_t *sp;
+  __asm volatile("mov %0, sp" : "=r"(sp));
+
+  uint32_t state = save_and_disable_interrupts();
+  mem_stats_paint((uint32_t *)__StackBottom, sp - (MEM_STATS_STACK_MARGIN / sizeof(uint32_t)));
+  restore_interrupts(state);
+
+  mem_stats_paint((uint32_t *)__StackOneBottom, (const uint32_t *)__StackOneTop);
+}
+
+/**
+ * @brief Takes a snapshot of the current stack and heap usage.
+ * Heap usage is taken from the newlib allocator.  As the allocator never returns memory to the
+ * system, the space it has claimed so far is also the peak heap footprint.
+ *
+ * @param stats The structure to fill with the current memory usage.
+ */
+void mem_stats_get(mem_stats_t *stats) {
+  stats->stack_size[0] = (uint32_t)(__StackTop - __StackBottom);
+  stats->stack_size[1] = (uint32_t)(__StackOneTop - __StackOneBottom);
+  stats->stack_peak[0] =
+      mem_stats_stack_peak((const uint32_t *)__StackBottom, (const uint32_t *)__StackTop);
+  stats->stack_peak[1] =
+      mem_stats_stack_peak((const uint32_t *)__StackOneBottom, (const uint32_t *)__StackOneTop);
+
+  // mallinfo() takes the allocator lock, so this must only be called from task context.
+  struct mallinfo heap = mallinfo();
+  stats->heap_size = (uint32_t)(__StackLimit - __end__);
+  stats->heap_used = (uint32_t)heap.uordblks;
+  stats->heap_peak = (uint32_t)heap.arena;
+}
+
+/**
+ * @brief Task function for memory usage reporting.
+ * This periodically measures the stack high-water marks and heap usage, and reports them over the
+ * diagnostics output whenever any of the peaks has grown since the last report.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void mem_stats_task(void) {
+  static uint32_t next_sample_ms = 0;
+  uint32_t now_ms = board_millis();
+
+  if ((int32_t)(now_ms - next_sample_ms) < 0) return;
+  next_sample_ms = now_ms + CONVERTER_MEM_STATS_INTERVAL_MS;
+
+  mem_stats_t stats;
+  mem_stats_get(&stats);
+
+  if (stats.stack_peak[0] <= mem_stats_reported.stack_peak[0] &&
+      stats.stack_peak[1] <= mem_stats_reported.stack_peak[1] &&
+      stats.heap_peak <= mem_stats_reported.heap_peak) {
+    return;
+  }
+
+  printf("[DBG] Stack Core 0: %lu/%lu bytes, Core 1: %lu/%lu bytes\n",
+         (unsigned long)stats.stack_peak[0], (unsigned long)stats.stack_size[0],
+         (unsigned long)stats.stack_peak[1], (unsigned long)stats.stack_size[1]);
+  printf("[DBG] Heap: %lu bytes in use, %lu bytes peak of %lu bytes\n",
+         (unsigned long)stats.heap_used, (unsigned long)stats.heap_peak,
+         (unsigned long)stats.heap_size);
+
+  if (stats.stack_size[0] - stats.stack_peak[0] < CONVERTER_MEM_STATS_STACK_HEADROOM) {
+    printf("[WARN] Core 0 stack headroom below %d bytes!\n", CONVERTER_MEM_STATS_STACK_HEADROOM);
+  }
+
+  mem_stats_reported = stats;
+}
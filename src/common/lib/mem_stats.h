@@ -0,0 +1,43 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Pattern painted over unused stack, so we can later find how far down each stack has been used.
+#define MEM_STATS_STACK_PAINT 0xDEADBEEFu
+
+typedef struct {
+  uint32_t stack_size[2];  // Size of the core 0 and core 1 stacks, in bytes
+  uint32_t stack_peak[2];  // High-water mark of the core 0 and core 1 stacks, in bytes
+  uint32_t heap_size;      // Space available to the heap, in bytes
+  uint32_t heap_used;      // Heap currently allocated, in bytes
+  uint32_t heap_peak;      // Heap claimed from the system so far, in bytes
+} mem_stats_t;
+
+void mem_stats_init(void);
+void mem_stats_get(mem_stats_t *stats);
+void mem_stats_task(void);
+
+#endif /* MEM_STATS_H */
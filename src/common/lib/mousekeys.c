@@ -0,0 +1,257 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mousekeys.h"
+
+#include <stdio.h>
+
+#include "bsp/board.h"
+#include "hid_interface.h"
+#include "hid_keycodes.h"
+
+#define MOUSEKEYS_COUNT (KC_ACL2 - KC_MS_U + 1)
+#define MOUSEKEYS_BIT(code) (1u << ((code) - KC_MS_U))
+
+#define MOUSEKEYS_MOVE_MASK                                                 \
+  (MOUSEKEYS_BIT(KC_MS_U) | MOUSEKEYS_BIT(KC_MS_D) | MOUSEKEYS_BIT(KC_MS_L) | \
+   MOUSEKEYS_BIT(KC_MS_R))
+#define MOUSEKEYS_WHEEL_MASK (MOUSEKEYS_BIT(KC_WH_U) | MOUSEKEYS_BIT(KC_WH_D))
+#define MOUSEKEYS_BUTTON_SHIFT (KC_BTN1 - KC_MS_U)
+#define MOUSEKEYS_BUTTON_MASK (0x1Fu << MOUSEKEYS_BUTTON_SHIFT)
+
+// Longest gap integrated in one step, so a stall in the main loop doesn't make the cursor jump.
+#define MOUSEKEYS_MAX_STEP_MS 8
+
+typedef struct {
+  uint16_t start;    // Speed when the movement keys are first pressed
+  uint16_t max;      // Speed once they have been held for ramp_ms
+  uint16_t ramp_ms;  // Time taken to reach the maximum speed, or 0 for a constant speed
+} mousekeys_profile_t;
+
+// Acceleration profiles.  The first is used unless one of the ACL keys is held.
+static const mousekeys_profile_t mousekeys_profiles[] = {
+    {CONVERTER_MOUSEKEYS_SPEED_START, CONVERTER_MOUSEKEYS_SPEED_MAX, CONVERTER_MOUSEKEYS_RAMP_MS},
+    {CONVERTER_MOUSEKEYS_ACCEL0_SPEED, CONVERTER_MOUSEKEYS_ACCEL0_SPEED, 0},
+    {CONVERTER_MOUSEKEYS_ACCEL1_SPEED, CONVERTER_MOUSEKEYS_ACCEL1_SPEED, 0},
+    {CONVERTER_MOUSEKEYS_ACCEL2_SPEED, CONVERTER_MOUSEKEYS_ACCEL2_SPEED, 0},
+};
+
+static uint16_t mousekeys_held = 0;             // Bitmap of held Mouse Keys (MOUSEKEYS_BIT)
+static uint8_t mousekeys_pos[MOUSEKEYS_COUNT];  // Interface position each Mouse Key was pressed on
+static bool mousekeys_buttons_changed = false;  // A button has changed since the last report
+static uint32_t mousekeys_move_start_ms = 0;    // Time the movement keys were first pressed
+static uint32_t mousekeys_tick_ms = 0;          // Time motion was last integrated up to
+static int32_t mousekeys_accum[3] = {0, 0, 0};  // Motion not yet reported, in 1/256ths
+static int8_t mousekeys_offered[3] = {0, 0, 0};  // Whole pixels merged into the last report
+
+// Motion held back while the Mouse endpoint is busy is limited to what a single report can carry.
+#define MOUSEKEYS_ACCUM_LIMIT (127 * 256)
+
+/**
+ * @brief Handles a key event which may be a Mouse Key.
+ * Each Mouse Key is released by the position it was pressed on, rather than by its code, so that
+ * releasing the Function key first can't leave the cursor moving or a button held.
+ *
+ * @param pos  The interface position of the key.
+ * @param code The key code the keymap returned for the position.
+ * @param make Whether the key was pressed (true) or released (false).
+ *
+ * @return true if the event was a Mouse Key, and has been handled.
+ */
+bool __not_in_flash_func(mousekeys_handle_key)(uint8_t pos, uint8_t code, bool make) {
+  if (make) {
+    if (!IS_MOUSEKEY(code)) return false;
+    uint16_t bit = (uint16_t)MOUSEKEYS_BIT(code);
+    if (!(mousekeys_held & (MOUSEKEYS_MOVE_MASK | MOUSEKEYS_WHEEL_MASK))) {
+      // Start integrating from this press, rather than from whenever we were last active.
+      mousekeys_tick_ms = board_millis();
+    }
+    if ((bit & MOUSEKEYS_MOVE_MASK) && !(mousekeys_held & MOUSEKEYS_MOVE_MASK)) {
+      mousekeys_move_start_ms = board_millis();
+    }
+    if (bit & MOUSEKEYS_BUTTON_MASK) mousekeys_buttons_changed = true;
+    mousekeys_held |= bit;
+    mousekeys_pos[code - KC_MS_U] = pos;
+    return true;
+  }
+
+  uint16_t released = 0;
+  for (uint8_t i = 0; i < MOUSEKEYS_COUNT; i++) {
+    if ((mousekeys_held & (1u << i)) && mousekeys_pos[i] == pos) released |= (uint16_t)(1u << i);
+  }
+  if (!released) return false;
+
+  mousekeys_held &= (uint16_t)~released;
+  if (released & MOUSEKEYS_BUTTON_MASK) mousekeys_buttons_changed = true;
+  // Drop any fraction of a pixel left over once the keys driving it are released.
+  if (!(mousekeys_held & MOUSEKEYS_MOVE_MASK)) mousekeys_accum[0] = mousekeys_accum[1] = 0;
+  if (!(mousekeys_held & MOUSEKEYS_WHEEL_MASK)) mousekeys_accum[2] = 0;
+  return true;
+}
+
+/**
+ * @brief Returns the current cursor speed.
+ * The speed comes from the acceleration profile selected by the highest held ACL key, ramping
+ * linearly from its start to its maximum speed over the time the movement keys have been held.
+ *
+ * @param now_ms The current time in milliseconds.
+ *
+ * @return The cursor speed in 1/256ths of a pixel per millisecond.
+ */
+static uint32_t mousekeys_speed(uint32_t now_ms) {
+  uint8_t profile = 0;
+  if (mousekeys_held & MOUSEKEYS_BIT(KC_ACL2)) {
+    profile = 3;
+  } else if (mousekeys_held & MOUSEKEYS_BIT(KC_ACL1)) {
+    profile = 2;
+  } else if (mousekeys_held & MOUSEKEYS_BIT(KC_ACL0)) {
+    profile = 1;
+  }
+
+  const mousekeys_profile_t *p = &mousekeys_profiles[profile];
+  uint32_t held_ms = now_ms - mousekeys_move_start_ms;
+  if (held_ms >= p->ramp_ms) return p->max;
+  return p->start + (uint32_t)(p->max - p->start) * held_ms / p->ramp_ms;
+}
+
+/**
+ * @brief Returns the whole pixels of pending motion in an accumulator.
+ *
+ * @param accum The accumulator, in 1/256ths.
+ *
+ * @return The whole pixels pending, limited to the range of a Mouse report.
+ */
+static int8_t mousekeys_whole(int32_t accum) {
+  int32_t whole = accum / 256;
+  if (whole > 127) whole = 127;
+  if (whole < -127) whole = -127;
+  return (int8_t)whole;
+}
+
+/**
+ * @brief Adds a value to a Mouse report axis, saturating at the range of the report.
+ *
+ * @param value The axis value.
+ * @param add   The value to add.
+ *
+ * @return The combined value.
+ */
+static int8_t mousekeys_add(int8_t value, int8_t add) {
+  int16_t sum = (int16_t)(value + add);
+  if (sum > 127) return 127;
+  if (sum < -127) return -127;
+  return (int8_t)sum;
+}
+
+/**
+ * @brief Merges the Mouse Key state into a Mouse report.
+ * Called by handle_mouse_report() for every Mouse report, whether it came from the Mouse or from
+ * mousekeys_task(), so the held buttons and any pending motion are combined with a real Mouse.
+ * The pending motion and button change are left in place until mousekeys_merged() confirms the
+ * report was accepted, so a report which fails to send loses nothing.
+ *
+ * @param buttons The report button bitmap, to which the held buttons are added.
+ * @param motion  The report x, y and wheel values, to which the pending motion is added.
+ */
+void __not_in_flash_func(mousekeys_merge)(uint8_t *buttons, int8_t motion[3]) {
+  *buttons |= (uint8_t)((mousekeys_held & MOUSEKEYS_BUTTON_MASK) >> MOUSEKEYS_BUTTON_SHIFT);
+  for (uint8_t i = 0; i < 3; i++) {
+    mousekeys_offered[i] = mousekeys_whole(mousekeys_accum[i]);
+    motion[i] = mousekeys_add(motion[i], mousekeys_offered[i]);
+  }
+}
+
+/**
+ * @brief Marks the Mouse Key state merged by mousekeys_merge() as reported.
+ * Called by handle_mouse_report() once the report has been accepted, removing the motion it carried
+ * from the accumulators and clearing any button change.
+ */
+void __not_in_flash_func(mousekeys_merged)(void) {
+  for (uint8_t i = 0; i < 3; i++) {
+    mousekeys_accum[i] -= mousekeys_offered[i] * 256;
+    mousekeys_offered[i] = 0;
+  }
+  mousekeys_buttons_changed = false;
+}
+
+/**
+ * @brief Returns the direction of an axis from the pair of keys driving it.
+ *
+ * @param positive The Mouse Key moving in the positive direction.
+ * @param negative The Mouse Key moving in the negative direction.
+ *
+ * @return 1, -1, or 0 if neither or both keys are held.
+ */
+static int32_t mousekeys_direction(uint8_t positive, uint8_t negative) {
+  return (int32_t)!!(mousekeys_held & MOUSEKEYS_BIT(positive)) -
+         (int32_t)!!(mousekeys_held & MOUSEKEYS_BIT(negative));
+}
+
+/**
+ * @brief Adds motion to an accumulator, limited to MOUSEKEYS_ACCUM_LIMIT.
+ *
+ * @param accum The accumulator, in 1/256ths.
+ * @param add   The motion to add, in 1/256ths.
+ */
+static void mousekeys_accumulate(int32_t *accum, int32_t add) {
+  *accum += add;
+  if (*accum > MOUSEKEYS_ACCUM_LIMIT) *accum = MOUSEKEYS_ACCUM_LIMIT;
+  if (*accum < -MOUSEKEYS_ACCUM_LIMIT) *accum = -MOUSEKEYS_ACCUM_LIMIT;
+}
+
+/**
+ * @brief Task function for Mouse Keys.
+ * While any movement or wheel key is held, the motion since the last call is integrated at the
+ * current speed.  A report is then offered to handle_mouse_report() whenever there is a whole pixel
+ * to send, or a button has changed.  As this only succeeds once the host has collected the previous
+ * Mouse report, reports follow the polling of the Mouse endpoint, giving a smooth update every 1ms
+ * poll.  When no Mouse Key is held, this returns straight away.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void mousekeys_task(void) {
+  if (!mousekeys_held && !mousekeys_buttons_changed) return;
+
+  uint32_t now_ms = board_millis();
+  uint32_t elapsed_ms = now_ms - mousekeys_tick_ms;
+  if (elapsed_ms) {
+    mousekeys_tick_ms = now_ms;
+    if (elapsed_ms > MOUSEKEYS_MAX_STEP_MS) elapsed_ms = MOUSEKEYS_MAX_STEP_MS;
+
+    if (mousekeys_held & MOUSEKEYS_MOVE_MASK) {
+      int32_t step = (int32_t)(mousekeys_speed(now_ms) * elapsed_ms);
+      mousekeys_accumulate(&mousekeys_accum[0], mousekeys_direction(KC_MS_R, KC_MS_L) * step);
+      mousekeys_accumulate(&mousekeys_accum[1], mousekeys_direction(KC_MS_D, KC_MS_U) * step);
+    }
+    if (mousekeys_held & MOUSEKEYS_WHEEL_MASK) {
+      int32_t step = CONVERTER_MOUSEKEYS_WHEEL_SPEED * (int32_t)elapsed_ms;
+      mousekeys_accumulate(&mousekeys_accum[2], mousekeys_direction(KC_WH_U, KC_WH_D) * step);
+    }
+  }
+
+  bool pending = mousekeys_buttons_changed;
+  for (uint8_t i = 0; i < 3; i++) {
+    pending |= mousekeys_accum[i] <= -256 || mousekeys_accum[i] >= 256;
+  }
+  if (!pending) return;
+
+  int8_t motion[3] = {0, 0, 0};
+  handle_mouse_report(NULL, motion);
+}
@@ -0,0 +1,34 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOUSEKEYS_H
+#define MOUSEKEYS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+
+bool mousekeys_handle_key(uint8_t pos, uint8_t code, bool make);
+void mousekeys_merge(uint8_t *buttons, int8_t motion[3]);
+void mousekeys_merged(void);
+void mousekeys_task(void);
+
+#endif /* MOUSEKEYS_H */
@@ -0,0 +1,62 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "perf_counters.h"
+
+#include <stdio.h>
+
+/**
+ * @brief Starts the SysTick timer as a free running cycle counter.
+ * SysTick is clocked from the processor clock and reloads at its full 24-bit range, with its
+ * interrupt left disabled.
+ */
+void perf_counters_init(void) {
+  systick_hw->csr = 0;
+  systick_hw->rvr = PERF_CYCLES_MASK;
+  systick_hw->cvr = 0;
+  systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+}
+
+/**
+ * @brief Adds a sample to a cycle count statistic.
+ *
+ * @param stat   The statistic to add the sample to.
+ * @param cycles The number of cycles of the sample.
+ */
+void perf_stat_add(perf_stat_t *stat, uint32_t cycles) {
+  if (stat->count == 0 || cycles < stat->min) stat->min = cycles;
+  if (cycles > stat->max) stat->max = cycles;
+  stat->total += cycles;
+  stat->count++;
+}
+
+/**
+ * @brief Prints a cycle count statistic over the diagnostics output, and resets it.
+ *
+ * @param name The name to print the statistic under.
+ * @param stat The statistic to print.
+ */
+void perf_stat_print(const char *name, perf_stat_t *stat) {
+  if (stat->count == 0) return;
+  printf("[DBG] %s: n=%lu min=%lu avg=%lu max=%lu cycles\n", name, (unsigned long)stat->count,
+         (unsigned long)stat->min, (unsigned long)(stat->total / stat->count),
+         (unsigned long)stat->max);
+  *stat = (perf_stat_t){0};
+}
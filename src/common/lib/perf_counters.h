@@ -0,0 +1,61 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+#include "hardware/structs/systick.h"
+
+// SysTick is a 24-bit down counter, so cycle counts wrap every 2^24 cycles (~134ms at 125MHz).
+#define PERF_CYCLES_MASK 0x00FFFFFFu
+
+typedef struct {
+  uint32_t count;  // Number of samples
+  uint32_t total;  // Total cycles of all samples
+  uint32_t min;    // Fewest cycles of any sample
+  uint32_t max;    // Most cycles of any sample
+} perf_stat_t;
+
+/**
+ * @brief Returns the current value of the cycle counter.
+ *
+ * @return The current cycle counter value, for use with perf_cycles_since().
+ */
+static inline uint32_t perf_cycles_now(void) { return systick_hw->cvr; }
+
+/**
+ * @brief Returns the number of cycles elapsed since a previous cycle counter value.
+ *
+ * @param start A value previously returned by perf_cycles_now().
+ *
+ * @return The number of cycles elapsed, which is only valid for intervals shorter than the counter
+ *         wrap period.
+ */
+static inline uint32_t perf_cycles_since(uint32_t start) {
+  return (start - systick_hw->cvr) & PERF_CYCLES_MASK;
+}
+
+void perf_counters_init(void);
+void perf_stat_add(perf_stat_t *stat, uint32_t cycles);
+void perf_stat_print(const char *name, perf_stat_t *stat);
+
+#endif /* PERF_COUNTERS_H */
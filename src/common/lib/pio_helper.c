@@ -22,6 +22,8 @@
 
 #include <stdio.h>
 
+#include "bsp/board.h"
+
 /**
  * @brief Finds an available PIO (Programmable I/O) instance for a given PIO program.
  * This function checks if there is space in either PIO0 or PIO1 for the specified PIO program, and
@@ -66,4 +68,132 @@ void pio_restart(PIO pio, uint sm, uint offset) {
   pio_sm_restart(pio, sm);
   pio_sm_exec(pio, sm, pio_encode_jmp(offset));
   printf("[DBG] State Machine Restarted\n");
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Initialises the resynchronisation tracking of a port.
+ *
+ * @param resync    The resynchronisation tracking of the port.
+ * @param pio       The PIO instance running the port's interface program.
+ * @param sm        The state machine running the port's interface program.
+ * @param clock_pin The CLK pin of the port.
+ */
+void pio_resync_init(pio_resync_t *resync, PIO pio, uint sm, uint clock_pin) {
+  resync->pio = pio;
+  resync->sm = sm;
+  resync->clock_pin = clock_pin;
+  resync->waiting = false;
+  resync->high_us = 0;
+}
+
+/**
+ * @brief Realigns the specified PIO state machine with the incoming frames.
+ * This is a lighter alternative to pio_restart() for recovering from a misaligned frame.  Only the
+ * internal state of the state machine (shift counters, ISR contents, delay and any stalled
+ * instruction) is cleared.  The FIFOs are left untouched, so any complete frames already received
+ * behind the bad one are still processed, and any command waiting to be sent is still sent.
+ *
+ * The state machine is left stopped, as the device may still be part way through sending a frame,
+ * and resuming now would read the rest of it as a new one.  The interface programs have no room
+ * left for an idle line timer, so pio_resync_task() resumes it once CLK has been HIGH for longer
+ * than a whole frame.  Any command written to the TX FIFO in the meantime is only sent once it has
+ * resumed.
+ *
+ * @param resync The resynchronisation tracking of the port.
+ * @param pc     The address to resume from, which should be where the program waits for the line
+ *               before looking for the next Start Bit.
+ *
+ * @note This is safe to call from IRQ context.
+ */
+void __not_in_flash_func(pio_resync)(pio_resync_t *resync, uint pc) {
+  pio_sm_set_enabled(resync->pio, resync->sm, false);
+  pio_sm_restart(resync->pio, resync->sm);
+  pio_sm_exec(resync->pio, resync->sm, pio_encode_jmp(pc));
+  resync->high_us = time_us_32();
+  resync->waiting = true;
+}
+
+/**
+ * @brief Resumes a resynchronised state machine once its line has been idle for long enough.
+ * If the state machine has been enabled by anything else in the meantime, such as the port being
+ * restarted or moved, there is nothing left to wait for.
+ *
+ * @param resync The resynchronisation tracking of the port.
+ *
+ * @return true while the state machine is stopped waiting for the line to idle, false otherwise.
+ *
+ * @note This should be called from the port's interface task.  As CLK is polled, a single clock
+ *       pulse falling between two calls can be missed, but a frame is made of at least nine, so
+ *       the main loop would have to stall for most of a frame to miss one entirely.
+ */
+bool pio_resync_task(pio_resync_t *resync) {
+  if (!resync->waiting) return false;
+
+  if (resync->pio->ctrl & (1u << (PIO_CTRL_SM_ENABLE_LSB + resync->sm))) {
+    resync->waiting = false;
+    return false;
+  }
+
+  uint32_t now_us = time_us_32();
+  if (!gpio_get(resync->clock_pin)) {
+    resync->high_us = now_us;
+    return true;
+  }
+  if (now_us - resync->high_us <= PIO_RESYNC_IDLE_US) return true;
+
+  resync->waiting = false;
+  pio_sm_set_enabled(resync->pio, resync->sm, true);
+  return false;
+}
+
+/**
+ * @brief Majority votes a frame which was sampled three times per bit.
+ * Each bit is reduced to the value seen by at least two of its three samples, so a single glitch
+ * near the sample point no longer corrupts the bit.  Any bit where the samples did not all agree is
+ * counted as a disagreement, which gives an indication of the noise on the line.
+ *
+ * @param samples The samples, with the three samples of each bit held in consecutive bits (earliest
+ *                sample first), starting from bit 0.
+ * @param bits    The number of bits to vote on, up to a maximum of 10.
+ * @param stats   The statistics to count any disagreements against.
+ *
+ * @return The voted bits, with the first bit held in bit 0.
+ */
+uint16_t __not_in_flash_func(pio_majority_vote)(uint32_t samples, uint bits,
+                                                pio_vote_stats_t *stats) {
+  uint32_t a = samples;
+  uint32_t b = samples >> 1;
+  uint32_t c = samples >> 2;
+  uint32_t vote = (a & b) | (b & c) | (a & c);
+  uint32_t differ = (a ^ b) | (b ^ c);
+  uint16_t result = 0;
+
+  for (uint i = 0; i < bits; i++) {
+    result |= (uint16_t)(((vote >> (3 * i)) & 0x1) << i);
+    if ((differ >> (3 * i)) & 0x1) stats->disagreements++;
+  }
+  return result;
+}
+
+/**
+ * @brief Reports any new majority vote disagreements for an interface.
+ * This is rate limited to one report every PIO_VOTE_REPORT_MS, so a noisy line can't flood the
+ * diagnostics output.
+ *
+ * @param name  The name of the interface, for the diagnostics output.
+ * @param stats The majority vote statistics of the interface.
+ *
+ * @note This should only be called from task context.
+ */
+void pio_vote_report(const char *name, pio_vote_stats_t *stats) {
+  uint32_t disagreements = stats->disagreements;
+  if (disagreements == stats->reported) return;
+
+  uint32_t now_ms = board_millis();
+  if ((int32_t)(now_ms - stats->next_report_ms) < 0) return;
+  stats->next_report_ms = now_ms + PIO_VOTE_REPORT_MS;
+
+  printf("[DBG] %s bit sample disagreements: %lu (+%lu)\n", name, (unsigned long)disagreements,
+         (unsigned long)(disagreements - stats->reported));
+  stats->reported = disagreements;
+}
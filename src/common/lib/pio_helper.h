@@ -23,7 +23,36 @@
 
 #include "hardware/pio.h"
 
+// Minimum interval between reports of majority vote disagreements.
+#define PIO_VOTE_REPORT_MS 1000
+
+// How long CLK must be HIGH before a resynchronised state machine resumes.  This is longer than a
+// whole frame at the slowest clock of any supported protocol (11 bits at 10kHz), so the line is
+// known to be idle between frames, rather than just between two bits of a frame.
+#define PIO_RESYNC_IDLE_US 2000
+
+typedef struct {
+  volatile uint32_t disagreements;  // Number of bits where the three samples did not all agree
+  uint32_t reported;                // Number of disagreements at the time of the last report
+  uint32_t next_report_ms;          // Earliest time the next report can be made
+} pio_vote_stats_t;
+
+// Tracks a state machine which has been stopped to realign with the incoming frames, until the
+// line has been idle for long enough for it to resume.
+typedef struct {
+  PIO pio;                // PIO instance running the port's interface program
+  uint sm;                // State machine running the port's interface program
+  uint clock_pin;         // CLK pin, which must be HIGH for PIO_RESYNC_IDLE_US before resuming
+  volatile bool waiting;  // Set while the state machine is stopped, waiting for the line to idle
+  uint32_t high_us;       // Time CLK was last seen LOW (or the wait started)
+} pio_resync_t;
+
 PIO find_available_pio(const pio_program_t *program);
 void pio_restart(PIO pio, uint sm, uint offset);
+void pio_resync_init(pio_resync_t *resync, PIO pio, uint sm, uint clock_pin);
+void pio_resync(pio_resync_t *resync, uint pc);
+bool pio_resync_task(pio_resync_t *resync);
+uint16_t pio_majority_vote(uint32_t samples, uint bits, pio_vote_stats_t *stats);
+void pio_vote_report(const char *name, pio_vote_stats_t *stats);
 
 #endif /* PIO_HELPER_H */
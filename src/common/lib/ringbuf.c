@@ -29,6 +29,12 @@
 
 #include "ringbuf.h"
 
+#include "pico/platform.h"
+
+#ifdef CONVERTER_RINGBUF_STAMPS
+#include "hardware/timer.h"
+#endif
+
 #define BUF_SIZE 16
 
 typedef struct {
@@ -45,6 +51,16 @@ static ringbuf_t rbuf = {.buffer = buf,  // Cast to array of chars for initializ
                          .tail = 0,
                          .size_mask = BUF_SIZE - 1};
 
+#ifdef CONVERTER_RINGBUF_STAMPS
+// Time each byte was queued, and of the byte last retrieved, in microseconds.
+static uint32_t stamps[BUF_SIZE];
+static uint32_t last_stamp;
+#endif
+
+#ifdef CONVERTER_LOADGEN
+static uint8_t high_water = 0;  // Most bytes held at once since the last ringbuf_take_high_water()
+#endif
+
 /**
  * @brief Retrieves the next element from the ring buffer.
  * This function retrieves the next element from the ring buffer. If the buffer is empty, it will
@@ -52,9 +68,12 @@ static ringbuf_t rbuf = {.buffer = buf,  // Cast to array of chars for initializ
  *
  * @return The next element from the ring buffer, or -1 if the buffer is empty.
  */
-int16_t ringbuf_get() {
+int16_t __not_in_flash_func(ringbuf_get)() {
   if (ringbuf_is_empty()) return -1;
   uint8_t data = rbuf.buffer[rbuf.tail];
+#ifdef CONVERTER_RINGBUF_STAMPS
+  last_stamp = stamps[rbuf.tail];
+#endif
   rbuf.tail++;
   rbuf.tail &= rbuf.size_mask;
   return data;
@@ -69,13 +88,20 @@ int16_t ringbuf_get() {
  * @return Returns true if the data was successfully put into the ring buffer, false if the ring
  *         buffer is full.
  */
-bool ringbuf_put(uint8_t data) {
+bool __not_in_flash_func(ringbuf_put)(uint8_t data) {
   if (ringbuf_is_full()) {
     return false;
   }
   rbuf.buffer[rbuf.head] = data;
+#ifdef CONVERTER_RINGBUF_STAMPS
+  stamps[rbuf.head] = time_us_32();
+#endif
   rbuf.head++;
   rbuf.head &= rbuf.size_mask;
+#ifdef CONVERTER_LOADGEN
+  uint8_t used = (uint8_t)((rbuf.head - rbuf.tail) & rbuf.size_mask);
+  if (used > high_water) high_water = used;
+#endif
   return true;
 }
 
@@ -85,7 +111,7 @@ bool ringbuf_put(uint8_t data) {
  *
  * @return true if the ring buffer is empty, false otherwise.
  */
-bool ringbuf_is_empty() { return (rbuf.head == rbuf.tail); }
+bool __not_in_flash_func(ringbuf_is_empty)() { return (rbuf.head == rbuf.tail); }
 
 /**
  * @brief Checks if the ring buffer is full.
@@ -95,7 +121,9 @@ bool ringbuf_is_empty() { return (rbuf.head == rbuf.tail); }
  *
  * @return true if the ring buffer is full, false otherwise.
  */
-bool ringbuf_is_full() { return (((rbuf.head + 1) & rbuf.size_mask) == rbuf.tail); }
+bool __not_in_flash_func(ringbuf_is_full)() {
+  return (((rbuf.head + 1) & rbuf.size_mask) == rbuf.tail);
+}
 
 /**
  * @brief Resets the ring buffer.
@@ -106,3 +134,27 @@ void ringbuf_reset() {
   rbuf.head = 0;
   rbuf.tail = 0;
 }
+
+#ifdef CONVERTER_RINGBUF_STAMPS
+/**
+ * @brief Returns the time the byte last retrieved by ringbuf_get() was queued.
+ * The byte is queued from the PIO IRQ handler once its frame has been received, so this is the
+ * frame time of the scancode being processed.
+ *
+ * @return The time the byte was queued, from time_us_32().
+ */
+uint32_t __not_in_flash_func(ringbuf_get_time_us)(void) { return last_stamp; }
+#endif
+
+#ifdef CONVERTER_LOADGEN
+/**
+ * @brief Returns the most bytes held in the ring buffer at once, and starts measuring again.
+ *
+ * @return The most bytes held since the last call.
+ */
+uint8_t ringbuf_take_high_water(void) {
+  uint8_t value = high_water;
+  high_water = 0;
+  return value;
+}
+#endif
@@ -33,10 +33,19 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "config.h"
+
 int16_t ringbuf_get();
 bool ringbuf_put(uint8_t data);
 bool ringbuf_is_empty();
 bool ringbuf_is_full();
 void ringbuf_reset();
 
+#ifdef CONVERTER_RINGBUF_STAMPS
+uint32_t ringbuf_get_time_us(void);
+#endif
+#ifdef CONVERTER_LOADGEN
+uint8_t ringbuf_take_high_water(void);
+#endif
+
 #endif /* RINGBUF_H */
@@ -0,0 +1,221 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "timeline.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bsp/board.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+static const char *const timeline_event_names[] = {
+    [TIMELINE_KEYBOARD_RX] = "KB RX",       [TIMELINE_MOUSE_RX] = "MS RX",
+    [TIMELINE_HID_KEYBOARD] = "HID KB",     [TIMELINE_HID_MOUSE] = "HID MS",
+    [TIMELINE_LED_UPDATE] = "LED",          [TIMELINE_BUZZER_ALARM] = "BUZZER",
+    [TIMELINE_USB_CONNECT] = "USB CONNECT", [TIMELINE_USB_DISCONNECT] = "USB DISCONNECT",
+};
+
+typedef struct {
+  uint32_t count;  // Number of reports measured
+  uint32_t total;  // Total latency of all reports, in microseconds
+  uint32_t max;    // Highest latency of any report, in microseconds
+} timeline_latency_t;
+
+static timeline_entry_t timeline[TIMELINE_SIZE];
+static volatile uint32_t timeline_head = 0;     // Total number of events recorded
+static volatile bool timeline_frozen = false;   // Set while the timeline is being dumped
+static volatile uint32_t timeline_dropped = 0;  // Events not recorded while frozen
+
+/**
+ * @brief Records an event on the timeline.
+ * The event is timestamped and written to the timeline with interrupts disabled, so this is safe to
+ * call from both IRQ handlers and task context.  Events are dropped while the timeline is frozen.
+ *
+ * @param event The event to record.
+ * @param data  Event specific data to record alongside the event.
+ */
+void __not_in_flash_func(timeline_record)(timeline_event_t event, uint8_t data) {
+  uint32_t irq_state = save_and_disable_interrupts();
+  if (timeline_frozen) {
+    timeline_dropped++;
+  } else {
+    timeline_entry_t *entry = &timeline[timeline_head & (TIMELINE_SIZE - 1)];
+    entry->time_us = time_us_32();
+    entry->event = (uint8_t)event;
+    entry->data = data;
+    timeline_head++;
+  }
+  restore_interrupts(irq_state);
+}
+
+/**
+ * @brief Reads an event from the timeline.
+ *
+ * @param index The sequence number of the event to read.
+ * @param entry The entry to fill with the event.
+ *
+ * @return true if the event was read, false if it has already been overwritten.
+ */
+static bool timeline_read(uint32_t index, timeline_entry_t *entry) {
+  uint32_t irq_state = save_and_disable_interrupts();
+  bool valid = timeline_head - index <= TIMELINE_SIZE;
+  if (valid) *entry = timeline[index & (TIMELINE_SIZE - 1)];
+  restore_interrupts(irq_state);
+  return valid;
+}
+
+/**
+ * @brief Dumps the events leading up to, and including, a slow report.
+ * The timeline is frozen while it is printed, so the events being printed can't be overwritten.  Each
+ * event is printed with its time relative to the slow report.
+ *
+ * @param index The sequence number of the slow report event.
+ */
+static void timeline_dump(uint32_t index) {
+  timeline_entry_t last, entry;
+  timeline_frozen = true;
+  if (timeline_read(index, &last)) {
+    uint32_t count = CONVERTER_TIMELINE_DUMP_EVENTS < TIMELINE_SIZE ? CONVERTER_TIMELINE_DUMP_EVENTS
+                                                                    : TIMELINE_SIZE;
+    if (count > index + 1) count = index + 1;  // Fewer events have been recorded since power on.
+    for (uint32_t i = index + 1 - count; i != index + 1; i++) {
+      if (!timeline_read(i, &entry)) continue;
+      printf("[DBG] Timeline %8ldus %s 0x%02X\n", -(long)(last.time_us - entry.time_us),
+             timeline_event_names[entry.event], entry.data);
+    }
+  }
+  timeline_frozen = false;
+}
+
+/**
+ * @brief Measures the latency of a report, and dumps the timeline if it was slow.
+ *
+ * @param name       The name of the report, for the diagnostics output.
+ * @param latency    The latency statistics to update.
+ * @param rx_us      Time the last byte was received from the device.
+ * @param report_us  Time the report was submitted.
+ * @param index      The sequence number of the report event.
+ *
+ * @return true if the timeline was dumped (and so events may have been dropped), false otherwise.
+ */
+static bool timeline_measure(const char *name, timeline_latency_t *latency, uint32_t rx_us,
+                             uint32_t report_us, uint32_t index) {
+  uint32_t latency_us = report_us - rx_us;
+  latency->count++;
+  latency->total += latency_us;
+  if (latency_us > latency->max) latency->max = latency_us;
+
+  if (latency_us >= CONVERTER_TIMELINE_LATENCY_US) {
+    printf("[WARN] Slow %s report: %luus\n", name, (unsigned long)latency_us);
+    timeline_dump(index);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Prints and resets the latency statistics for a report.
+ *
+ * @param name    The name of the report, for the diagnostics output.
+ * @param latency The latency statistics to print.
+ */
+static void timeline_print_latency(const char *name, timeline_latency_t *latency) {
+  if (!latency->count) return;
+  printf("[DBG] %s latency: n=%lu avg=%luus max=%luus\n", name, (unsigned long)latency->count,
+         (unsigned long)(latency->total / latency->count), (unsigned long)latency->max);
+  *latency = (timeline_latency_t){0};
+}
+
+/**
+ * @brief Task function for the event timeline.
+ * This walks the events recorded since it last ran, measuring the latency from the last byte
+ * received from each device to the HID report it produced.  The latency is measured from the last
+ * byte, as a single key or movement can span several bytes, and a byte which changes nothing (such
+ * as a typematic repeat) doesn't produce a report at all.  Any report at or above
+ * CONVERTER_TIMELINE_LATENCY_US dumps the events which led up to it, showing how the main loop,
+ * interrupts, USB, LED and Buzzer activity were interleaved at the time.  A latency summary is
+ * reported every CONVERTER_TIMELINE_REPORT_MS.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ */
+void timeline_task(void) {
+  static uint32_t tail = 0;
+  static uint32_t keyboard_rx_us = 0;
+  static uint32_t mouse_rx_us = 0;
+  static bool keyboard_rx = false;
+  static bool mouse_rx = false;
+  static timeline_latency_t keyboard_latency = {0};
+  static timeline_latency_t mouse_latency = {0};
+  static uint32_t next_report_ms = 0;
+
+  timeline_entry_t entry;
+  while (tail != timeline_head) {
+    if (!timeline_read(tail, &entry)) {
+      // The task has fallen behind, so skip to the oldest event still held.
+      printf("[WARN] Timeline overrun\n");
+      tail = timeline_head - TIMELINE_SIZE;
+      keyboard_rx = mouse_rx = false;
+      continue;
+    }
+
+    switch (entry.event) {
+      case TIMELINE_KEYBOARD_RX:
+        keyboard_rx_us = entry.time_us;
+        keyboard_rx = true;
+        break;
+      case TIMELINE_MOUSE_RX:
+        mouse_rx_us = entry.time_us;
+        mouse_rx = true;
+        break;
+      case TIMELINE_HID_KEYBOARD:
+        if (keyboard_rx) {
+          if (timeline_measure("Keyboard", &keyboard_latency, keyboard_rx_us, entry.time_us, tail)) {
+            mouse_rx = false;  // Events may have been dropped while dumping.
+          }
+          keyboard_rx = false;
+        }
+        break;
+      case TIMELINE_HID_MOUSE:
+        if (mouse_rx) {
+          if (timeline_measure("Mouse", &mouse_latency, mouse_rx_us, entry.time_us, tail)) {
+            keyboard_rx = false;  // Events may have been dropped while dumping.
+          }
+          mouse_rx = false;
+        }
+        break;
+      default:
+        break;
+    }
+    tail++;
+  }
+
+  uint32_t now_ms = board_millis();
+  if ((int32_t)(now_ms - next_report_ms) < 0) return;
+  next_report_ms = now_ms + CONVERTER_TIMELINE_REPORT_MS;
+
+  timeline_print_latency("Keyboard", &keyboard_latency);
+  timeline_print_latency("Mouse", &mouse_latency);
+  if (timeline_dropped) {
+    printf("[DBG] Timeline: %lu events dropped while dumping\n", (unsigned long)timeline_dropped);
+    timeline_dropped = 0;
+  }
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Number of events held by the timeline.  This must be a power of 2.
+#define TIMELINE_SIZE 128
+
+typedef enum {
+  TIMELINE_KEYBOARD_RX,    // Keyboard scancode byte received (data: scancode byte)
+  TIMELINE_MOUSE_RX,       // Mouse frame received (data: data byte)
+  TIMELINE_HID_KEYBOARD,   // Keyboard HID report submitted (data: 1 if accepted by the USB stack)
+  TIMELINE_HID_MOUSE,      // Mouse HID report submitted (data: 1 if accepted by the USB stack)
+  TIMELINE_LED_UPDATE,     // LED frame sent (data: number of LEDs)
+  TIMELINE_BUZZER_ALARM,   // Buzzer sequence alarm fired (data: note index)
+  TIMELINE_USB_CONNECT,    // USB connected after re-enumeration (data: active USB functions)
+  TIMELINE_USB_DISCONNECT  // USB disconnected for re-enumeration (data: unused)
+} timeline_event_t;
+
+typedef struct {
+  uint32_t time_us;  // Time the event was recorded, from time_us_32()
+  uint8_t event;     // The timeline_event_t of the event
+  uint8_t data;      // Event specific data
+} timeline_entry_t;
+
+void timeline_record(timeline_event_t event, uint8_t data);
+void timeline_task(void);
+
+#endif /* TIMELINE_H */
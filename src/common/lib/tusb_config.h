@@ -34,6 +34,10 @@ extern "C" {
 // COMMON CONFIGURATION
 //--------------------------------------------------------------------
 
+// The CONVERTER_* options decide which interfaces are enabled, and this file is also included when
+// building TinyUSB itself, so they are pulled in here.
+#include "config.h"
+
 // defines which interfaces are enabled in the device
 #ifdef _KEYBOARD_ENABLED
 #define KEYBOARD_ENABLED _KEYBOARD_ENABLED
@@ -105,7 +109,13 @@ extern "C" {
 #define MOUSE_TUD_HID 0
 #endif
 
-#define CFG_TUD_HID (KEYBOARD_TUD_HID + MOUSE_TUD_HID)
+#ifdef CONVERTER_VENDOR_INTERFACE
+#define VENDOR_TUD_HID 1
+#else
+#define VENDOR_TUD_HID 0
+#endif
+
+#define CFG_TUD_HID (KEYBOARD_TUD_HID + MOUSE_TUD_HID + VENDOR_TUD_HID)
 #define CFG_TUD_CDC 0
 #define CFG_TUD_MSC 0
 #define CFG_TUD_MIDI 0
@@ -115,6 +125,13 @@ extern "C" {
 #define KEYBOARD_EP_BUFSIZE 8
 #define CONSUMER_EP_BUFSIZE 16
 
+// The vendor interface uses full size packets.  TinyUSB sizes the buffers of every HID instance
+// from CFG_TUD_HID_EP_BUFSIZE, so this is raised to match when it is enabled.
+#define VENDOR_EP_BUFSIZE 64
+#ifdef CONVERTER_VENDOR_INTERFACE
+#define CFG_TUD_HID_EP_BUFSIZE VENDOR_EP_BUFSIZE
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,21 +25,22 @@
 
 #include "usb_descriptors.h"
 
+#include <stdio.h>
+
 #include "config.h"
 #include "pico/unique_id.h"
 #include "tusb.h"
 
 /* A combination of interfaces must have a unique product id, since PC will save device driver after
- * the first plug. Same VID/PID with different interface e.g MSC (first), then CDC (later) will
- * possibly cause system error on PC.
+ * the first plug.  As the interfaces we expose depend on which functions are active at runtime, the
+ * Product ID is derived from the set of active functions, so each combination always enumerates
+ * with the same, distinct Product ID.
  *
- * Auto ProductID layout's Bitmap:
- *   [MSB]         HID | MSC | CDC          [LSB]
+ * Product ID layout:
+ *   [MSB]  0x40 | 0x00 | USB_FUNC_* bitmap  [LSB]
  */
-#define _PID_MAP(itf, n) ((CFG_TUD_##itf) << (n))
-#define USB_PID                                                                          \
-  (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | _PID_MAP(MIDI, 3) | \
-   _PID_MAP(VENDOR, 4))
+#define USB_PID_BASE 0x4000
+#define USB_PID(functions) (USB_PID_BASE | (functions))
 
 #define USB_VID 0x5515
 #define USB_BCD 0x0110
@@ -47,23 +48,23 @@
 //--------------------------------------------------------------------+
 // Device Descriptors
 //--------------------------------------------------------------------+
-tusb_desc_device_t const desc_device = {.bLength = sizeof(tusb_desc_device_t),
-                                        .bDescriptorType = TUSB_DESC_DEVICE,
-                                        .bcdUSB = USB_BCD,
-                                        .bDeviceClass = 0x00,
-                                        .bDeviceSubClass = 0x00,
-                                        .bDeviceProtocol = 0x00,
-                                        .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+static tusb_desc_device_t desc_device = {.bLength = sizeof(tusb_desc_device_t),
+                                         .bDescriptorType = TUSB_DESC_DEVICE,
+                                         .bcdUSB = USB_BCD,
+                                         .bDeviceClass = 0x00,
+                                         .bDeviceSubClass = 0x00,
+                                         .bDeviceProtocol = 0x00,
+                                         .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
 
-                                        .idVendor = USB_VID,
-                                        .idProduct = USB_PID,
-                                        .bcdDevice = 0x0100,
+                                         .idVendor = USB_VID,
+                                         .idProduct = USB_PID(0),
+                                         .bcdDevice = 0x0100,
 
-                                        .iManufacturer = 0x01,
-                                        .iProduct = 0x02,
-                                        .iSerialNumber = 0x03,
+                                         .iManufacturer = 0x01,
+                                         .iProduct = 0x02,
+                                         .iSerialNumber = 0x03,
 
-                                        .bNumConfigurations = 0x01};
+                                         .bNumConfigurations = 0x01};
 
 /**
  * @brief Invoked when received GET DEVICE DESCRIPTOR.
@@ -83,64 +84,221 @@ uint8_t const desc_hid_report_keyboard[] = {
 uint8_t const desc_hid_report_consumer[] = {
     TUD_HID_REPORT_DESC_CONSUMER(HID_REPORT_ID(REPORT_ID_CONSUMER_CONTROL))};
 
+uint8_t const desc_hid_report_system[] = {
+    TUD_HID_REPORT_DESC_SYSTEM_CONTROL(HID_REPORT_ID(REPORT_ID_SYSTEM_CONTROL))};
+
 uint8_t const desc_hid_report_mouse[] = {TUD_HID_REPORT_DESC_MOUSE(HID_REPORT_ID(REPORT_ID_MOUSE))};
 
-/**
- * @brief Invoked when received GET HID REPORT DESCRIPTOR.
- * This function returns a pointer to the HID report descriptor based on the interface number.
- * The descriptor contents must exist long enough for the transfer to complete.
- *
- * @param interface The interface number.
- *
- * @return Pointer to the HID report descriptor.
- */
-uint8_t const* tud_hid_descriptor_report_cb(uint8_t interface) {
-  switch (interface) {
-    case ITF_NUM_KEYBOARD:
-      return KEYBOARD_ENABLED ? desc_hid_report_keyboard : desc_hid_report_mouse;
-    case ITF_NUM_CONSUMER_CONTROL:
-      return KEYBOARD_ENABLED ? desc_hid_report_consumer : NULL;
-    case ITF_NUM_MOUSE:
-      return MOUSE_ENABLED ? desc_hid_report_mouse : NULL;
-    default:
-      return NULL;
-  }
-}
+// The vendor collection is alone on its interface, so its reports carry no Report ID, and the host
+// sees plain 64 byte packets in each direction.
+uint8_t const desc_hid_report_vendor[] = {TUD_HID_REPORT_DESC_GENERIC_INOUT(VENDOR_EP_BUFSIZE)};
 
 //--------------------------------------------------------------------+
-// Configuration Descriptor
+// Interface and Report Tables
 //--------------------------------------------------------------------+
 
-const uint ITF_NUM_TOTAL = (KEYBOARD_ENABLED == 1 ? 2 : 0) + (MOUSE_ENABLED == 1 ? 1 : 0);
-
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + ITF_NUM_TOTAL * TUD_HID_DESC_LEN)
+// In compact mode, the Consumer, System and Mouse reports share a single interface and endpoint,
+// leaving the Keyboard on its own boot protocol interface for BIOS compatibility.  Without a
+// Keyboard the Mouse would have nothing to share with, so it keeps its boot protocol interface.
+#ifdef CONVERTER_USB_COMPACT
+#define ITF_ROUTE_CONSUMER ITF_NUM_SHARED
+#if KEYBOARD_ENABLED
+#define ITF_ROUTE_MOUSE ITF_NUM_SHARED
+#else
+#define ITF_ROUTE_MOUSE ITF_NUM_MOUSE
+#endif
+#else
+#define ITF_ROUTE_CONSUMER ITF_NUM_CONSUMER_CONTROL
+#define ITF_ROUTE_MOUSE ITF_NUM_MOUSE
+#endif
 
-#define EPNUM_KEYBOARD 0x81
-#define EPNUM_CONSUMER_CONTROL 0x82
-#define EPNUM_MOUSE 0x83
+typedef struct {
+  uint8_t itf;       // Logical interface (ITF_NUM_*)
+  uint8_t protocol;  // HID interface protocol
+  uint16_t ep_size;  // Size of the IN endpoint, and the OUT endpoint if present
+  bool ep_out;       // Whether the interface receives reports on its own OUT endpoint
+  uint8_t interval;  // Polling interval of the endpoints in milliseconds
+} usb_hid_itf_t;
+
+typedef struct {
+  uint8_t report_id;           // Report ID of this collection
+  uint8_t itf;                 // Logical interface this collection is carried on
+  uint8_t function;            // Function this collection belongs to (USB_FUNC_*)
+  uint8_t const* report_desc;  // HID report descriptor of this collection
+  uint16_t report_desc_len;    // Length of the HID report descriptor
+} usb_hid_collection_t;
+
+// Mouse Keys generate motion every 1ms, so the mouse endpoint is polled at the same rate.
+#ifdef CONVERTER_MOUSEKEYS
+#define MOUSE_EP_INTERVAL 1
+#else
+#define MOUSE_EP_INTERVAL 8
+#endif
 
-uint8_t const desc_configuration[] = {
-    // Config number, interface count, string index, total length, bmAttributes, power in mA
-    // setting bmAttributes to 0x80 means bus-powered, and will prevent the host from trying to
-    // suspend the device.
-    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x00, 250),
+// Every interface we are able to expose, in the order they are enumerated.  An interface is only
+// enumerated if at least one of its report collections belongs to an active function.
+static const usb_hid_itf_t usb_hid_itfs[] = {
+    {ITF_NUM_KEYBOARD, HID_ITF_PROTOCOL_KEYBOARD, KEYBOARD_EP_BUFSIZE, false, 8},
+    {ITF_NUM_CONSUMER_CONTROL, HID_ITF_PROTOCOL_NONE, CONSUMER_EP_BUFSIZE, false, 8},
+    {ITF_NUM_MOUSE, HID_ITF_PROTOCOL_MOUSE, CFG_TUD_HID_EP_BUFSIZE, false, MOUSE_EP_INTERVAL},
+    {ITF_NUM_SHARED, HID_ITF_PROTOCOL_NONE, CFG_TUD_HID_EP_BUFSIZE, false, MOUSE_EP_INTERVAL},
+    {ITF_NUM_VENDOR, HID_ITF_PROTOCOL_NONE, VENDOR_EP_BUFSIZE, true, 1},
+};
 
+// Every report collection this build supports, and the interface each is carried on.
+static const usb_hid_collection_t usb_hid_collections[] = {
 #if KEYBOARD_ENABLED
-    TUD_HID_DESCRIPTOR(ITF_NUM_KEYBOARD, 0, HID_ITF_PROTOCOL_KEYBOARD,
-                       sizeof(desc_hid_report_keyboard), EPNUM_KEYBOARD, KEYBOARD_EP_BUFSIZE, 8),
-
-    TUD_HID_DESCRIPTOR(ITF_NUM_CONSUMER_CONTROL, 0, HID_ITF_PROTOCOL_NONE,
-                       sizeof(desc_hid_report_consumer), EPNUM_CONSUMER_CONTROL,
-                       CONSUMER_EP_BUFSIZE, 8),
+    {REPORT_ID_KEYBOARD, ITF_NUM_KEYBOARD, USB_FUNC_KEYBOARD, desc_hid_report_keyboard,
+     sizeof(desc_hid_report_keyboard)},
+    {REPORT_ID_CONSUMER_CONTROL, ITF_ROUTE_CONSUMER, USB_FUNC_KEYBOARD, desc_hid_report_consumer,
+     sizeof(desc_hid_report_consumer)},
+    {REPORT_ID_SYSTEM_CONTROL, ITF_ROUTE_CONSUMER, USB_FUNC_KEYBOARD, desc_hid_report_system,
+     sizeof(desc_hid_report_system)},
 #endif
-
-#if MOUSE_ENABLED
-    TUD_HID_DESCRIPTOR(KEYBOARD_ENABLED ? ITF_NUM_MOUSE : ITF_NUM_KEYBOARD, 0,
-                       HID_ITF_PROTOCOL_MOUSE, sizeof(desc_hid_report_mouse),
-                       KEYBOARD_ENABLED ? EPNUM_MOUSE : EPNUM_KEYBOARD, CFG_TUD_HID_EP_BUFSIZE, 8),
+#if MOUSE_ENABLED || defined(CONVERTER_MOUSEKEYS)
+    {REPORT_ID_MOUSE, ITF_ROUTE_MOUSE, USB_FUNC_MOUSE, desc_hid_report_mouse,
+     sizeof(desc_hid_report_mouse)},
+#endif
+#ifdef CONVERTER_VENDOR_INTERFACE
+    {REPORT_ID_VENDOR, ITF_NUM_VENDOR, USB_FUNC_VENDOR, desc_hid_report_vendor,
+     sizeof(desc_hid_report_vendor)},
 #endif
 };
 
+#define USB_HID_ITF_COUNT (sizeof(usb_hid_itfs) / sizeof(usb_hid_itfs[0]))
+#define USB_HID_COLLECTION_COUNT (sizeof(usb_hid_collections) / sizeof(usb_hid_collections[0]))
+#define USB_HID_REPORT_MAX_LEN                                                              \
+  (sizeof(desc_hid_report_keyboard) + sizeof(desc_hid_report_consumer) +                   \
+   sizeof(desc_hid_report_system) + sizeof(desc_hid_report_mouse) +                        \
+   sizeof(desc_hid_report_vendor))
+
+// Functions the current descriptors were built for.
+static uint8_t usb_functions = 0;
+
+// Report descriptors of each enumerated HID instance, assembled from their active collections.
+static uint8_t desc_hid_report[USB_HID_REPORT_MAX_LEN];
+static struct {
+  uint16_t offset;
+  uint16_t len;
+} usb_hid_instance_reports[USB_HID_ITF_COUNT];
+static uint8_t usb_hid_instance_count = 0;
+
+// HID instance each report ID is sent on, or USB_HID_INSTANCE_NONE if not enumerated.
+static uint8_t usb_hid_report_instances[REPORT_ID_COUNT];
+
+//--------------------------------------------------------------------+
+// Configuration Descriptor
+//--------------------------------------------------------------------+
+
+#define CONFIG_MAX_LEN (TUD_CONFIG_DESC_LEN + USB_HID_ITF_COUNT * TUD_HID_INOUT_DESC_LEN)
+
+#define EPNUM_HID_BASE 0x81
+#define EPNUM_HID_OUT_BASE 0x01
+
+static uint8_t desc_configuration[CONFIG_MAX_LEN];
+
+/**
+ * @brief Builds the device, configuration and report descriptors for a set of functions.
+ * Each interface's report descriptor is assembled in RAM from the report collections of the active
+ * functions it carries.  The configuration descriptor then includes each interface which carries at
+ * least one collection, numbering the interfaces and their endpoints sequentially, and the Product
+ * ID is set to match the set of functions.
+ *
+ * @param functions Bitmap of USB_FUNC_* functions to expose.  Functions not supported by this build
+ *                  are ignored.
+ *
+ * @note The descriptors must only be rebuilt while the device is disconnected from the host.
+ */
+void usb_descriptors_build(uint8_t functions) {
+  uint16_t len = TUD_CONFIG_DESC_LEN;
+  uint16_t report_len = 0;
+  uint8_t supported = 0;
+
+  for (uint8_t i = 0; i < REPORT_ID_COUNT; i++) usb_hid_report_instances[i] = USB_HID_INSTANCE_NONE;
+  usb_hid_instance_count = 0;
+
+  for (uint8_t i = 0; i < USB_HID_ITF_COUNT; i++) {
+    const usb_hid_itf_t* hid_itf = &usb_hid_itfs[i];
+    uint8_t instance = usb_hid_instance_count;
+    uint16_t offset = report_len;
+
+    for (uint8_t j = 0; j < USB_HID_COLLECTION_COUNT; j++) {
+      const usb_hid_collection_t* collection = &usb_hid_collections[j];
+      supported |= collection->function;
+      if (collection->itf != hid_itf->itf || !(functions & collection->function)) continue;
+
+      memcpy(&desc_hid_report[report_len], collection->report_desc, collection->report_desc_len);
+      report_len += collection->report_desc_len;
+      usb_hid_report_instances[collection->report_id] = instance;
+    }
+
+    if (report_len == offset) continue;  // Nothing active on this interface.
+
+    usb_hid_instance_reports[instance].offset = offset;
+    usb_hid_instance_reports[instance].len = report_len - offset;
+    usb_hid_instance_count++;
+
+    if (hid_itf->ep_out) {
+      const uint8_t desc_hid[] = {TUD_HID_INOUT_DESCRIPTOR(
+          instance, 0, hid_itf->protocol, report_len - offset, EPNUM_HID_OUT_BASE + instance,
+          EPNUM_HID_BASE + instance, hid_itf->ep_size, hid_itf->interval)};
+      memcpy(&desc_configuration[len], desc_hid, sizeof(desc_hid));
+      len += sizeof(desc_hid);
+    } else {
+      const uint8_t desc_hid[] = {TUD_HID_DESCRIPTOR(instance, 0, hid_itf->protocol,
+                                                     report_len - offset, EPNUM_HID_BASE + instance,
+                                                     hid_itf->ep_size, hid_itf->interval)};
+      memcpy(&desc_configuration[len], desc_hid, sizeof(desc_hid));
+      len += sizeof(desc_hid);
+    }
+  }
+
+  usb_functions = functions & supported;
+  desc_device.idProduct = USB_PID(usb_functions);
+
+  // Config number, interface count, string index, total length, bmAttributes, power in mA
+  // setting bmAttributes to 0x80 means bus-powered, and will prevent the host from trying to
+  // suspend the device.
+  const uint8_t desc_config[] = {
+      TUD_CONFIG_DESCRIPTOR(1, usb_hid_instance_count, 0, len, 0x00, 250)};
+  memcpy(desc_configuration, desc_config, sizeof(desc_config));
+
+  printf("[INFO] USB Descriptors built for %d Interface(s), PID 0x%04X\n", usb_hid_instance_count,
+         desc_device.idProduct);
+}
+
+/**
+ * @brief Returns the set of functions the current descriptors were built for.
+ *
+ * @return Bitmap of active USB_FUNC_* functions.
+ */
+uint8_t usb_active_functions(void) { return usb_functions; }
+
+/**
+ * @brief Maps a report ID to the HID instance it is sent on.
+ *
+ * @param report_id The report ID (REPORT_ID_*).
+ *
+ * @return The HID instance carrying the report, or USB_HID_INSTANCE_NONE if it is not enumerated.
+ */
+uint8_t usb_hid_report_instance(uint8_t report_id) {
+  return report_id < REPORT_ID_COUNT ? usb_hid_report_instances[report_id] : USB_HID_INSTANCE_NONE;
+}
+
+/**
+ * @brief Invoked when received GET HID REPORT DESCRIPTOR.
+ * This function returns a pointer to the HID report descriptor based on the interface number.
+ * The descriptor contents must exist long enough for the transfer to complete.
+ *
+ * @param interface The interface number.
+ *
+ * @return Pointer to the HID report descriptor.
+ */
+uint8_t const* tud_hid_descriptor_report_cb(uint8_t interface) {
+  if (interface >= usb_hid_instance_count) return NULL;
+  return &desc_hid_report[usb_hid_instance_reports[interface].offset];
+}
+
 /**
  * @brief Invoked when received GET CONFIGURATION DESCRIPTOR.
  * This function returns a pointer to the configuration descriptor based on the configuration index.
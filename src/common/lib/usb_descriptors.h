@@ -25,17 +25,40 @@
 #ifndef USB_DESCRIPTORS_H_
 #define USB_DESCRIPTORS_H_
 
-// Interfaces
+#include <stdbool.h>
+#include <stdint.h>
+
+// Logical Interfaces.  These identify each interface we can expose.  Only the interfaces carrying
+// reports of active functions are enumerated, so reports are sent to the HID instance returned by
+// usb_hid_report_instance() for their Report ID.
 enum {
   ITF_NUM_KEYBOARD,
   ITF_NUM_CONSUMER_CONTROL,
   ITF_NUM_MOUSE,
+  ITF_NUM_SHARED,  // Consumer, System and Mouse reports, when CONVERTER_USB_COMPACT is defined
+  ITF_NUM_VENDOR,  // Firmware Update, Event Stamp and Sniffer reports, when any are enabled
 };
 
+// USB Functions.  Each function contributes one or more interfaces to the configuration descriptor,
+// and each combination of functions enumerates with its own Product ID.
+#define USB_FUNC_KEYBOARD (1u << 0)  // Keyboard, Consumer Control and System Control reports
+#define USB_FUNC_MOUSE (1u << 1)     // Mouse reports
+#define USB_FUNC_VENDOR (1u << 2)    // Vendor Firmware Update, Event Stamp and Sniffer reports
+
+// Value returned by usb_hid_report_instance() for a report which is not currently enumerated.
+#define USB_HID_INSTANCE_NONE 0xFF
+
 enum {
   REPORT_ID_KEYBOARD = 1,
   REPORT_ID_CONSUMER_CONTROL,
   REPORT_ID_MOUSE,
+  REPORT_ID_SYSTEM_CONTROL,
+  REPORT_ID_VENDOR,  // Only used to look up the instance, as the vendor interface has no Report IDs
+  REPORT_ID_COUNT,
 };
 
+void usb_descriptors_build(uint8_t functions);
+uint8_t usb_active_functions(void);
+uint8_t usb_hid_report_instance(uint8_t report_id);
+
 #endif /* USB_DESCRIPTORS_H_ */
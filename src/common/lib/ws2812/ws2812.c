@@ -26,6 +26,7 @@
 
 #include "bsp/board.h"
 #include "config.h"
+#include "hardware/dma.h"
 #include "pio_helper.h"
 #include "ws2812.pio.h"  // Generated from ws2812.pio at build time
 
@@ -33,6 +34,16 @@ uint ws2812_sm = 0;
 uint ws2812_offset = 0;
 PIO ws2812_pio = NULL;
 
+static int ws2812_dma_chan = -1;
+static uint32_t ws2812_frame[WS2812_MAX_LEDS];  // Frame buffer read by DMA into the PIO TX FIFO.
+static uint32_t ws2812_frame_start_us = 0;
+static uint32_t ws2812_frame_len_us = 0;
+
+// Each LED takes 24 bits at 800kHz (30us), and the data line must then be held LOW for at least
+// 50us to latch the frame.  We allow a little extra for the reset period.
+#define WS2812_LED_TIME_US 30
+#define WS2812_RESET_TIME_US 60
+
 /*
  * Private Functions
  */
@@ -87,17 +98,42 @@ static inline uint32_t ws2812_set_color(uint32_t led_color) {
  */
 
 /**
- * @brief Illuminates the WS2812 LED strip with the specified color.
- * This function sets the color of a single LED in the WS2812 LED strip (where applicable). It is
- * called in a loop to update the entire LED strip for the total number of LEDs present. The assumed
- * color value sent to the LED should already be adjusted for brightness and color order (see
- * ws2812_set_color). Please refer to the datasheet for the WS2812 LED strip for more information on
- * timing requirements.
+ * @brief Checks whether the WS2812 interface is ready to accept a new frame.
+ * The previous frame must have been fully clocked out by DMA and the PIO, and the data line held
+ * LOW long enough for the LEDs to latch it.  This is calculated from the length of the previous
+ * frame, so no DMA completion IRQ is required.
+ *
+ * @return true if a new frame can be sent, false otherwise.
+ */
+bool ws2812_is_ready(void) {
+  if (ws2812_dma_chan < 0) return false;
+  if (dma_channel_is_busy((uint)ws2812_dma_chan)) return false;
+  return time_us_32() - ws2812_frame_start_us >= ws2812_frame_len_us;
+}
+
+/**
+ * @brief Sends a frame of colors to the WS2812 LED strip.
+ * Each color is adjusted for brightness and color order (see ws2812_set_color) into the frame
+ * buffer, which is then transferred to the PIO TX FIFO by DMA.  The CPU cost is therefore only the
+ * color conversion, and the function returns without waiting for the LEDs to be updated.
+ *
+ * @param led_colors The RGB color values for each LED, in the order they are chained.
+ * @param count      The number of LEDs in the frame.  Limited to WS2812_MAX_LEDS.
  *
- * @param led_color The color value to set for the LED.
+ * @return true if the frame was started, false if the interface was not ready.
  */
-void ws2812_show(uint32_t led_color) {
-  pio_sm_put_blocking(ws2812_pio, ws2812_sm, ws2812_set_color(led_color) << 8u);
+bool ws2812_show_frame(const uint32_t *led_colors, uint count) {
+  if (!ws2812_is_ready()) return false;
+  if (count > WS2812_MAX_LEDS) count = WS2812_MAX_LEDS;
+
+  for (uint i = 0; i < count; i++) {
+    ws2812_frame[i] = ws2812_set_color(led_colors[i]) << 8u;
+  }
+
+  ws2812_frame_start_us = time_us_32();
+  ws2812_frame_len_us = count * WS2812_LED_TIME_US + WS2812_RESET_TIME_US;
+  dma_channel_transfer_from_buffer_now((uint)ws2812_dma_chan, ws2812_frame, count);
+  return true;
 }
 
 /**
@@ -125,7 +161,18 @@ void ws2812_setup(uint led_pin) {
 
   ws2812_program_init(ws2812_pio, ws2812_sm, ws2812_offset, led_pin, clock_div);
 
+  // Set up the DMA channel used to feed frames into the PIO TX FIFO.
+  ws2812_dma_chan = dma_claim_unused_channel(true);
+  dma_channel_config dma_config = dma_channel_get_default_config((uint)ws2812_dma_chan);
+  channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&dma_config, true);
+  channel_config_set_write_increment(&dma_config, false);
+  channel_config_set_dreq(&dma_config, pio_get_dreq(ws2812_pio, ws2812_sm, true));
+  dma_channel_configure((uint)ws2812_dma_chan, &dma_config, &ws2812_pio->txf[ws2812_sm], NULL, 0,
+                        false);
+
   printf(
       "[INFO] PIO%d SM%d WS2812 Interface program loaded at offset %d with clock divider of %.2f\n",
       ws2812_pio == pio0 ? 0 : 1, ws2812_sm, ws2812_offset, clock_div);
+  printf("[INFO] WS2812 frames transferred using DMA channel %d\n", ws2812_dma_chan);
 }
@@ -23,7 +23,11 @@
 
 #include "pico/stdlib.h"
 
-void ws2812_show(uint32_t led_color);
+// Maximum number of LEDs which can be driven within a single frame.
+#define WS2812_MAX_LEDS 8
+
+bool ws2812_is_ready(void);
+bool ws2812_show_frame(const uint32_t *led_colors, uint count);
 void ws2812_setup(uint data_pin);
 
 #endif /* WS2812_H */
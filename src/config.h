@@ -29,17 +29,95 @@
 
 // Define configuration options for the Keyboard Converter
 #define CONVERTER_PIEZO              // Enable Piezo Buzzer on Converter Hardware
+// #define CONVERTER_KEYCLICK        // Enable Keyclick feedback on each keypress (requires CONVERTER_PIEZO)
+// #define CONVERTER_KEYCLICK_BENCHMARK  // Measure the Keyboard report path with and without the Keyclick once the host has enumerated (requires CONVERTER_KEYCLICK)
 #define CONVERTER_LEDS               // Enable support for LED indicator lights on Converter Hardware
 #define CONVERTER_LEDS_TYPE LED_GRB  // Define type of LED which we are using
 #define CONVERTER_LOCK_LEDS          // Enable Lock LED Indicators on Converter Hardware
+// #define CONVERTER_MEM_STATS       // Report stack high-water marks and heap usage over the diagnostics output
+// #define CONVERTER_USB_COMPACT     // Carry Consumer, System and Mouse reports on one shared USB interface
+// #define CONVERTER_REPORT_TRACE    // Print every Keyboard HID report and the scancode decode cost, for capturing and comparing report streams
+// #define CONVERTER_TIMELINE        // Record a timeline of device, USB, LED and Buzzer events, and report the device to HID report latency
+// #define CONVERTER_OVERSAMPLE      // Sample each received bit three times and majority vote it, filtering out CLK glitches
+// #define CONVERTER_SNIFFER         // Passively capture traffic between an AT/PS2 Keyboard and another host, instead of converting the Keyboard
+// #define CONVERTER_IRQ_STATS       // Measure and report the worst-case entry latency of each IRQ source
+// #define CONVERTER_FW_UPDATE       // Accept firmware updates streamed over a vendor USB interface, without entering BOOTSEL
+// #define CONVERTER_MOUSEKEYS       // Drive the Mouse report from Mouse Key codes in the Keyboard keymap
+// #define CONVERTER_EVENT_STAMPS    // Send the receive, decode and submit times of every Keyboard and Mouse event to the host, over a vendor USB interface
+// #define CONVERTER_LOADGEN         // Inject a recorded trace or synthetic load into the connected devices' input, and report throughput, drops and latency
+// #define CONVERTER_PORT_DETECT     // Identify the device attached to each AT/PS2 port from its ID, and swap the Keyboard and Mouse ports if they are cross-connected
 
 // Define the colors of the LEDs in HEX.  Regardless of LED Type, we always use RGB Value here.
 #define CONVERTER_LEDS_BRIGHTNESS 5                     // Brightness of LEDs.  This ranges from 1 to 10.
 #define CONVERTER_LEDS_STATUS_READY_COLOR 0x00FF00      // Color of Status LED when Converter is initialised
 #define CONVERTER_LEDS_STATUS_NOT_READY_COLOR 0xFF2800  // Color of Status LED when Converter is not ready
 #define CONVERTER_LEDS_STATUS_FWFLASH_COLOR 0xFF00FF    // Color of Status LED when in Bootloader Mode (Firmware Flashing)
+#define CONVERTER_LEDS_STATUS_ERROR_COLOR 0xFF0000      // Color of Status LED flash when receive errors occur, and while a port is inhibited by flood protection
 #define CONVERTER_LOCK_LEDS_COLOR 0x00FF00              // Color of Lock Light LEDs
 
+// Define the LED animation timings.
+#define CONVERTER_LEDS_FRAME_MS 20             // Interval between animation frames in milliseconds
+#define CONVERTER_LEDS_BREATHE_PERIOD_MS 2000  // Period of the Status LED breathing while not ready
+#define CONVERTER_LEDS_ACTIVITY_BLIP_MS 30     // Duration of the Status LED blip on each keystroke
+
+// Define the Keyclick sound.  Modifier and large keys (Space, Enter etc) are derived from these values.
+#define CONVERTER_KEYCLICK_FREQ 4000         // Frequency of the Keyclick in Hz
+#define CONVERTER_KEYCLICK_DURATION_US 1500  // Duration of the Keyclick in microseconds
+
+// Define the Memory Usage reporting options.
+#define CONVERTER_MEM_STATS_INTERVAL_MS 1000      // Interval between stack and heap measurements in milliseconds
+#define CONVERTER_MEM_STATS_STACK_HEADROOM 256    // Warn when less than this many bytes of the Core 0 stack remain unused
+
+// Define the Report Trace options.
+#define CONVERTER_REPORT_TRACE_DECODE_BATCH 64  // Number of Keyboard reports decoded between each decode cost report
+
+// Define the Event Timeline options.
+#define CONVERTER_TIMELINE_LATENCY_US 2000  // Dump the timeline leading up to any HID report slower than this, in microseconds
+#define CONVERTER_TIMELINE_DUMP_EVENTS 32   // Number of events to dump leading up to a slow HID report
+#define CONVERTER_TIMELINE_REPORT_MS 10000  // Interval between latency summaries in milliseconds
+
+// Define the receive error recovery options.
+#define CONVERTER_RESYNC_LIMIT 3  // Consecutive misaligned frames from a device before it is fully re-initialised, rather than just resynchronised
+
+// Define the flood protection options.  A port which exceeds either limit within a window is inhibited (CLK held LOW) for the backoff interval.
+#define CONVERTER_FLOOD_WINDOW_MS 250         // Interval over which the bytes and receive errors of each port are counted
+#define CONVERTER_FLOOD_KEYBOARD_BYTES 100    // Bytes allowed from the Keyboard within a window.  Typing rarely reaches a quarter of this.
+#define CONVERTER_FLOOD_MOUSE_BYTES 250       // Bytes allowed from the Mouse within a window.  A 200Hz IntelliMouse sends 200.
+#define CONVERTER_FLOOD_MAX_ERRORS 8          // Receive errors allowed from a port within a window
+#define CONVERTER_FLOOD_BACKOFF_MS 500        // Interval a port is first inhibited for, which doubles each time it trips again soon after release
+#define CONVERTER_FLOOD_BACKOFF_MAX_MS 32000  // Longest interval a port is inhibited for
+#define CONVERTER_FLOOD_RECOVER_MS 10000      // Time a port must run after release without tripping for its backoff to return to CONVERTER_FLOOD_BACKOFF_MS
+
+// Define the IRQ Priority plan.  Only the top two bits are used, so the levels are 0x00 (highest), 0x40, 0x80 and 0xC0 (lowest).
+#define CONVERTER_IRQ_PRIORITY_PIO 0x00           // PIO Keyboard and Mouse receivers, which must be serviced before the RX FIFO fills
+#define CONVERTER_IRQ_PRIORITY_USB 0x40           // USB Controller
+#define CONVERTER_IRQ_PRIORITY_HOUSEKEEPING 0xC0  // Timer alarms (Buzzer) and DMA completion
+#define CONVERTER_IRQ_STATS_PROBE_US 997          // Interval between IRQ latency probes in microseconds.  Kept off 1ms so it doesn't lock to the USB frame.
+#define CONVERTER_IRQ_STATS_INTERVAL_MS 1000      // Interval between IRQ latency reports in milliseconds
+
+// Define the Firmware Update options.
+#define CONVERTER_FW_UPDATE_QUEUE_PAGES 8      // Number of 256 byte flash pages buffered while Core 1 programs the staging slot
+#define CONVERTER_FW_UPDATE_SWAP_DELAY_MS 100  // Delay between acknowledging the swap and starting it, so the host receives the reply
+
+// Define the Mouse Keys options.  Speeds are in 1/256ths of a pixel (or wheel detent) per millisecond.
+#define CONVERTER_MOUSEKEYS_SPEED_START 64    // Initial cursor speed when a movement key is pressed
+#define CONVERTER_MOUSEKEYS_SPEED_MAX 512     // Cursor speed reached once the movement keys have been held for CONVERTER_MOUSEKEYS_RAMP_MS
+#define CONVERTER_MOUSEKEYS_RAMP_MS 1000      // Time taken to accelerate from the initial to the maximum cursor speed
+#define CONVERTER_MOUSEKEYS_ACCEL0_SPEED 32   // Constant cursor speed while ACL0 is held
+#define CONVERTER_MOUSEKEYS_ACCEL1_SPEED 128  // Constant cursor speed while ACL1 is held
+#define CONVERTER_MOUSEKEYS_ACCEL2_SPEED 768  // Constant cursor speed while ACL2 is held
+#define CONVERTER_MOUSEKEYS_WHEEL_SPEED 4     // Wheel speed while a wheel key is held
+
+// Define the Event Stamps options.
+#define CONVERTER_EVENT_STAMPS_QUEUE 32  // Number of events held while waiting for the host to poll the vendor interface.  This must be a power of 2, up to 128.
+
+// Define the Load Generator options.  The Keyboard pattern is one of LOADGEN_TRACE, LOADGEN_TYPING or LOADGEN_ROLLOVER.
+#define CONVERTER_LOADGEN_PATTERN LOADGEN_TYPING  // Keyboard load to inject
+#define CONVERTER_LOADGEN_MOUSE_HZ 200            // Rate of injected Mouse packets, alongside the Keyboard load.  0 disables the Mouse load.
+#define CONVERTER_LOADGEN_BYTE_US 1000            // Interval between injected bytes of synthetic load, roughly the time to clock a frame over the wire
+#define CONVERTER_LOADGEN_RUN_MS 10000            // Duration of each synthetic run.  A trace always runs once through.
+#define CONVERTER_LOADGEN_IDLE_MS 5000            // Delay before each run, once the devices are ready
+
 // Define the GPIO Pins for the Keyboard Converter.
 #define KEYBOARD_DATA_PIN 6  // This is the starting pin for the connected Keyboard.  Depending on the keyboard, we may use 2, 3 or more pins.
 #define MOUSE_DATA_PIN 3     // This is the starting pin for the connected Mouse.  Depending on the mouse, we may use 2, 3 or more pins.
@@ -81,6 +159,44 @@
 #endif
 #endif
 
+#if defined(CONVERTER_KEYCLICK) && !defined(CONVERTER_PIEZO)
+#error "CONVERTER_KEYCLICK requires CONVERTER_PIEZO to be enabled"
+#endif
+
+#if defined(CONVERTER_KEYCLICK_BENCHMARK) && (!defined(CONVERTER_KEYCLICK) || KEYBOARD_ENABLED == 0)
+#error "CONVERTER_KEYCLICK_BENCHMARK requires CONVERTER_KEYCLICK and a Keyboard to be enabled"
+#endif
+
+// The vendor USB interface carries Firmware Updates, Event Stamps and Sniffer captures.
+#if defined(CONVERTER_FW_UPDATE) || defined(CONVERTER_EVENT_STAMPS) || defined(CONVERTER_SNIFFER)
+#define CONVERTER_VENDOR_INTERFACE
+#endif
+
+// Event Stamps and the Load Generator both need the time each scancode was received.
+#if defined(CONVERTER_EVENT_STAMPS) || defined(CONVERTER_LOADGEN)
+#define CONVERTER_RINGBUF_STAMPS
+#endif
+
+#if defined(CONVERTER_SNIFFER) && !defined(_KEYBOARD_PROTOCOL_AT_PS2)
+#error "CONVERTER_SNIFFER requires a Keyboard using the at-ps2 protocol, as the sniffer only decodes AT/PS2 frames"
+#endif
+
+#if defined(CONVERTER_LOADGEN) && defined(CONVERTER_SNIFFER)
+#error "CONVERTER_LOADGEN can't be combined with CONVERTER_SNIFFER, as the Keyboard interface is replaced by the sniffer"
+#endif
+
+#if defined(CONVERTER_SNIFFER) && defined(CONVERTER_RUN_FROM_FLASH)
+#error "CONVERTER_SNIFFER requires the firmware to run from SRAM, as it replaces the Keyboard input path which RUN_FROM_FLASH places in SRAM"
+#endif
+
+#if defined(CONVERTER_MOUSEKEYS) && KEYBOARD_ENABLED == 0
+#error "CONVERTER_MOUSEKEYS requires a Keyboard to be enabled"
+#endif
+
+#if defined(CONVERTER_FW_UPDATE) && defined(CONVERTER_RUN_FROM_FLASH)
+#error "CONVERTER_FW_UPDATE requires the firmware to run from SRAM, as flash is written while the converter is running"
+#endif
+
 // clang-format on
 
 #endif /* CONFIG_H */
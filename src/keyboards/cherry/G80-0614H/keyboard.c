@@ -42,7 +42,7 @@
 
 // clang-format on
 /* Define Keyboard Layers */
-const uint8_t keymap_map[][KEYMAP_ROWS][KEYMAP_COLS] = {
+const uint8_t keymap_map[][KEYMAP_POSITIONS] = {
     KEYMAP_XT(         /* Base Layer (NumLock On)
                         * MacOS maps keys oddly, GRAVE and NUBS are swapped over when coupled with British-PC
                         * Layout.          Likewise, NUHS and BSLS appear to match. TODO: Have these as a config
@@ -66,7 +66,7 @@ const uint8_t keymap_map[][KEYMAP_ROWS][KEYMAP_COLS] = {
 };
 
 /* Define Action Layers */
-const uint8_t keymap_actions[][KEYMAP_ROWS][KEYMAP_COLS] = {
+const uint8_t keymap_actions[][KEYMAP_POSITIONS] = {
     KEYMAP_XT(      /* Function Key Pressed */
               // clang-format off
     F9,    F10,       TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,         TRNS, \
@@ -41,7 +41,7 @@
 
 // clang-format on
 /* Define Keyboard Layers */
-const uint8_t keymap_map[][KEYMAP_ROWS][KEYMAP_COLS] = {
+const uint8_t keymap_map[][KEYMAP_POSITIONS] = {
     /* We define 2 initial maps for the Base layer, these in turn define layers 0 and 1.
      * Layer 0 is the default base layer with all associated mappings.  This also encompasses the
      * NumLock On state. Layer 1 is the NumLock Off state, and only changes the state of keys
@@ -73,7 +73,7 @@ const uint8_t keymap_map[][KEYMAP_ROWS][KEYMAP_COLS] = {
 };
 
 /* Define Action Layers */
-const uint8_t keymap_actions[][KEYMAP_ROWS][KEYMAP_COLS] = {
+const uint8_t keymap_actions[][KEYMAP_POSITIONS] = {
     KEYMAP_PCAT(      /* Function Key Pressed */
                 // clang-format off
     F9,    F10,       NUBS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,  TRNS,      TRNS,  TRNS,  TRNS,  TRNS, \
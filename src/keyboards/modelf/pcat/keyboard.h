@@ -22,6 +22,8 @@
 #define KEYMAP_H
 
 #include "hid_keycodes.h"
+#include "keymaps.h"
+#include "scancode.h"
 
 // clang-format off
 /* IBM 5170 (Model F-AT)
@@ -49,22 +51,23 @@
     K02,K0A,  K12,    K1A,K22,K21,K2A,K32,K31,K3A,K41,K49,K4A,        K59,  K69,K72,K7A,K79, \
     K01,K09,  K11,                        K29,                        K58,      K70,K71  \
 ) { \
-    { KC_NO,    KC_##K01, KC_##K02, KC_##K03, KC_##K04, KC_##K05, KC_##K06, KC_NO,     /* 00-07 */ \
-      KC_NO,    KC_##K09, KC_##K0A, KC_##K0B, KC_##K0C, KC_##K0D, KC_##K0E, KC_NO },   /* 08-0F */ \
-    { KC_NO,    KC_##K11, KC_##K12, KC_NO,    KC_##K14, KC_##K15, KC_##K16, KC_NO,     /* 10-17 */ \
-      KC_NO,    KC_NO,    KC_##K1A, KC_##K1B, KC_##K1C, KC_##K1D, KC_##K1E, KC_NO },   /* 18-1F */ \
-    { KC_NO,    KC_##K21, KC_##K22, KC_##K23, KC_##K24, KC_##K25, KC_##K26, KC_NO,     /* 20-27 */ \
-      KC_NO,    KC_##K29, KC_##K2A, KC_##K2B, KC_##K2C, KC_##K2D, KC_##K2E, KC_NO },   /* 28-2F */ \
-    { KC_NO,    KC_##K31, KC_##K32, KC_##K33, KC_##K34, KC_##K35, KC_##K36, KC_NO,     /* 30-37 */ \
-      KC_NO,    KC_NO,    KC_##K3A, KC_##K3B, KC_##K3C, KC_##K3D, KC_##K3E, KC_NO },   /* 38-3F */ \
-    { KC_NO,    KC_##K41, KC_##K42, KC_##K43, KC_##K44, KC_##K45, KC_##K46, KC_NO,     /* 40-47 */ \
-      KC_NO,    KC_##K49, KC_##K4A, KC_##K4B, KC_##K4C, KC_##K4D, KC_##K4E, KC_NO },   /* 48-4F */ \
-    { KC_NO,    KC_NO,    KC_##K52, KC_NO,    KC_##K54, KC_##K55, KC_NO,    KC_NO,     /* 50-57 */ \
-      KC_##K58, KC_##K59, KC_##K5A, KC_##K5B, KC_NO,    KC_##K5D, KC_NO,    KC_NO },   /* 58-5F */ \
-    { KC_NO,    KC_NO,    KC_NO,    KC_NO,    KC_NO,    KC_NO,    KC_##K66, KC_NO,     /* 60-67 */ \
-      KC_NO,    KC_##K69, KC_NO,    KC_##K6B, KC_##K6C, KC_NO,    KC_NO,    KC_NO },   /* 68-6F */ \
-    { KC_##K70, KC_##K71, KC_##K72, KC_##K73, KC_##K74, KC_##K75, KC_##K76, KC_##K77,  /* 70-77 */ \
-      KC_NO,    KC_##K79, KC_##K7A, KC_##K7B, KC_##K7C, KC_##K7D, KC_##K7E, KC_##K7F } /* 78-7F */ \
+    KC_NO,    KC_##K01, KC_##K02, KC_##K03, KC_##K04, KC_##K05, KC_##K06, KC_NO,    /* 00-07 */ \
+    KC_NO,    KC_##K09, KC_##K0A, KC_##K0B, KC_##K0C, KC_##K0D, KC_##K0E, KC_NO,    /* 08-0F */ \
+    KC_NO,    KC_##K11, KC_##K12, KC_NO,    KC_##K14, KC_##K15, KC_##K16, KC_NO,    /* 10-17 */ \
+    KC_NO,    KC_NO,    KC_##K1A, KC_##K1B, KC_##K1C, KC_##K1D, KC_##K1E, KC_NO,    /* 18-1F */ \
+    KC_NO,    KC_##K21, KC_##K22, KC_##K23, KC_##K24, KC_##K25, KC_##K26, KC_NO,    /* 20-27 */ \
+    KC_NO,    KC_##K29, KC_##K2A, KC_##K2B, KC_##K2C, KC_##K2D, KC_##K2E, KC_NO,    /* 28-2F */ \
+    KC_NO,    KC_##K31, KC_##K32, KC_##K33, KC_##K34, KC_##K35, KC_##K36, KC_NO,    /* 30-37 */ \
+    KC_NO,    KC_NO,    KC_##K3A, KC_##K3B, KC_##K3C, KC_##K3D, KC_##K3E, KC_NO,    /* 38-3F */ \
+    KC_NO,    KC_##K41, KC_##K42, KC_##K43, KC_##K44, KC_##K45, KC_##K46, KC_NO,    /* 40-47 */ \
+    KC_NO,    KC_##K49, KC_##K4A, KC_##K4B, KC_##K4C, KC_##K4D, KC_##K4E, KC_NO,    /* 48-4F */ \
+    KC_NO,    KC_NO,    KC_##K52, KC_NO,    KC_##K54, KC_##K55, KC_NO,    KC_NO,    /* 50-57 */ \
+    KC_##K58, KC_##K59, KC_##K5A, KC_##K5B, KC_NO,    KC_##K5D, KC_NO,    KC_NO,    /* 58-5F */ \
+    KC_NO,    KC_NO,    KC_NO,    KC_NO,    KC_NO,    KC_NO,    KC_##K66, KC_NO,    /* 60-67 */ \
+    KC_NO,    KC_##K69, KC_NO,    KC_##K6B, KC_##K6C, KC_NO,    KC_NO,    KC_NO,    /* 68-6F */ \
+    KC_##K70, KC_##K71, KC_##K72, KC_##K73, KC_##K74, KC_##K75, KC_##K76, KC_##K77, /* 70-77 */ \
+    KC_NO,    KC_##K79, KC_##K7A, KC_##K7B, KC_##K7C, KC_##K7D, KC_##K7E, KC_##K7F, /* 78-7F */ \
+    SCANCODE_MEDIA_KEYS \
 }
 // clang-format on
 
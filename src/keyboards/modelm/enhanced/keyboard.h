@@ -22,6 +22,8 @@
 #define KEYMAP_H
 
 #include "hid_keycodes.h"
+#include "keymaps.h"
+#include "scancode.h"
 
 // clang-format off
 /* IBM Model M Enhanced Keyboard
@@ -40,8 +42,10 @@
  * |-----------------------------------------------------------| ,-----------. |-----------|   |
  * | 14 |    | 11 |          29                 | *11|     |*14| |*6B|*72|*74| |     70| 71|   |
  * `----'    `---------------------------------------'     `---' `-----------' `---------------'
- * *: E0-prefixed codes.
- * +: Special codes sequence
+ * *: E0-prefixed codes, which are named by their extended keymap position in the macro below
+ *    (E0 11 is K91).
+ * +: Special codes sequence (Print Screen is also 84 when Alt is held, and Pause is also E0 7E
+ *    when Control is held)
  * ~: Remaps to alternate code (83-02)
  * ±: ISO Hash Key uses same code as ANSI Backslash
  * 
@@ -49,29 +53,47 @@
  */
 
 #define KEYMAP( \
-    K76,    K05,K06,K04,K0C,  K03,K0B,K02,K0A,  K01,K09,K78,K07,  K7F,K7E,K00, \
-    K0E,K16,K1E,K26,K25,K2E,K36,K3D,K3E,K46,K45,K4E,K55,    K66,  K39,K2F,K5E,  K77,K60,K7C,K7B, \
-    K0D,    K15,K1D,K24,K2D,K2C,K35,K3C,K43,K44,K4D,K54,K5B,K5D,  K37,K5C,K56,  K6C,K75,K7D,K79, \
+    K76,    K05,K06,K04,K0C,  K03,K0B,K02,K0A,  K01,K09,K78,K07,  KFC,K7E,KF7, \
+    K0E,K16,K1E,K26,K25,K2E,K36,K3D,K3E,K46,K45,K4E,K55,    K66,  KF0,KEC,KFD,  K77,KCA,K7C,K7B, \
+    K0D,    K15,K1D,K24,K2D,K2C,K35,K3C,K43,K44,K4D,K54,K5B,K5D,  KF1,KE9,KFA,  K6C,K75,K7D,K79, \
     K58,    K1C,K1B,K23,K2B,K34,K33,K3B,K42,K4B,K4C,K52,    K5A,                K6B,K73,K74,     \
-    K12,K61,K1A,K22,K21,K2A,K32,K31,K3A,K41,K49,K4A,        K59,      K4F,      K69,K72,K7A,K62, \
-    K14,    K11,                K29,                K0F,    K19,  K53,K3F,K47,      K70,K71 \
+    K12,K61,K1A,K22,K21,K2A,K32,K31,K3A,K41,K49,K4A,        K59,      KF5,      K69,K72,K7A,KDA, \
+    K14,    K11,                K29,                K91,    K94,  KEB,KF2,KF4,      K70,K71 \
 ) { \
-    { KC_##K00, KC_##K01, KC_##K02, KC_##K03, KC_##K04, KC_##K05, KC_##K06, KC_##K07,   /* 00-07 */ \
-      KC_NO,    KC_##K09, KC_##K0A, KC_##K0B, KC_##K0C, KC_##K0D, KC_##K0E, KC_##K0F }, /* 08-0F */ \
-    { KC_NO,    KC_##K11, KC_##K12, KC_NO,    KC_##K14, KC_##K15, KC_##K16, KC_NO,      /* 10-17 */ \
-      KC_NO,    KC_##K19, KC_##K1A, KC_##K1B, KC_##K1C, KC_##K1D, KC_##K1E, KC_NO    }, /* 18-1F */ \
-    { KC_NO,    KC_##K21, KC_##K22, KC_##K23, KC_##K24, KC_##K25, KC_##K26, KC_NO,      /* 20-27 */ \
-      KC_NO,    KC_##K29, KC_##K2A, KC_##K2B, KC_##K2C, KC_##K2D, KC_##K2E, KC_##K2F }, /* 28-2F */ \
-    { KC_NO,    KC_##K31, KC_##K32, KC_##K33, KC_##K34, KC_##K35, KC_##K36, KC_##K37,   /* 30-37 */ \
-      KC_NO,    KC_##K39, KC_##K3A, KC_##K3B, KC_##K3C, KC_##K3D, KC_##K3E, KC_##K3F }, /* 38-3F */ \
-    { KC_NO,    KC_##K41, KC_##K42, KC_##K43, KC_##K44, KC_##K45, KC_##K46, KC_##K47,   /* 40-47 */ \
-      KC_NO,    KC_##K49, KC_##K4A, KC_##K4B, KC_##K4C, KC_##K4D, KC_##K4E, KC_##K4F }, /* 48-4F */ \
-    { KC_NO,    KC_NO,    KC_##K52, KC_##K53, KC_##K54, KC_##K55, KC_##K56, KC_NO,      /* 50-57 */ \
-      KC_##K58, KC_##K59, KC_##K5A, KC_##K5B, KC_##K5C, KC_##K5D, KC_##K5E, KC_NO    }, /* 58-5F */ \
-    { KC_##K60, KC_##K61, KC_##K62, KC_NO,    KC_NO,    KC_NO,    KC_##K66, KC_NO,      /* 60-67 */ \
-      KC_NO,    KC_##K69, KC_NO,    KC_##K6B, KC_##K6C, KC_NO,    KC_NO,    KC_NO    }, /* 68-6F */ \
-    { KC_##K70, KC_##K71, KC_##K72, KC_##K73, KC_##K74, KC_##K75, KC_##K76, KC_##K77,   /* 70-77 */ \
-      KC_##K78, KC_##K79, KC_##K7A, KC_##K7B, KC_##K7C, KC_##K7D, KC_##K7E, KC_##K7F }  /* 78-7F */ \
+    KC_NO,    KC_##K01, KC_##K02, KC_##K03, KC_##K04, KC_##K05, KC_##K06, KC_##K07, /* 00-07 */ \
+    KC_NO,    KC_##K09, KC_##K0A, KC_##K0B, KC_##K0C, KC_##K0D, KC_##K0E, KC_NO,    /* 08-0F */ \
+    KC_NO,    KC_##K11, KC_##K12, KC_NO,    KC_##K14, KC_##K15, KC_##K16, KC_NO,    /* 10-17 */ \
+    KC_NO,    KC_NO,    KC_##K1A, KC_##K1B, KC_##K1C, KC_##K1D, KC_##K1E, KC_NO,    /* 18-1F */ \
+    KC_NO,    KC_##K21, KC_##K22, KC_##K23, KC_##K24, KC_##K25, KC_##K26, KC_NO,    /* 20-27 */ \
+    KC_NO,    KC_##K29, KC_##K2A, KC_##K2B, KC_##K2C, KC_##K2D, KC_##K2E, KC_NO,    /* 28-2F */ \
+    KC_NO,    KC_##K31, KC_##K32, KC_##K33, KC_##K34, KC_##K35, KC_##K36, KC_NO,    /* 30-37 */ \
+    KC_NO,    KC_NO,    KC_##K3A, KC_##K3B, KC_##K3C, KC_##K3D, KC_##K3E, KC_NO,    /* 38-3F */ \
+    KC_NO,    KC_##K41, KC_##K42, KC_##K43, KC_##K44, KC_##K45, KC_##K46, KC_NO,    /* 40-47 */ \
+    KC_NO,    KC_##K49, KC_##K4A, KC_##K4B, KC_##K4C, KC_##K4D, KC_##K4E, KC_NO,    /* 48-4F */ \
+    KC_NO,    KC_NO,    KC_##K52, KC_NO,    KC_##K54, KC_##K55, KC_NO,    KC_NO,    /* 50-57 */ \
+    KC_##K58, KC_##K59, KC_##K5A, KC_##K5B, KC_NO,    KC_##K5D, KC_NO,    KC_NO,    /* 58-5F */ \
+    KC_NO,    KC_##K61, KC_NO,    KC_NO,    KC_NO,    KC_NO,    KC_##K66, KC_NO,    /* 60-67 */ \
+    KC_NO,    KC_##K69, KC_NO,    KC_##K6B, KC_##K6C, KC_NO,    KC_NO,    KC_NO,    /* 68-6F */ \
+    KC_##K70, KC_##K71, KC_##K72, KC_##K73, KC_##K74, KC_##K75, KC_##K76, KC_##K77, /* 70-77 */ \
+    KC_##K78, KC_##K79, KC_##K7A, KC_##K7B, KC_##K7C, KC_##K7D, KC_##K7E, KC_##KFC, /* 78-7F */ \
+    [KEYMAP_E0(0x11)] = KC_##K91, /* Right Alt */ \
+    [KEYMAP_E0(0x14)] = KC_##K94, /* Right Ctrl */ \
+    [KEYMAP_E0(0x4A)] = KC_##KCA, /* Keypad / */ \
+    [KEYMAP_E0(0x5A)] = KC_##KDA, /* Keypad Enter */ \
+    [KEYMAP_E0(0x69)] = KC_##KE9, /* End */ \
+    [KEYMAP_E0(0x6B)] = KC_##KEB, /* Cursor Left */ \
+    [KEYMAP_E0(0x6C)] = KC_##KEC, /* Home */ \
+    [KEYMAP_E0(0x70)] = KC_##KF0, /* Insert */ \
+    [KEYMAP_E0(0x71)] = KC_##KF1, /* Delete */ \
+    [KEYMAP_E0(0x72)] = KC_##KF2, /* Cursor Down */ \
+    [KEYMAP_E0(0x74)] = KC_##KF4, /* Cursor Right */ \
+    [KEYMAP_E0(0x75)] = KC_##KF5, /* Cursor Up */ \
+    [KEYMAP_E0(0x77)] = KC_##KF7, /* Pause */ \
+    [KEYMAP_E0(0x7A)] = KC_##KFA, /* Page Down */ \
+    [KEYMAP_E0(0x7C)] = KC_##KFC, /* Print Screen */ \
+    [KEYMAP_E0(0x7D)] = KC_##KFD, /* Page Up */ \
+    [KEYMAP_E0(0x7E)] = KC_##KF7, /* Control'd Pause */ \
+    SCANCODE_MEDIA_KEYS \
 }
 
 // clang-format on
@@ -18,8 +18,8 @@
  * If not, see <https://www.gnu.org/licenses/>.
  */
 
-#if !PICO_NO_FLASH && !PICO_COPY_TO_RAM
-#error "This must be built to run from SRAM!"
+#if !PICO_NO_FLASH && !PICO_COPY_TO_RAM && !CONVERTER_RUN_FROM_FLASH
+#error "This must be built to run from SRAM, or with RUN_FROM_FLASH set!"
 #endif
 
 #include <stdio.h>
@@ -28,13 +28,19 @@
 #include "bsp/board.h"
 #include "config.h"
 #include "hid_interface.h"
+#include "irq_priorities.h"
+#include "led_helper.h"
 #include "pico/unique_id.h"
 #include "tusb.h"
 
 #if KEYBOARD_ENABLED
 #include "keyboard.h"
+#ifdef CONVERTER_SNIFFER
+#include "keyboard_sniffer.h"
+#else
 #include "keyboard_interface.h"
 #endif
+#endif
 
 #if MOUSE_ENABLED
 #include "mouse_interface.h"
@@ -47,9 +53,37 @@
 #ifdef CONVERTER_LEDS
 #include "ws2812/ws2812.h"
 #endif
+#ifdef CONVERTER_MEM_STATS
+#include "mem_stats.h"
+#endif
+#if defined(CONVERTER_REPORT_TRACE) || defined(CONVERTER_KEYCLICK_BENCHMARK)
+#include "perf_counters.h"
+#endif
+#ifdef CONVERTER_TIMELINE
+#include "timeline.h"
+#endif
+#ifdef CONVERTER_FW_UPDATE
+#include "fw_update.h"
+#endif
+#ifdef CONVERTER_MOUSEKEYS
+#include "mousekeys.h"
+#endif
+#ifdef CONVERTER_EVENT_STAMPS
+#include "event_stamps.h"
+#endif
+#ifdef CONVERTER_LOADGEN
+#include "loadgen.h"
+#endif
 
 int main(void) {
+#ifdef CONVERTER_MEM_STATS
+  mem_stats_init();  // Paint the stacks before anything else runs.
+#endif
+  irq_priorities_init();  // Apply the IRQ priority plan before any handlers are installed.
   hid_device_setup();
+#if defined(CONVERTER_REPORT_TRACE) || defined(CONVERTER_KEYCLICK_BENCHMARK)
+  perf_counters_init();  // Start the cycle counter used to measure decode and report cost.
+#endif
   char pico_unique_id[32];
   pico_get_unique_board_id_string(pico_unique_id, sizeof(pico_unique_id));
   printf("--------------------------------\n");
@@ -76,7 +110,12 @@ int main(void) {
   printf("[INFO] Keyboard Protocol: %s\n", KEYBOARD_PROTOCOL);
   printf("[INFO] Keyboard Scancode Set: %s\n", KEYBOARD_CODESET);
   printf("--------------------------------\n");
+#ifdef CONVERTER_SNIFFER
+  printf("[INFO] Keyboard Sniffer Mode, the Keyboard will not be converted\n");
+  keyboard_sniffer_setup(KEYBOARD_DATA_PIN);  // Setup the passive keyboard sniffer.
+#else
   keyboard_interface_setup(KEYBOARD_DATA_PIN);  // Setup the keyboard interface.
+#endif
 #else
   printf("[INFO] Keyboard Support Disabled\n");
 #endif
@@ -90,15 +129,50 @@ int main(void) {
   printf("[INFO] Mouse Support Disabled\n");
 #endif
 
+  irq_priorities_check();  // Ensure nothing has changed the IRQ priority plan during setup.
+
   // These tasks run on Core 0, regardless of whether multicore is enabled.
   while (1) {
 #if KEYBOARD_ENABLED
+#ifdef CONVERTER_SNIFFER
+    keyboard_sniffer_task();  // Print any frames captured from the keyboard bus.
+#else
     keyboard_interface_task();  // Keyboard interface task.
 #endif
+#endif
 #if MOUSE_ENABLED
     mouse_interface_task();  // Mouse interface task.
+#endif
+#ifdef CONVERTER_MOUSEKEYS
+    mousekeys_task();  // Send any Mouse Key movement once the Mouse endpoint has been polled.
 #endif
     tud_task();  // TinyUSB device task.
+    hid_device_task();  // Re-enumerate if the set of USB functions has changed.
+    irq_priorities_task();  // Report any increase in IRQ entry latency.
+#ifdef CONVERTER_KEYCLICK
+    buzzer_task();  // Keyclick feedback task.
+#endif
+#ifdef CONVERTER_KEYCLICK_BENCHMARK
+    hid_keyclick_benchmark_task();  // Measure the report path with and without the Keyclick.
+#endif
+#ifdef CONVERTER_LEDS
+    update_converter_status();  // Refresh the LEDs if any converter or lock state was published.
+#endif
+#ifdef CONVERTER_MEM_STATS
+    mem_stats_task();  // Report any new stack or heap usage peaks.
+#endif
+#ifdef CONVERTER_TIMELINE
+    timeline_task();  // Measure report latency, and dump the timeline of any slow reports.
+#endif
+#ifdef CONVERTER_FW_UPDATE
+    fw_update_task();  // Reply to the update host, and swap in a verified image when requested.
+#endif
+#ifdef CONVERTER_EVENT_STAMPS
+    event_stamps_task();  // Send the timestamps of recent events to the host.
+#endif
+#ifdef CONVERTER_LOADGEN
+    loadgen_task();  // Inject the next run of load once idle, and report the results of the last.
+#endif
   }
 
   return 0;
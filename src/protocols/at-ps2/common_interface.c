@@ -20,6 +20,20 @@
 
 #include "common_interface.h"
 
+#include <stdio.h>
+
+#include "led_helper.h"
+
+#ifdef CONVERTER_PORT_DETECT
+// The AT/PS2 device drivers, indexed by the role of the device each one drives.
+static struct {
+  uint data_pin;                // Data pin of the port the driver is currently bound to
+  void (*bind)(uint data_pin);  // Moves the driver to another port, or NULL if not registered
+} interface_ports[INTERFACE_ROLE_MOUSE + 1];
+
+static const char *const interface_role_names[] = {"Unknown Device", "Keyboard", "Mouse"};
+#endif
+
 /**
  * @brief Mapping of HEX to Parity Bit for input from AT Keyboard.
  *
@@ -55,4 +69,109 @@ uint8_t interface_parity_table[256] = {
     0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,  // D
     0, 1, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0,  // E
     1, 0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1, 0, 0, 1   // F
-};
\ No newline at end of file
+};
+
+/**
+ * @brief Decodes a frame received by the oversampling AT/PS2 Interface PIO program.
+ * The Start Bit is sampled once, followed by three samples of each of the 8 Data Bits, Parity Bit
+ * and Stop Bit, which are majority voted.  The result has the same layout as a frame received by
+ * the standard program, so can be validated in exactly the same way.
+ *
+ * @param rxf   The raw value read from the PIO RX FIFO.
+ * @param stats The majority vote statistics for the interface.
+ *
+ * @return The frame, with the Start Bit in bit 0, followed by the Data, Parity and Stop Bits.
+ */
+uint16_t __not_in_flash_func(interface_oversample_decode)(uint32_t rxf, pio_vote_stats_t *stats) {
+  // 31 bits are shifted in from the top of the ISR, so the Start Bit lands in bit 1.
+  return (uint16_t)(((rxf >> 1) & 0x1) | (pio_majority_vote(rxf >> 2, 10, stats) << 1));
+}
+
+/**
+ * @brief Identifies the role of an AT/PS2 device from the first byte of its Read ID response.
+ * Mice respond with a single byte (0x00 for a standard mouse, 0x03 with a scroll wheel, or 0x04
+ * with five buttons), whereas keyboards respond with two bytes, the first being 0xAB.  Older AT
+ * keyboards don't respond to Read ID at all, so can only be assumed to be keyboards.
+ *
+ * @param id_byte The first byte of the Read ID response.
+ *
+ * @return The role of the device, or INTERFACE_ROLE_UNKNOWN if it can't be told from the ID.
+ */
+interface_role_t interface_role_from_id(uint8_t id_byte) {
+  switch (id_byte) {
+    case 0x00:
+    case 0x03:
+    case 0x04:
+      return INTERFACE_ROLE_MOUSE;
+    case 0xAB:
+      return INTERFACE_ROLE_KEYBOARD;
+    default:
+      return INTERFACE_ROLE_UNKNOWN;
+  }
+}
+
+#ifdef CONVERTER_PORT_DETECT
+/**
+ * @brief Registers an AT/PS2 device driver, along with the port it has been set up on.
+ *
+ * @param role     The role of the device the driver expects.
+ * @param data_pin The data pin of the port the driver has been set up on.
+ * @param bind     Moves the driver to the port with the given data pin, restarting its interface
+ *                 program there and re-initialising any device attached.
+ */
+void interface_port_register(interface_role_t role, uint data_pin, void (*bind)(uint data_pin)) {
+  interface_ports[role].data_pin = data_pin;
+  interface_ports[role].bind = bind;
+}
+
+/**
+ * @brief Handles a driver finding a device with a different role attached to its port.
+ * If the driver for the device found is registered, and its own device isn't already initialised,
+ * the two drivers swap ports, so each re-initialises the device it expects.  This covers a mouse
+ * and keyboard connected the wrong way round, as well as a single device in the wrong port.
+ * Otherwise the device can't be driven, and the driver should leave the port idle until a new
+ * device is connected.
+ *
+ * @param role  The role of the driver reporting the device.
+ * @param found The role of the device found.
+ *
+ * @return true if the drivers have swapped ports, false if the device can't be driven.
+ *
+ * @note This must only be called from task context, as both drivers are rebound.
+ */
+bool interface_port_mismatch(interface_role_t role, interface_role_t found) {
+  uint data_pin = interface_ports[role].data_pin;
+  uint8_t found_ready =
+      found == INTERFACE_ROLE_KEYBOARD ? CONVERTER_KB_READY : CONVERTER_MOUSE_READY;
+
+  if (interface_ports[found].bind == NULL) {
+#if KEYBOARD_ENABLED
+    if (found == INTERFACE_ROLE_KEYBOARD) {
+      // Keyboard support is enabled, but not through an AT/PS2 driver which can take the port.
+      printf("[ERR] AT/PS2 Keyboard connected on GPIO %u, but the Keyboard is configured for "
+             "the %s protocol\n",
+             data_pin, KEYBOARD_PROTOCOL);
+      return false;
+    }
+#endif
+    printf("[ERR] %s connected on GPIO %u, but %s support is not enabled\n",
+           interface_role_names[found], data_pin, interface_role_names[found]);
+    return false;
+  }
+  if (state_word_get(&converter_state) & found_ready) {
+    printf("[ERR] %s connected on GPIO %u, but a %s is already connected on GPIO %u\n",
+           interface_role_names[found], data_pin, interface_role_names[found],
+           interface_ports[found].data_pin);
+    return false;
+  }
+
+  printf("[INFO] %s connected on GPIO %u, swapping the %s and %s ports\n",
+         interface_role_names[found], data_pin, interface_role_names[role],
+         interface_role_names[found]);
+  interface_ports[role].data_pin = interface_ports[found].data_pin;
+  interface_ports[found].data_pin = data_pin;
+  interface_ports[role].bind(interface_ports[role].data_pin);
+  interface_ports[found].bind(data_pin);
+  return true;
+}
+#endif
@@ -21,8 +21,34 @@
 #ifndef COMMON_INTERFACE_H
 #define COMMON_INTERFACE_H
 
+#include "config.h"
 #include "pico/stdlib.h"
+#include "pio_helper.h"
+
+// Select the receiver variant of the AT/PS2 Interface PIO program.
+#ifdef CONVERTER_OVERSAMPLE
+#define INTERFACE_PROGRAM pio_interface_oversample_program
+#define INTERFACE_PROGRAM_INIT pio_interface_oversample_program_init
+#else
+#define INTERFACE_PROGRAM pio_interface_program
+#define INTERFACE_PROGRAM_INIT pio_interface_program_init
+#endif
+
+// Roles of the device attached to an AT/PS2 port, identified from its response to Read ID (0xF2).
+typedef enum {
+  INTERFACE_ROLE_UNKNOWN,
+  INTERFACE_ROLE_KEYBOARD,
+  INTERFACE_ROLE_MOUSE,
+} interface_role_t;
 
 extern uint8_t interface_parity_table[];
 
+uint16_t interface_oversample_decode(uint32_t rxf, pio_vote_stats_t *stats);
+interface_role_t interface_role_from_id(uint8_t id_byte);
+
+#ifdef CONVERTER_PORT_DETECT
+void interface_port_register(interface_role_t role, uint data_pin, void (*bind)(uint data_pin));
+bool interface_port_mismatch(interface_role_t role, interface_role_t found);
+#endif
+
 #endif /* COMMON_INTERFACE_H */
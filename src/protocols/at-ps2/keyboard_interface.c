@@ -25,13 +25,19 @@
 #include "bsp/board.h"
 #include "buzzer.h"
 #include "common_interface.h"
+#include "flood_guard.h"
 #include "hardware/clocks.h"
+#include "hid_interface.h"
 #include "interface.pio.h"
 #include "led_helper.h"
 #include "pio_helper.h"
 #include "ringbuf.h"
 #include "scancode.h"
 
+#ifdef CONVERTER_TIMELINE
+#include "timeline.h"
+#endif
+
 uint keyboard_sm = 0;
 uint keyboard_offset = 0;
 PIO keyboard_pio;
@@ -43,9 +49,18 @@ uint keyboard_data_pin;
 // Keyboards.
 #define CODESET_3 (strcmp(KEYBOARD_CODESET, "set3") == 0)
 
-static uint8_t keyboard_lock_leds = 0;
+static uint8_t keyboard_lock_leds = 0;          // Lock LED state last applied to the keyboard.
+static uint8_t keyboard_lock_leds_pending = 0;  // Lock LED state currently being sent.
+static uint32_t keyboard_lock_leds_seen = 0;    // Last observed snapshot of `lock_leds_state`.
+static uint8_t keyboard_resync_count = 0;       // Consecutive misaligned frames since a valid one.
+static flood_guard_t keyboard_guard;            // Flood protection for the Keyboard port.
+static pio_resync_t keyboard_resync;            // Resynchronisation of the Keyboard port.
+static float keyboard_clock_div;                // Clock divider of the interface program.
 static bool id_retry =
     false;  // Used to determine whether we've already retried reading the Keyboard ID.
+#ifdef CONVERTER_OVERSAMPLE
+static pio_vote_stats_t keyboard_vote_stats = {0};
+#endif
 
 // Define the Stop Bit State.  This will help to determine if we are compliant with the AT/PS2 protocol, or whether we are likely a Z-150 or similar keyboard.
 // By default, the Stop Bit should be HIGH following the Parity Bit.  If the Stop Bit is LOW, then we could be dealing with a Z-150 or similar keyboard.
@@ -65,6 +80,10 @@ static enum {
   INIT_SETUP,
   SET_LOCK_LEDS,
   INITIALISED,
+#ifdef CONVERTER_PORT_DETECT
+  PORT_MISMATCH,     // A mouse has been identified, so the port is being handed over.
+  PORT_UNSUPPORTED,  // No driver could take the port, so it is idle until a new device connects.
+#endif
 } keyboard_state = UNINITIALISED;
 
 /**
@@ -76,11 +95,25 @@ static enum {
  *
  * @param data_byte The data byte to be sent to the keyboard.
  */
-static void keyboard_command_handler(uint8_t data_byte) {
+static void __not_in_flash_func(keyboard_command_handler)(uint8_t data_byte) {
   uint16_t data_with_parity = (uint16_t)(data_byte + (interface_parity_table[data_byte] << 8));
   pio_sm_put(keyboard_pio, keyboard_sm, data_with_parity);
 }
 
+/**
+ * @brief Asks the Keyboard to send the byte which was just lost again.
+ * Resend makes the Keyboard repeat the last byte it sent.  If frames are already queued in the RX
+ * FIFO behind the lost one, the Keyboard has moved on, and a Resend would only duplicate the last
+ * of them, so the lost byte is dropped instead.
+ */
+static void __not_in_flash_func(keyboard_request_resend)(void) {
+  if (!pio_sm_is_rx_fifo_empty(keyboard_pio, keyboard_sm)) {
+    printf("[DBG] Keyboard has sent more since, so the lost byte is dropped without a Resend\n");
+    return;
+  }
+  keyboard_command_handler(0xFE);
+}
+
 /**
  * @brief Processes keyboard event data.
  * This function is responsible for processing keyboard events and updating the keyboard state
@@ -90,7 +123,7 @@ static void keyboard_command_handler(uint8_t data_byte) {
  *
  * @param data_byte The data byte received from the keyboard.
  */
-static void keyboard_event_processor(uint8_t data_byte) {
+static void __not_in_flash_func(keyboard_event_processor)(uint8_t data_byte) {
   switch (keyboard_state) {
     case UNINITIALISED:
       id_retry = false;      // Reset the id_retry flag as we are uninitialised.
@@ -100,8 +133,11 @@ static void keyboard_event_processor(uint8_t data_byte) {
           // Likely we are powering on for the first time and initialising. Keyboard sends 0xAA on
           // power on following successful BAT
           printf("[DBG] Keyboard Self Test OK!\n");
+#ifndef CONVERTER_PORT_DETECT
           buzzer_play_sound_sequence_non_blocking(READY_SEQUENCE);
+#endif
           keyboard_lock_leds = 0;
+          keyboard_lock_leds_seen = 0;  // Force the host Lock LED state to be re-applied.
           printf("[DBG] Waiting for Keyboard ID...\n");
           keyboard_state = INIT_READ_ID_1;
           break;
@@ -128,8 +164,11 @@ static void keyboard_event_processor(uint8_t data_byte) {
       switch (data_byte) {
         case 0xAA:
           printf("[DBG] Keyboard Self Test OK!\n");
+#ifndef CONVERTER_PORT_DETECT
           buzzer_play_sound_sequence_non_blocking(READY_SEQUENCE);
+#endif
           keyboard_lock_leds = 0;
+          keyboard_lock_leds_seen = 0;  // Force the host Lock LED state to be re-applied.
           // Move on to attempting to read the Keyboard ID.
           printf("[DBG] Waiting for Keyboard ID...\n");
           keyboard_state = INIT_READ_ID_1;
@@ -152,6 +191,15 @@ static void keyboard_event_processor(uint8_t data_byte) {
           printf("[DBG] Waiting for Keyboard ID...\n");
           break;
         default:
+#ifdef CONVERTER_PORT_DETECT
+          if (interface_role_from_id(data_byte) == INTERFACE_ROLE_MOUSE) {
+            printf("[DBG] Mouse ID (0x%02X) read from the Keyboard port\n", data_byte);
+            keyboard_state = PORT_MISMATCH;
+            break;
+          }
+          // Only now do we know that it is a Keyboard which passed its Self Test.
+          buzzer_play_sound_sequence_non_blocking(READY_SEQUENCE);
+#endif
           printf("[DBG] Keyboard First ID Byte read as 0x%02X\n", data_byte);
           keyboard_id &= 0x00FF;
           keyboard_id |= (uint16_t)data_byte << 8;
@@ -195,11 +243,13 @@ static void keyboard_event_processor(uint8_t data_byte) {
       // We likely need to check for a F0 event (key-up) but I think we should be OK?
       switch (data_byte) {
         case 0xFA:
-          if (lock_leds.value != keyboard_lock_leds) {
-            keyboard_lock_leds = lock_leds.value;
-            keyboard_command_handler((uint8_t)((lock_leds.keys.capsLock << 2) |
-                                               (lock_leds.keys.numLock << 1) |
-                                               lock_leds.keys.scrollLock));
+          if (keyboard_lock_leds != keyboard_lock_leds_pending) {
+            // ACK of the 0xED command, so now send the Lock LED state itself.
+            keyboard_lock_leds = keyboard_lock_leds_pending;
+            keyboard_command_handler(
+                (uint8_t)((keyboard_lock_leds & LOCK_LED_CAPS ? 0x04 : 0) |
+                          (keyboard_lock_leds & LOCK_LED_NUM ? 0x02 : 0) |
+                          (keyboard_lock_leds & LOCK_LED_SCROLL ? 0x01 : 0)));
           } else {
             // We've received the ACK for setting the Lock LEDs, so we can move on.
             buzzer_play_sound_sequence_non_blocking(LOCK_LED);
@@ -208,19 +258,34 @@ static void keyboard_event_processor(uint8_t data_byte) {
           break;
         default:
           printf("[DBG] SET_LOCK_LED FAILED (0x%02X)\n", data_byte);
-          keyboard_lock_leds = lock_leds.value;
+          keyboard_lock_leds = keyboard_lock_leds_pending;
           keyboard_state = INITIALISED;
       }
       break;
 
     // If we are initialised, then we should process the keycodes.
     case INITIALISED:
+#ifdef CONVERTER_TIMELINE
+      timeline_record(TIMELINE_KEYBOARD_RX, data_byte);
+#endif
       if (!ringbuf_is_full()) ringbuf_put(data_byte);
-  }
-#ifdef CONVERTER_LEDS
-  converter.state.kb_ready = keyboard_state == INITIALISED ? 1 : 0;
-  update_converter_status();
+      break;
+
+#ifdef CONVERTER_PORT_DETECT
+    // Nothing is processed while the port is handed over, or left idle.  A device connected to an
+    // idle port announces itself with a Self Test result, so we reset it to identify it again.
+    case PORT_MISMATCH:
+      break;
+    case PORT_UNSUPPORTED:
+      if (data_byte == 0xAA) {
+        printf("[DBG] Device connected, Asking it to Reset\n");
+        keyboard_state = INIT_AWAIT_ACK;
+        keyboard_command_handler(0xFF);
+      }
+      break;
 #endif
+  }
+  converter_set_state(CONVERTER_KB_READY, keyboard_state == INITIALISED);
 }
 
 /**
@@ -234,8 +299,14 @@ static void keyboard_event_processor(uint8_t data_byte) {
  * - If all the validation checks pass, the data byte is processed by the keyboard_event_processor()
  * function.
  */
-static void __isr keyboard_input_event_handler() {
+static void __isr __not_in_flash_func(keyboard_input_event_handler)() {
+#ifdef CONVERTER_OVERSAMPLE
+  io_ro_32 data_cast =
+      interface_oversample_decode(keyboard_pio->rxf[keyboard_sm], &keyboard_vote_stats);
+#else
   io_ro_32 data_cast = keyboard_pio->rxf[keyboard_sm] >> 21;
+#endif
+  if (!flood_guard_byte(&keyboard_guard)) return;  // Drop anything received once inhibited.
   uint16_t data = (uint16_t)data_cast;
 
   // Extract the Start Bit, Parity Bit and Stop Bit.
@@ -252,6 +323,8 @@ static void __isr keyboard_input_event_handler() {
   }
 
   if (start_bit != 0 || parity_bit != parity_bit_check) {
+    converter_report_error();
+    if (!flood_guard_error(&keyboard_guard)) return;  // Too many errors, so the port is inhibited.
     if (start_bit != 0) printf("[ERR] Start Bit Validation Failed: start_bit=%i\n", start_bit);
     if (parity_bit != parity_bit_check) {
       printf("[ERR] Parity Bit Validation Failed: expected=%i, actual=%i\n", parity_bit_check,
@@ -268,19 +341,55 @@ static void __isr keyboard_input_event_handler() {
         pio_restart(keyboard_pio, keyboard_sm, keyboard_offset);
       }
       // Ask Keyboard to re-send the data.
-      keyboard_command_handler(0xFE);
+      keyboard_request_resend();
       return;  // We don't want to process this event any further.
     }
-    // We should reset/restart the State Machine
+    // A bad Start Bit means we started reading part way through a frame.  Once initialised, we
+    // realign with the next frame once the line is idle, keeping any frames already queued, and ask
+    // for this one again.  The Resend is only sent once the line is idle, and its host inhibit
+    // makes the keyboard restart its own frame from the top.
+    if (keyboard_state == INITIALISED && ++keyboard_resync_count < CONVERTER_RESYNC_LIMIT) {
+      printf("[DBG] Resynchronising Keyboard (%u/%u)\n", keyboard_resync_count,
+             CONVERTER_RESYNC_LIMIT);
+      pio_resync(&keyboard_resync, keyboard_offset);
+      keyboard_request_resend();
+      return;
+    }
+    // Otherwise we should reset/restart the State Machine
+    keyboard_resync_count = 0;
     keyboard_state = UNINITIALISED;
     id_retry = false;
     pio_restart(keyboard_pio, keyboard_sm, keyboard_offset);
     return;
   }
+  keyboard_resync_count = 0;
 
   keyboard_event_processor(data_byte);
 }
 
+#ifdef CONVERTER_LOADGEN
+/**
+ * @brief Injects a data byte as though it had just been received from the Keyboard.
+ * The byte is handed to keyboard_event_processor(), exactly as the IRQ handler would once a frame
+ * has been validated, so it passes through the rest of the pipeline as a real scancode.  Bytes are
+ * only accepted once the Keyboard has been initialised, so they can't be mistaken for responses to
+ * any command.
+ *
+ * @param data_byte The data byte to inject.
+ *
+ * @return true if the byte was queued, false if the Keyboard isn't initialised or the ring buffer
+ *         is full.
+ *
+ * @note This must be called at the same IRQ priority as the PIO, so it can't interleave with the
+ *       IRQ handler.
+ */
+bool __not_in_flash_func(keyboard_interface_inject)(uint8_t data_byte) {
+  if (keyboard_state != INITIALISED || ringbuf_is_full()) return false;
+  keyboard_event_processor(data_byte);
+  return true;
+}
+#endif
+
 /**
  * @brief Task function for the keyboard interface.
  * This function handles the initialization and communication with the keyboard.
@@ -294,24 +403,62 @@ static void __isr keyboard_input_event_handler() {
 void keyboard_interface_task() {
   static uint8_t detect_stall_count = 0;
 
+#ifdef CONVERTER_OVERSAMPLE
+  pio_vote_report("Keyboard", &keyboard_vote_stats);
+#endif
+
+  if (flood_guard_task(&keyboard_guard)) {
+    // The port is inhibited, so the keyboard is re-initialised once it has been released.
+    keyboard_resync_count = 0;
+    keyboard_state = UNINITIALISED;
+    id_retry = false;
+    detect_stall_count = 0;
+    converter_set_state(CONVERTER_KB_READY, false);
+    return;
+  }
+  pio_resync_task(&keyboard_resync);  // Resume the interface once the line is idle after a resync.
+
+#ifdef CONVERTER_PORT_DETECT
+  if (keyboard_state == PORT_MISMATCH) {
+    // Hand the port over to the Mouse driver, or leave it idle if it can't be taken.
+    if (!interface_port_mismatch(INTERFACE_ROLE_KEYBOARD, INTERFACE_ROLE_MOUSE)) {
+      keyboard_state = PORT_UNSUPPORTED;
+    }
+    return;
+  }
+  if (keyboard_state == PORT_UNSUPPORTED) return;
+#endif
+
   if (keyboard_state == INITIALISED) {
     // Handle further initialization steps now, this is more for terminal keyboard support.
     // This portion helps with Lock LED changes.  We only get here once the keyboard has
     // initialised.
     detect_stall_count = 0;  // Reset the detect_stall_count as we are initialised.
-    if (lock_leds.value != keyboard_lock_leds) {
+    if (state_word_changed(&lock_leds_state, &keyboard_lock_leds_seen) &&
+        state_word_value(keyboard_lock_leds_seen) != keyboard_lock_leds) {
+      // The host has published a new Lock LED state which the keyboard doesn't yet reflect.
+      keyboard_lock_leds_pending = state_word_value(keyboard_lock_leds_seen);
       keyboard_state = SET_LOCK_LEDS;
       keyboard_command_handler(0xED);
     } else {
-      if (!ringbuf_is_empty() && tud_hid_ready()) {
-        // We only process the ringbuffer if it's not empty and we're ready to send a HID report.
-        // If we don't check for HID ready, we can end up having reports fail to send.
+      if (!ringbuf_is_empty() && hid_keyboard_ready()) {
+        // We only process the ringbuffer if it's not empty and we're ready to send a HID report,
+        // or the host is away.  If we don't check for HID ready, we can end up having reports fail
+        // to send.
 
         // Previously we would pause all interrupts while reading the ringbuffer.
         // However, this didn't seem to do anything other than cause latency for keypresses.
         // We may need to revisit this if we encounter issues.
         int c = ringbuf_get();  // Pull from the ringbuffer
-        if (c != -1) process_scancode((uint8_t)c);
+        if (c != -1) {
+#ifdef CONVERTER_REPORT_TRACE
+          hid_decode_begin();  // Time the decode, up to the report being built.
+#endif
+          process_scancode((uint8_t)c);
+#ifdef CONVERTER_REPORT_TRACE
+          hid_decode_end();
+#endif
+        }
       }
     }
   } else {
@@ -339,6 +486,12 @@ void keyboard_interface_task() {
                 detect_stall_count = 0;  // Reset the detect_stall_count as we are retrying.
               } else {
                 printf("[DBG] Keyboard Read ID/Setup Timed out again, continuing with defaults.\n");
+#ifdef CONVERTER_PORT_DETECT
+                // Mice always answer the ID request, so this can only be an older Keyboard.
+                if (keyboard_state == INIT_READ_ID_1) {
+                  buzzer_play_sound_sequence_non_blocking(READY_SEQUENCE);
+                }
+#endif
                 keyboard_id = 0xFFFF;
                 printf("[DBG] Keyboard Initialised!\n");
                 keyboard_state = INITIALISED;
@@ -371,19 +524,48 @@ void keyboard_interface_task() {
         // Reset the detect_stall_count as we are waiting for the clock to go HIGH.
         detect_stall_count = 0;
       }
-#ifdef CONVERTER_LEDS
-      converter.state.kb_ready = keyboard_state == INITIALISED ? 1 : 0;
-      update_converter_status();
-#endif
+      converter_set_state(CONVERTER_KB_READY, keyboard_state == INITIALISED);
     }
   }
 }
 
+#ifdef CONVERTER_PORT_DETECT
+/**
+ * @brief Moves the keyboard interface to the port with the given data pin.
+ * The interface program is restarted on the new pins, discarding anything received on the old
+ * port, and any device already attached to the new port is asked to reset, so it can be identified
+ * and initialised from scratch.
+ *
+ * @param data_pin The data pin of the port to move to.
+ */
+static void keyboard_interface_bind(uint data_pin) {
+  uint32_t irq_state = save_and_disable_interrupts();
+  pio_sm_set_enabled(keyboard_pio, keyboard_sm, false);
+  INTERFACE_PROGRAM_INIT(keyboard_pio, keyboard_sm, keyboard_offset, data_pin, keyboard_clock_div);
+  keyboard_data_pin = data_pin;
+  keyboard_resync_count = 0;
+  keyboard_state = UNINITIALISED;
+  id_retry = false;
+  ringbuf_reset();
+  restore_interrupts(irq_state);
+
+  flood_guard_init(&keyboard_guard, "Keyboard", keyboard_pio, keyboard_sm, keyboard_offset,
+                   data_pin + 1, CONVERTER_FLOOD_KEYBOARD_BYTES);
+  pio_resync_init(&keyboard_resync, keyboard_pio, keyboard_sm, data_pin + 1);
+  converter_set_state(CONVERTER_KB_READY, false);
+  printf("[INFO] Keyboard Interface moved to GPIO %u\n", data_pin);
+  if (gpio_get(data_pin + 1) == 1) {
+    keyboard_state = INIT_AWAIT_ACK;
+    keyboard_command_handler(0xFF);
+  }
+}
+#endif
+
 /**
  * @brief Initializes the AT/PS2 PIO interface for the keyboard.
  * This function initializes the AT/PS2 PIO interface for the keyboard by performing the following
  * steps:
- * 1. Resets the converter status if CONVERTER_LEDS is defined.
+ * 1. Resets the converter status.
  * 2. Resets the ring buffer.
  * 3. Finds an available PIO to use for the keyboard interface program.
  * 4. Claims the PIO and loads the program.
@@ -396,10 +578,7 @@ void keyboard_interface_task() {
  * @param data_pin The data pin to be used for the keyboard interface.
  */
 void keyboard_interface_setup(uint data_pin) {
-#ifdef CONVERTER_LEDS
-  converter.state.kb_ready = 0;
-  update_converter_status();  // Always reset Converter Status here
-#endif
+  converter_set_state(CONVERTER_KB_READY, false);  // Always reset Converter Status here
 
   ringbuf_reset();  // Even though Ringbuf is statically initialised, we reset it here to be sure
                     // it's empty.
@@ -411,7 +590,7 @@ void keyboard_interface_setup(uint data_pin) {
   // `find_available_pio` is a helper function that will check both PIO0 and PIO1 for space.
   // If the function returns NULL, then there is no space available, and we should return.
 
-  keyboard_pio = find_available_pio(&pio_interface_program);
+  keyboard_pio = find_available_pio(&INTERFACE_PROGRAM);
   if (keyboard_pio == NULL) {
     printf("[ERR] No PIO available for Keyboard Interface Program\n");
     return;
@@ -419,7 +598,7 @@ void keyboard_interface_setup(uint data_pin) {
 
   // Now we can claim the PIO and load the program.
   keyboard_sm = (uint)pio_claim_unused_sm(keyboard_pio, true);
-  keyboard_offset = pio_add_program(keyboard_pio, &pio_interface_program);
+  keyboard_offset = pio_add_program(keyboard_pio, &INTERFACE_PROGRAM);
   keyboard_data_pin = data_pin;
 
   // Define the IRQ for the PIO State Machine.
@@ -450,7 +629,14 @@ void keyboard_interface_setup(uint data_pin) {
          cycles_per_clock, clock_div);
   printf("[INFO] Effective SM Clock Speed: %.2fkHz\n", (float)(rp_clock_khz / clock_div));
 
-  pio_interface_program_init(keyboard_pio, keyboard_sm, keyboard_offset, data_pin, clock_div);
+  INTERFACE_PROGRAM_INIT(keyboard_pio, keyboard_sm, keyboard_offset, data_pin, clock_div);
+  keyboard_clock_div = clock_div;
+  flood_guard_init(&keyboard_guard, "Keyboard", keyboard_pio, keyboard_sm, keyboard_offset,
+                   data_pin + 1, CONVERTER_FLOOD_KEYBOARD_BYTES);
+  pio_resync_init(&keyboard_resync, keyboard_pio, keyboard_sm, data_pin + 1);
+#ifdef CONVERTER_PORT_DETECT
+  interface_port_register(INTERFACE_ROLE_KEYBOARD, data_pin, keyboard_interface_bind);
+#endif
 
   irq_set_exclusive_handler(pio_irq, &keyboard_input_event_handler);
   irq_set_enabled(pio_irq, true);
@@ -0,0 +1,296 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "keyboard_sniffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common_interface.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/structs/timer.h"
+#include "keyboard_sniffer.pio.h"
+#include "pio_helper.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+
+// Size of each capture buffer in bits, for the DMA ring wrapping (256 x 32-bit words = 1KB).
+#define SNIFFER_CAPTURE_RING_BITS 10
+
+uint sniffer_sm = 0;
+uint sniffer_offset = 0;
+PIO sniffer_pio;
+
+static int sniffer_time_chan = -1;
+static int sniffer_frame_chan = -1;
+
+// The DMA writes the time each frame was received, and the frame itself, to the same index of
+// these buffers.  They must be aligned to their size for the DMA ring wrapping to work.
+static uint32_t sniffer_times[SNIFFER_CAPTURE_SIZE]
+    __attribute__((aligned(SNIFFER_CAPTURE_SIZE * sizeof(uint32_t))));
+static uint32_t sniffer_frames[SNIFFER_CAPTURE_SIZE]
+    __attribute__((aligned(SNIFFER_CAPTURE_SIZE * sizeof(uint32_t))));
+
+/**
+ * @brief Returns a description of a command sent from the Host to the Keyboard.
+ *
+ * @param command The command byte.
+ *
+ * @return The name of the command, or NULL if it is not recognised.
+ */
+static const char *sniffer_host_command_name(uint8_t command) {
+  switch (command) {
+    case 0xED:
+      return "Set LEDs";
+    case 0xEE:
+      return "Echo";
+    case 0xF0:
+      return "Scancode Set";
+    case 0xF2:
+      return "Read ID";
+    case 0xF3:
+      return "Set Typematic";
+    case 0xF4:
+      return "Enable";
+    case 0xF5:
+      return "Disable";
+    case 0xF6:
+      return "Set Default";
+    case 0xF8:
+      return "Set All Make/Break";
+    case 0xFA:
+      return "ACK";
+    case 0xFE:
+      return "Resend";
+    case 0xFF:
+      return "Reset";
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * @brief Returns a description of a response sent from the Keyboard to the Host.
+ *
+ * @param response The response byte.
+ *
+ * @return The name of the response, or NULL if it is not a recognised response.
+ */
+static const char *sniffer_keyboard_response_name(uint8_t response) {
+  switch (response) {
+    case 0xAA:
+      return "BAT OK";
+    case 0xEE:
+      return "Echo";
+    case 0xFA:
+      return "ACK";
+    case 0xFC:
+      return "BAT Failed";
+    case 0xFE:
+      return "Resend";
+    default:
+      return NULL;
+  }
+}
+
+/**
+ * @brief Decodes and prints a single captured frame.
+ * Frames are printed one per line, with the time they were received, the time since the previous
+ * frame, the direction, the byte itself and any framing errors.  As Keyboard to Host bytes are
+ * mostly scancodes, these are only named if they are a recognised response to a command.
+ *
+ * @param time_us The time the frame was received.
+ * @param raw     The raw frame, as pushed by the PIO program.
+ */
+static void sniffer_print_frame(uint32_t time_us, uint32_t raw) {
+  static uint32_t last_us = 0;
+  uint16_t frame = (uint16_t)(raw >> 20);
+  bool host = (frame >> 11) & 0x1;
+  uint8_t data_byte;
+  uint8_t parity_bit;
+  const char *name;
+  const char *error = "";
+
+  if (host) {
+    data_byte = (uint8_t)(frame & 0xFF);
+    parity_bit = (frame >> 8) & 0x1;
+    name = sniffer_host_command_name(data_byte);
+    if (!((frame >> 9) & 0x1)) error = " (Stop Bit Error)";
+    if ((frame >> 10) & 0x1) error = " (No ACK)";
+  } else {
+    data_byte = (uint8_t)((frame >> 1) & 0xFF);
+    parity_bit = (frame >> 9) & 0x1;
+    name = sniffer_keyboard_response_name(data_byte);
+    if (frame & 0x1) error = " (Start Bit Error)";
+  }
+  if (parity_bit != interface_parity_table[data_byte]) error = " (Parity Error)";
+
+  printf("[SNIFF] %10lu +%-8lu %s 0x%02X %s%s\n", (unsigned long)time_us,
+         (unsigned long)(time_us - last_us), host ? "HOST>KBD" : "KBD>HOST", data_byte,
+         name ? name : "", error);
+  last_us = time_us;
+}
+
+/**
+ * @brief Sends captured frames to the host over the vendor interface.
+ * Up to SNIFFER_FRAMES_PER_PACKET frames are packed into each packet, whenever the vendor interface
+ * is ready.  Each packet starts with an 8 byte header:
+ * - [0] SNIFFER_PACKET_ID
+ * - [1] Number of frames in the packet
+ * - [2..3] Reserved, always 0
+ * - [4..7] Device time the packet was sent, from time_us_32(), for aligning the device and host
+ *   clocks
+ *
+ * A bus runs at no more than one frame per millisecond, and each packet carries several, so the
+ * stream keeps up with the capture as long as the host keeps reading.  While the converter isn't
+ * enumerated, frames are skipped rather than held, so the host only receives frames captured
+ * once it is connected.
+ *
+ * @param head Index of the next frame to be written by the DMA.
+ */
+static void sniffer_stream_frames(uint32_t head) {
+  static uint32_t tail = 0;
+  uint8_t instance = usb_hid_report_instance(REPORT_ID_VENDOR);
+
+  if (!tud_mounted() || instance == USB_HID_INSTANCE_NONE) {
+    tail = head;
+    return;
+  }
+  if (tail == head || !tud_hid_n_ready(instance)) return;
+
+  uint8_t packet[SNIFFER_PACKET_SIZE] = {0};
+  uint32_t next = tail;
+  uint8_t count = 0;
+  while (count < SNIFFER_FRAMES_PER_PACKET && next != head) {
+    sniffer_frame_t frame = {
+        .time_us = sniffer_times[next],
+        .frame = (uint16_t)(sniffer_frames[next] >> 20),
+    };
+    memcpy(&packet[8 + count * sizeof(sniffer_frame_t)], &frame, sizeof(frame));
+    next = (next + 1) & (SNIFFER_CAPTURE_SIZE - 1);
+    count++;
+  }
+
+  uint32_t now_us = time_us_32();
+  packet[0] = SNIFFER_PACKET_ID;
+  packet[1] = count;
+  for (int i = 0; i < 4; i++) packet[4 + i] = (uint8_t)(now_us >> (i * 8));
+
+  if (tud_hid_n_report(instance, 0, packet, sizeof(packet))) tail = next;
+}
+
+/**
+ * @brief Task function for the keyboard sniffer.
+ * This prints every frame captured by the DMA since it was last called, and streams them to the
+ * host over the vendor interface.  The frame DMA channel's write address shows how far the capture
+ * has progressed, and as the time of each frame is always written before the frame itself, any
+ * frame found here already has its time captured.
+ *
+ * @note This function should be called periodically in the main loop, or within a task scheduler.
+ *       The capture buffers hold SNIFFER_CAPTURE_SIZE frames, so frames are only lost if this falls
+ *       that far behind.
+ */
+void keyboard_sniffer_task(void) {
+  static uint32_t tail = 0;
+  if (sniffer_frame_chan < 0) return;
+
+  uint32_t write_addr = dma_hw->ch[sniffer_frame_chan].write_addr;
+  uint32_t head = (write_addr - (uint32_t)(uintptr_t)sniffer_frames) / sizeof(sniffer_frames[0]);
+
+  sniffer_stream_frames(head);
+
+  while (tail != head) {
+    sniffer_print_frame(sniffer_times[tail], sniffer_frames[tail]);
+    tail = (tail + 1) & (SNIFFER_CAPTURE_SIZE - 1);
+  }
+}
+
+/**
+ * @brief Configures a DMA channel to capture one word per frame into a capture buffer.
+ * Each channel transfers a single word each time it is triggered, paced by the PIO RX FIFO, and then
+ * triggers the other channel.  The write address is never reset, so the ring wrapping walks it
+ * through the capture buffer.
+ *
+ * Both channels are paced by the same RX DREQ, but as each is only triggered by the other one
+ * completing, only one is ever armed, so they strictly alternate rather than competing for it.  The
+ * time channel reads the timer, which leaves the frame in the FIFO and the DREQ asserted, so the
+ * frame channel runs immediately after it and pops the frame.  If several frames are waiting, each
+ * takes its time as it is popped, a few cycles apart, rather than the time it arrived.
+ *
+ * @param chan     The DMA channel to configure.
+ * @param chain_to The DMA channel to trigger once this transfer completes.
+ * @param buffer   The capture buffer to write to.
+ * @param source   The register to read from.
+ */
+static void sniffer_dma_configure(uint chan, uint chain_to, uint32_t *buffer,
+                                  const volatile uint32_t *source) {
+  dma_channel_config dma_config = dma_channel_get_default_config(chan);
+  channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&dma_config, false);
+  channel_config_set_write_increment(&dma_config, true);
+  channel_config_set_ring(&dma_config, true, SNIFFER_CAPTURE_RING_BITS);
+  channel_config_set_dreq(&dma_config, pio_get_dreq(sniffer_pio, sniffer_sm, false));
+  channel_config_set_chain_to(&dma_config, chain_to);
+  dma_channel_configure(chan, &dma_config, buffer, source, 1, false);
+}
+
+/**
+ * @brief Initializes the passive AT/PS2 Keyboard sniffer.
+ * The sniffer PIO program only ever listens to the bus, so this can be attached to the CLK and DATA
+ * lines between a Keyboard and another Host without affecting either.  Captured frames are moved
+ * out of the PIO by a pair of chained DMA channels, with no IRQ handler involved:
+ * - The first channel copies the current timer value to `sniffer_times` as soon as a frame is
+ *   waiting in the RX FIFO, so each frame is timestamped within a few cycles of arrival.
+ * - The second channel then pops the frame itself into `sniffer_frames`, and re-arms the first.
+ *
+ * The time channel is always the one left armed between frames, so each time and frame pair share
+ * the same index.
+ *
+ * @param data_pin The GPIO pin number for the data line.  The clock line is data_pin + 1.
+ */
+void keyboard_sniffer_setup(uint data_pin) {
+  sniffer_pio = find_available_pio(&keyboard_sniffer_program);
+  if (sniffer_pio == NULL) {
+    printf("[ERR] No PIO available for Keyboard Sniffer Program\n");
+    return;
+  }
+
+  sniffer_sm = (uint)pio_claim_unused_sm(sniffer_pio, true);
+  sniffer_offset = pio_add_program(sniffer_pio, &keyboard_sniffer_program);
+
+  sniffer_time_chan = dma_claim_unused_channel(true);
+  sniffer_frame_chan = dma_claim_unused_channel(true);
+  sniffer_dma_configure((uint)sniffer_time_chan, (uint)sniffer_frame_chan, sniffer_times,
+                        &timer_hw->timerawl);
+  sniffer_dma_configure((uint)sniffer_frame_chan, (uint)sniffer_time_chan, sniffer_frames,
+                        &sniffer_pio->rxf[sniffer_sm]);
+  dma_channel_start((uint)sniffer_time_chan);
+
+  // Run the State Machine at 1MHz, which gives 1us resolution for telling the Host holding CLK LOW
+  // apart from the Keyboard clocking out a bit.
+  float clock_div = (float)clock_get_hz(clk_sys) / 1000000;
+  keyboard_sniffer_program_init(sniffer_pio, sniffer_sm, sniffer_offset, data_pin, clock_div);
+
+  printf("[INFO] PIO%d SM%d Sniffer program loaded at offset %d with clock divider of %.2f\n",
+         (sniffer_pio == pio0 ? 0 : 1), sniffer_sm, sniffer_offset, clock_div);
+  printf("[INFO] Sniffer frames captured using DMA channels %d and %d\n", sniffer_time_chan,
+         sniffer_frame_chan);
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYBOARD_SNIFFER_H
+#define KEYBOARD_SNIFFER_H
+
+#include "pico/stdlib.h"
+
+// Number of frames held by the DMA capture buffers.  This must be a power of 2.
+#define SNIFFER_CAPTURE_SIZE 256
+
+// Size of each packet sent to the host on the vendor interface.
+#define SNIFFER_PACKET_SIZE 64
+
+// First byte of each Sniffer packet.  Event Stamp packets start with 0x80, and Firmware Update
+// replies always echo a command below 0x80.
+#define SNIFFER_PACKET_ID 0x81
+
+// Number of frames carried in each packet, after the 8 byte header.
+#define SNIFFER_FRAMES_PER_PACKET 9
+
+// Each frame as sent to the host, 6 bytes, little endian.  The frame holds the 12 bits sampled by
+// the PIO program, with bit 11 set for Host to Keyboard frames:
+// - Keyboard to Host: [0] start bit, [1..8] data, [9] parity, [10] stop bit
+// - Host to Keyboard: [0..7] data, [8] parity, [9] stop bit, [10] set if the Keyboard didn't ACK
+typedef struct __attribute__((packed)) {
+  uint32_t time_us;  // Time the frame was received, from time_us_32()
+  uint16_t frame;    // Raw frame bits, as above
+} sniffer_frame_t;
+
+void keyboard_sniffer_setup(uint data_pin);
+void keyboard_sniffer_task(void);
+
+#endif /* KEYBOARD_SNIFFER_H */
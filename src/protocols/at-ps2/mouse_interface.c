@@ -21,14 +21,28 @@
 #include "mouse_interface.h"
 
 #include <math.h>
+#include <string.h>
 
 #include "bsp/board.h"
 #include "common_interface.h"
 #include "hardware/clocks.h"
+#include "flood_guard.h"
 #include "hid_interface.h"
 #include "interface.pio.h"
 #include "led_helper.h"
 #include "pio_helper.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+
+#ifdef CONVERTER_TIMELINE
+#include "timeline.h"
+#endif
+#ifdef CONVERTER_EVENT_STAMPS
+#include "event_stamps.h"
+#endif
+#ifdef CONVERTER_LOADGEN
+#include "loadgen.h"
+#endif
 
 uint mouse_sm = 0;
 uint mouse_offset = 0;
@@ -44,6 +58,10 @@ static enum {
   INIT_DETECT_MOUSE_TYPE,
   INIT_SET_CONFIG,
   INITIALISED,
+#ifdef CONVERTER_PORT_DETECT
+  PORT_MISMATCH,     // A keyboard has been identified, so the port is being handed over
+  PORT_UNSUPPORTED,  // No driver could take the port, so it is idle until a new device connects
+#endif
 } mouse_state = UNINITIALISED;
 
 typedef enum {
@@ -63,6 +81,64 @@ typedef enum {
 
 typedef enum { X_POS, Y_POS, Z_POS } mousepos_index;
 
+// Frames received from the mouse are captured by the IRQ handler into this queue, along with their
+// time of arrival, and are then validated, assembled into packets and reported from
+// mouse_interface_task().  This keeps the IRQ handler short and bounded, and ensures the USB stack
+// is only ever driven from task context.  The queue size must be a power of 2.
+#define MOUSE_QUEUE_SIZE 32
+
+// If the gap between two bytes of the same packet exceeds this, the packet is discarded and the
+// later byte is treated as the start of a new packet.
+#define MOUSE_PACKET_GAP_US 10000
+
+// Most movement held on each axis while USB is busy.  Movement beyond this is stale by the time it
+// could be sent, so it is dropped rather than replayed to the host.
+#define MOUSE_MOTION_LIMIT 1024
+
+typedef struct {
+  uint32_t time_us;  // Time the frame was received
+  uint16_t frame;    // Raw frame, including start, parity and stop bits
+  bool gap;          // Frames were dropped immediately before this one, as the queue was full
+} mouse_frame_t;
+
+static mouse_frame_t mouse_queue[MOUSE_QUEUE_SIZE];
+static volatile uint8_t mouse_queue_head = 0;       // Only written by the IRQ handler
+static volatile uint8_t mouse_queue_tail = 0;       // Only written by mouse_interface_task()
+static volatile uint32_t mouse_queue_overruns = 0;  // Frames dropped as the queue was full
+static bool mouse_queue_gap = false;                // Only accessed by the IRQ handler
+#ifdef CONVERTER_LOADGEN
+static volatile uint8_t mouse_queue_high_water = 0;  // Most frames queued at once
+#endif
+#ifdef CONVERTER_OVERSAMPLE
+static pio_vote_stats_t mouse_vote_stats = {0};
+#endif
+
+// Mouse movement, either for a single packet or merged from several packets with the same buttons.
+typedef struct {
+  uint8_t buttons[5];
+  int16_t pos[3];
+  uint32_t time_us;  // Arrival time of the first packet within this movement
+#ifdef CONVERTER_EVENT_STAMPS
+  uint32_t decode_us;  // Time the first packet within this movement was decoded
+#endif
+  bool valid;
+} mouse_motion_t;
+
+static uint8_t mouse_max_packets = 0;       // Number of bytes in each packet, once initialised
+static uint8_t mouse_packet_index = 0;      // Index of the next byte within the current packet
+static uint8_t mouse_resync_count = 0;      // Consecutive misaligned frames since a valid one
+static uint32_t mouse_resync_us = 0;        // Time of the last resynchronisation
+static uint32_t mouse_packet_last_us = 0;   // Arrival time of the previous byte of the packet
+static mouse_motion_t mouse_packet = {0};   // Last complete packet, not yet merged
+static mouse_motion_t mouse_pending = {0};  // Merged movement awaiting submission to USB
+static mouse_motion_t mouse_held = {0};     // Movement with new buttons, held behind mouse_pending
+static flood_guard_t mouse_guard;           // Flood protection for the Mouse port
+static pio_resync_t mouse_resync;           // Resynchronisation of the Mouse port
+static float mouse_clock_div;               // Clock divider of the interface program
+#ifdef CONVERTER_PORT_DETECT
+static bool mouse_id_requested = false;  // Whether Read ID has been sent since the Self Test
+#endif
+
 /**
  * @brief Command Handler function to issue commands to the attached AT/PS2 Mouse.
  * This function is responsible for handling commands to be sent to the AT/PS2 Mouse. It takes a
@@ -72,7 +148,7 @@ typedef enum { X_POS, Y_POS, Z_POS } mousepos_index;
  *
  * @param data_byte The command byte to be sent to the AT/PS2 Mouse.
  */
-static void mouse_command_handler(uint8_t data_byte) {
+static void __not_in_flash_func(mouse_command_handler)(uint8_t data_byte) {
   uint16_t data_with_parity = (uint16_t)(data_byte + (interface_parity_table[data_byte] << 8));
   pio_sm_put(mouse_pio, mouse_sm, data_with_parity);
 }
@@ -88,7 +164,7 @@ static void mouse_command_handler(uint8_t data_byte) {
  *
  * @return The calculated XY movement as an int8_t value.
  */
-int8_t get_xy_movement(uint8_t pos, int sign_bit) {
+int8_t __not_in_flash_func(get_xy_movement)(uint8_t pos, int sign_bit) {
   int16_t new_pos = pos;
   if (new_pos && sign_bit) {
     new_pos -= 0x100;
@@ -107,7 +183,7 @@ int8_t get_xy_movement(uint8_t pos, int sign_bit) {
  *
  * @return The Z-axis movement as a signed 8-bit integer.
  */
-int8_t get_z_movement(uint8_t pos) {
+int8_t __not_in_flash_func(get_z_movement)(uint8_t pos) {
   int8_t z_pos = pos & 0xF;
   if (pos) {
     z_pos -= 8;
@@ -120,17 +196,17 @@ int8_t get_z_movement(uint8_t pos) {
  * @brief Process the mouse event data.
  * This function is responsible for processing mouse events and updating the mouse state
  * accordingly. It handles various stages of mouse initialisation, including self-test, mouse type
- * detection, and configuration.  If the mouse is initialised, it processes the mouse data and sends
- * it to the HID interface.
+ * detection, and configuration.  If the mouse is initialised, it assembles the mouse data into
+ * packets, leaving each complete packet in `mouse_packet` to be merged and reported by
+ * mouse_interface_task().
  *
  * @param data_byte The data byte received from the mouse.
+ * @param time_us   The time at which the data byte was received.
  *
- * @note Unlike the keyboard interface, the mouse interface does not utilise a ring buffer, and
- * instead sends data directly to the HID interface.
+ * @note This is only called from task context, never from the IRQ handler.
  */
-void mouse_event_processor(uint8_t data_byte) {
+void __not_in_flash_func(mouse_event_processor)(uint8_t data_byte, uint32_t time_us) {
   static uint8_t mouse_type_detect_sequence = 0;
-  static uint8_t mouse_max_packets = 0;
 
   switch (mouse_state) {
     case UNINITIALISED:
@@ -139,6 +215,9 @@ void mouse_event_processor(uint8_t data_byte) {
           printf("[INFO] Mouse Self Test Passed\n");
           printf("[INFO] Detecting Mouse Type\n");
           mouse_id = 0xFF;  // Reset Mouse ID
+#ifdef CONVERTER_PORT_DETECT
+          mouse_id_requested = false;
+#endif
           mouse_state = INIT_AWAIT_ID;
           break;
         default:
@@ -165,6 +244,9 @@ void mouse_event_processor(uint8_t data_byte) {
           printf("[INFO] Mouse Self Test Passed\n");
           printf("[INFO] Detecting Mouse Type\n");
           mouse_id = 0xFF;  // Reset Mouse ID
+#ifdef CONVERTER_PORT_DETECT
+          mouse_id_requested = false;
+#endif
           mouse_state = INIT_AWAIT_ID;
           break;
         default:
@@ -212,6 +294,13 @@ void mouse_event_processor(uint8_t data_byte) {
           mouse_command_handler(0xE8);
           break;
         default:
+#ifdef CONVERTER_PORT_DETECT
+          if (interface_role_from_id(data_byte) == INTERFACE_ROLE_KEYBOARD) {
+            printf("[DBG] Keyboard ID (0x%02X) read from the Mouse port\n", data_byte);
+            mouse_state = PORT_MISMATCH;
+            break;
+          }
+#endif
           printf("[ERR] Unknown Mouse Type (0x%02X), Asking again to Reset...\n", data_byte);
           mouse_state = INIT_AWAIT_ACK;
           mouse_command_handler(0xFF);
@@ -276,6 +365,7 @@ void mouse_event_processor(uint8_t data_byte) {
         static uint8_t mouse_config_sequence = 0;
         if (mouse_config_sequence == sizeof(config_sequence) / sizeof(config_sequence[0])) {
           mouse_config_sequence = 0;
+          mouse_packet_index = 0;
           mouse_state = INITIALISED;
           printf("[INFO] Mouse Initialisation Complete\n");
         } else {
@@ -289,8 +379,23 @@ void mouse_event_processor(uint8_t data_byte) {
       static uint8_t buttons[5] = {0, 0, 0, 0, 0};
       static uint8_t parameters[4] = {0, 0, 0, 0};
       static int8_t pos[3] = {0, 0, 0};
-      static int8_t data_loop = 0;
-      switch (data_loop) {
+      static uint32_t packet_time_us = 0;
+
+      // The bytes of a packet are sent back to back, so a long gap means we've lost sync.
+      if (mouse_packet_index > 0 && time_us - mouse_packet_last_us > MOUSE_PACKET_GAP_US) {
+        printf("[DBG] Incomplete Mouse Packet Discarded\n");
+        mouse_packet_index = 0;
+      }
+      // Bit 3 is always set in the first byte of a packet, so anything else can't be the start of
+      // one.  Skipping these finds the start of the next packet after a misaligned frame.
+      if (mouse_packet_index == 0 && !(data_byte & 0x08)) {
+        printf("[DBG] Mouse Packet out of sync, byte discarded\n");
+        break;
+      }
+      if (mouse_packet_index == 0) packet_time_us = time_us;
+      mouse_packet_last_us = time_us;
+
+      switch (mouse_packet_index) {
         case 0:
           // Read in Button Data, as well as X and Y Overflow Data
           buttons[BUTTON_LEFT] = data_byte & 0x01;           // Left Button
@@ -331,69 +436,353 @@ void mouse_event_processor(uint8_t data_byte) {
           }
           break;
       }
-      // Increment Loop Counter, but reset if we reach 3.
-      data_loop++;
+      // Increment Packet Index, but reset once we have a complete packet.
+      mouse_packet_index++;
 
-      // If we have processed all packets, then we can handle the mouse report.
-      if (data_loop >= mouse_max_packets) {
-        data_loop = 0;
-        handle_mouse_report(buttons, pos);
+      // If we have processed all bytes of the packet, then hand it over to be reported.
+      if (mouse_packet_index >= mouse_max_packets) {
+        mouse_packet_index = 0;
+        memcpy(mouse_packet.buttons, buttons, sizeof(buttons));
+        for (int i = 0; i < 3; i++) mouse_packet.pos[i] = pos[i];
+        mouse_packet.time_us = packet_time_us;
+#ifdef CONVERTER_EVENT_STAMPS
+        mouse_packet.decode_us = time_us_32();
+#endif
+        mouse_packet.valid = true;
       }
-  }
-#ifdef CONVERTER_LEDS
-  converter.state.mouse_ready = mouse_state == INITIALISED ? 1 : 0;
-  update_converter_status();
+      break;
+
+#ifdef CONVERTER_PORT_DETECT
+    // Nothing is processed while the port is handed over, or left idle.  A device connected to an
+    // idle port announces itself with a Self Test result, so we reset it to identify it again.
+    case PORT_MISMATCH:
+      break;
+    case PORT_UNSUPPORTED:
+      if (data_byte == 0xAA) {
+        printf("[DBG] Device connected, Asking it to Reset\n");
+        mouse_state = INIT_AWAIT_ACK;
+        mouse_command_handler(0xFF);
+      }
+      break;
 #endif
+  }
+  converter_set_state(CONVERTER_MOUSE_READY, mouse_state == INITIALISED);
 }
 
 /**
- * @brief IRQ Event Handler used to read data from the AT/PS2 Mouse.
- * This function is responsible for handling the interrupt request (IRQ) event that occurs when data
- * is received from the AT/PS2 Mouse.
- * - It extracts the start bit, parity bit, stop bit, and data byte from the received data.
- * - It then performs validation checks on the start bit, parity bit, and stop bit.
- * - If any of the validation checks fail, error messages are printed and appropriate actions are
- * taken.
- * - If all the validation checks pass, the data byte is processed by the mouse_event_processor()
- * function.
+ * @brief Validates a frame received from the AT/PS2 Mouse and processes the data byte.
+ * This function extracts the start bit, parity bit, stop bit, and data byte from the received frame
+ * and performs validation checks on them.
+ * - If the parity check fails, the mouse is asked to resend the byte.
+ * - If the start or stop bit checks fail, the state machine is restarted and the mouse is reset.
+ * - Otherwise, the data byte is processed by the mouse_event_processor() function.
+ *
+ * @param entry The frame and its time of arrival, as captured by the IRQ handler.
  */
-void mouse_input_event_handler() {
-  io_ro_32 data_cast = mouse_pio->rxf[mouse_sm] >> 21;
-  uint16_t data = (uint16_t)data_cast;
+static void __not_in_flash_func(mouse_frame_processor)(const mouse_frame_t *entry) {
+  uint16_t data = entry->frame;
+
+  // Frames were lost just before this one, so whatever packet we were assembling is incomplete.
+  if (entry->gap) mouse_packet_index = 0;
 
   // Extract the Start Bit, Parity Bit and Stop Bit.
   uint8_t start_bit = data & 0x1;
   uint8_t parity_bit = (data >> 9) & 0x1;
   uint8_t stop_bit = (data >> 10) & 0x1;
-  uint8_t data_byte = (uint8_t)((data_cast >> 1) & 0xFF);
+  uint8_t data_byte = (uint8_t)((data >> 1) & 0xFF);
   uint8_t parity_bit_check = interface_parity_table[data_byte];
 
   if (start_bit != 0 || parity_bit != parity_bit_check || stop_bit != 1) {
+    converter_report_error();
+    if (!flood_guard_error(&mouse_guard)) return;  // Too many errors, so the port is inhibited.
     if (start_bit != 0) printf("[ERR] Start Bit Validation Failed: start_bit=%i\n", start_bit);
     if (stop_bit != 1) printf("[ERR] Stop Bit Validation Failed: stop_bit=%i\n", stop_bit);
     if (parity_bit != parity_bit_check) {
       printf("[ERR] Parity Bit Validation Failed: expected=%i, actual=%i\n", parity_bit_check,
              parity_bit);
+      // Resend makes the Mouse repeat the last byte it sent.  If frames are already queued behind
+      // this one, the Mouse has moved on, and a Resend would only duplicate the last of them, so
+      // the packet this byte belonged to is dropped instead.
+      if (mouse_queue_tail != mouse_queue_head || !pio_sm_is_rx_fifo_empty(mouse_pio, mouse_sm)) {
+        printf("[DBG] Mouse has sent more since, so the packet is dropped without a Resend\n");
+        mouse_packet_index = 0;
+        return;
+      }
       mouse_command_handler(0xFE);  // Request Resend
       return;
     }
-    // We should reset/restart the State Machine
+    // A bad Start or Stop Bit means we started reading part way through a frame.  Once
+    // initialised, we realign with the next frame once the line is idle, keeping any frames
+    // already queued, and drop the packet this byte belonged to.  A lost movement packet is
+    // harmless, whereas asking for it again can't be told apart from a new packet.  Frames are
+    // processed some time after they were captured, so any others captured before the last
+    // resynchronisation are just as misaligned, and are dropped without counting again.
+    if (mouse_resync_count && (int32_t)(entry->time_us - mouse_resync_us) < 0) return;
+    if (mouse_state == INITIALISED && ++mouse_resync_count < CONVERTER_RESYNC_LIMIT) {
+      printf("[DBG] Resynchronising Mouse (%u/%u)\n", mouse_resync_count, CONVERTER_RESYNC_LIMIT);
+      pio_resync(&mouse_resync, mouse_offset);
+      mouse_resync_us = time_us_32();
+      mouse_packet_index = 0;
+      return;
+    }
+    // Otherwise we should reset/restart the State Machine
+    mouse_resync_count = 0;
     mouse_state = UNINITIALISED;
     mouse_id = 0xFF;
     pio_restart(mouse_pio, mouse_sm, mouse_offset);
   }
+  mouse_resync_count = 0;
 
-  mouse_event_processor(data_byte);
+  mouse_event_processor(data_byte, entry->time_us);
 }
 
+/**
+ * @brief Submits the pending mouse movement to the HID interface.
+ * Movement is accumulated at a higher resolution than a HID report can carry, so if the pending
+ * movement exceeds the report range, the remainder is kept pending for the next report.  Once it
+ * has been fully submitted, any held movement becomes pending.
+ *
+ * @return true if the pending movement has been fully submitted (or there was none), false if some
+ *         movement remains pending.
+ */
+static bool __not_in_flash_func(mouse_pending_flush)(void) {
+  if (!mouse_pending.valid) return true;
+
+  int8_t pos[3];
+  for (int i = 0; i < 3; i++) {
+    int16_t val = mouse_pending.pos[i];
+    pos[i] = (int8_t)((val > 127) ? 127 : (val < -127) ? -127 : val);
+  }
+
+  if (!handle_mouse_report(mouse_pending.buttons, pos)) return false;
+#ifdef CONVERTER_EVENT_STAMPS
+  uint8_t buttons = 0;
+  for (int i = 0; i < 5; i++) buttons |= (uint8_t)(mouse_pending.buttons[i] << i);
+  event_stamps_record(EVENT_STAMP_MOUSE, mouse_pending.time_us, mouse_pending.decode_us, buttons,
+                      buttons != 0, true);
+#endif
+#ifdef CONVERTER_LOADGEN
+  loadgen_record_report(LOADGEN_MOUSE, mouse_pending.time_us, true);
+#endif
+
+  bool remaining = false;
+  for (int i = 0; i < 3; i++) {
+    mouse_pending.pos[i] -= pos[i];
+    if (mouse_pending.pos[i]) remaining = true;
+  }
+  mouse_pending.valid = remaining;
+  if (!remaining && mouse_held.valid) {
+    mouse_pending = mouse_held;
+    mouse_held.valid = false;
+  }
+  return !remaining;
+}
+
+/**
+ * @brief Adds the movement of the last complete packet to a merged movement.
+ * The sum is limited to MOUSE_MOTION_LIMIT on each axis, deliberately dropping movement which has
+ * built up while USB was busy.
+ *
+ * @param motion The merged movement to add the packet to.
+ */
+static void __not_in_flash_func(mouse_motion_add)(mouse_motion_t *motion) {
+  for (int i = 0; i < 3; i++) {
+    int32_t val = motion->pos[i] + mouse_packet.pos[i];
+    motion->pos[i] = (int16_t)((val > MOUSE_MOTION_LIMIT)    ? MOUSE_MOTION_LIMIT
+                               : (val < -MOUSE_MOTION_LIMIT) ? -MOUSE_MOTION_LIMIT
+                                                             : val);
+  }
+}
+
+/**
+ * @brief Merges the last complete packet into the pending mouse movement.
+ * Consecutive packets with the same button state are merged by summing their movement, in the order
+ * they were received.  A packet with a different button state can't be merged into the pending
+ * movement, so while that is waiting for USB, it is held behind it, and further packets with the
+ * same buttons are merged into the held movement instead.  This way no button transition is ever
+ * merged away, and the queue keeps draining while USB is busy.  The held movement becomes pending
+ * once the pending movement has been submitted.
+ *
+ * If the Mouse report isn't enumerated, there is no host to send the movement to, and it would be
+ * stale by the time there is, so any pending movement is dropped instead.
+ *
+ * @return true if the packet was merged, false if it must wait as the buttons have changed again
+ *         while a held movement is waiting.
+ */
+static bool __not_in_flash_func(mouse_packet_merge)(void) {
+  if (!tud_mounted() || usb_hid_report_instance(REPORT_ID_MOUSE) == USB_HID_INSTANCE_NONE) {
+    mouse_pending.valid = false;
+    mouse_held.valid = false;
+  }
+
+  if (mouse_pending.valid && !mouse_held.valid &&
+      memcmp(mouse_pending.buttons, mouse_packet.buttons, sizeof(mouse_packet.buttons)) != 0 &&
+      !mouse_pending_flush()) {
+    mouse_held = mouse_packet;
+  } else if (mouse_held.valid) {
+    if (memcmp(mouse_held.buttons, mouse_packet.buttons, sizeof(mouse_packet.buttons)) != 0) {
+      return false;
+    }
+    mouse_motion_add(&mouse_held);
+  } else if (mouse_pending.valid) {
+    mouse_motion_add(&mouse_pending);
+  } else {
+    mouse_pending = mouse_packet;
+  }
+  mouse_packet.valid = false;
+  return true;
+}
+
+/**
+ * @brief Captures a frame into the mouse queue, along with its time of arrival.
+ * If frames were dropped as the queue was full, the next frame queued is marked, so the packet they
+ * belonged to is only discarded once the frames queued ahead of them have been processed.
+ *
+ * @param frame The raw frame, including start, parity and stop bits.
+ *
+ * @return true if the frame was queued, false if the queue was full and the frame was dropped.
+ */
+static inline bool __not_in_flash_func(mouse_queue_push)(uint16_t frame) {
+  uint8_t head = mouse_queue_head;
+  uint8_t next = (head + 1) & (MOUSE_QUEUE_SIZE - 1);
+
+  if (next == mouse_queue_tail) {
+    mouse_queue_overruns++;
+    mouse_queue_gap = true;
+    return false;
+  }
+
+  mouse_queue[head].time_us = time_us_32();
+  mouse_queue[head].frame = frame;
+  mouse_queue[head].gap = mouse_queue_gap;
+  mouse_queue_gap = false;
+  __compiler_memory_barrier();  // Ensure the entry is written before it is published.
+  mouse_queue_head = next;
+#ifdef CONVERTER_LOADGEN
+  uint8_t used = (uint8_t)((next - mouse_queue_tail) & (MOUSE_QUEUE_SIZE - 1));
+  if (used > mouse_queue_high_water) mouse_queue_high_water = used;
+#endif
+  return true;
+}
+
+/**
+ * @brief IRQ Event Handler used to read data from the AT/PS2 Mouse.
+ * This function is responsible for handling the interrupt request (IRQ) event that occurs when data
+ * is received from the AT/PS2 Mouse.  It only captures the raw frame and its time of arrival into
+ * the mouse queue, leaving validation and processing to mouse_interface_task().  If the queue is
+ * full, the frame is dropped and counted as an overrun.
+ */
+void __isr __not_in_flash_func(mouse_input_event_handler)() {
+#ifdef CONVERTER_OVERSAMPLE
+  uint16_t frame = interface_oversample_decode(mouse_pio->rxf[mouse_sm], &mouse_vote_stats);
+#else
+  uint16_t frame = (uint16_t)(mouse_pio->rxf[mouse_sm] >> 21);
+#endif
+  if (!flood_guard_byte(&mouse_guard)) return;  // Drop anything received once inhibited.
+  if (!mouse_queue_push(frame)) return;
+#ifdef CONVERTER_TIMELINE
+  timeline_record(TIMELINE_MOUSE_RX, (uint8_t)(frame >> 1));
+#endif
+}
+
+#ifdef CONVERTER_LOADGEN
+/**
+ * @brief Injects a data byte as though it had just been received from the Mouse.
+ * The byte is framed with valid start, parity and stop bits and captured into the mouse queue,
+ * exactly as the IRQ handler would, so it passes through validation, packet assembly and merging
+ * as a real frame.  Bytes are only accepted once the Mouse has been initialised.
+ *
+ * @param data_byte The data byte to inject.
+ *
+ * @return true if the byte was queued, false if the Mouse isn't initialised or the queue is full.
+ *
+ * @note This must be called at the same IRQ priority as the PIO, so it can't interleave with the
+ *       IRQ handler.
+ */
+bool __not_in_flash_func(mouse_interface_inject)(uint8_t data_byte) {
+  if (mouse_state != INITIALISED) return false;
+  return mouse_queue_push(
+      (uint16_t)((data_byte << 1) | (interface_parity_table[data_byte] << 9) | (1u << 10)));
+}
+
+/**
+ * @brief Returns the number of bytes in each packet sent by the Mouse.
+ *
+ * @return 3 for a standard Mouse, 4 for an IntelliMouse, or 0 if the Mouse isn't initialised.
+ */
+uint8_t mouse_interface_packet_size(void) {
+  return mouse_state == INITIALISED ? mouse_max_packets : 0;
+}
+
+/**
+ * @brief Returns the most frames held in the mouse queue at once, and starts measuring again.
+ *
+ * @return The most frames held since the last call.
+ */
+uint8_t mouse_interface_take_high_water(void) {
+  uint8_t value = mouse_queue_high_water;
+  mouse_queue_high_water = 0;
+  return value;
+}
+#endif
+
 /**
  * @brief Task function for the mouse interface.
- * This function simply assists with the initialisation of the mouse interface and handles timeout
- * events.
+ * This function processes any frames captured by the IRQ handler, merges complete packets and
+ * submits the resulting movement to the HID interface.  It also assists with the initialisation of
+ * the mouse interface and handles timeout events.
  *
  * @note This function should be called periodically in the main loop, or within a task scheduler.
  */
 void mouse_interface_task() {
+  static uint32_t overruns_seen = 0;
+#ifdef CONVERTER_OVERSAMPLE
+  pio_vote_report("Mouse", &mouse_vote_stats);
+#endif
+  if (flood_guard_task(&mouse_guard)) {
+    // The port is inhibited, so discard anything captured before it was, and re-initialise the
+    // mouse once it has been released.
+    mouse_queue_tail = mouse_queue_head;
+    mouse_packet_index = 0;
+    mouse_resync_count = 0;
+    mouse_state = UNINITIALISED;
+    mouse_id = 0xFF;
+    converter_set_state(CONVERTER_MOUSE_READY, false);
+    return;
+  }
+  pio_resync_task(&mouse_resync);  // Resume the interface once the line is idle after a resync.
+
+  uint32_t overruns = mouse_queue_overruns;
+  if (overruns != overruns_seen) {
+    // Frames have been lost, so whatever packet we were assembling is no longer complete.
+    printf("[ERR] Mouse Queue Overrun, %lu frames dropped\n",
+           (unsigned long)(overruns - overruns_seen));
+    converter_report_error();
+    overruns_seen = overruns;
+  }
+
+  // Drain the queue.  Movement is merged while USB is busy, so this only stops early if the buttons
+  // have changed twice since the last report was accepted.
+  while (!mouse_packet.valid || mouse_packet_merge()) {
+    uint8_t tail = mouse_queue_tail;
+    if (tail == mouse_queue_head || flood_guard_tripped(&mouse_guard)) break;
+    mouse_frame_t entry = mouse_queue[tail];
+    mouse_queue_tail = (tail + 1) & (MOUSE_QUEUE_SIZE - 1);
+    mouse_frame_processor(&entry);
+  }
+  mouse_pending_flush();
+
+#ifdef CONVERTER_PORT_DETECT
+  if (mouse_state == PORT_MISMATCH) {
+    // Hand the port over to the Keyboard driver, or leave it idle if it can't be taken.
+    if (!interface_port_mismatch(INTERFACE_ROLE_MOUSE, INTERFACE_ROLE_KEYBOARD)) {
+      mouse_state = PORT_UNSUPPORTED;
+    }
+    return;
+  }
+  if (mouse_state == PORT_UNSUPPORTED) return;
+#endif
+
   // Mouse Interface Initialisation helper
   // Here we handle Timeout events. If we don't receive responses from an attached Mouse with a set
   // period of time for any condition other than INITIALISED, we will then perform an appropriate
@@ -407,6 +796,17 @@ void mouse_interface_task() {
       if (gpio_get(mouse_data_pin + 1) == 1) {
         // Only perform checks if the clock is HIGH
         detect_stall_count++;
+#ifdef CONVERTER_PORT_DETECT
+        if (mouse_state == INIT_AWAIT_ID && mouse_id == 0xFF && !mouse_id_requested &&
+            detect_stall_count > 2) {
+          // A mouse sends its ID straight after the Self Test, but a keyboard only sends its ID
+          // when asked, so ask before giving up on the device.
+          printf("[DBG] No Mouse ID received, requesting Device ID\n");
+          mouse_id_requested = true;
+          detect_stall_count = 0;
+          mouse_command_handler(0xF2);
+        }
+#endif
         if (detect_stall_count > 5) {
           // Reset Mouse as we have not received any data for 1 second.
           printf("[ERR] Mouse Interface Timeout.  Resetting Mouse...\n");
@@ -420,19 +820,49 @@ void mouse_interface_task() {
         detect_stall_count =
             0;  // Reset the detect_stall_count as we are waiting for the clock to go HIGH.
       }
-#ifdef CONVERTER_LEDS
-      converter.state.mouse_ready = mouse_state == INITIALISED ? 1 : 0;
-      update_converter_status();
-#endif
+      converter_set_state(CONVERTER_MOUSE_READY, mouse_state == INITIALISED);
     }
   }
 }
 
+#ifdef CONVERTER_PORT_DETECT
+/**
+ * @brief Moves the mouse interface to the port with the given data pin.
+ * The interface program is restarted on the new pins, discarding anything received on the old
+ * port, and any device already attached to the new port is asked to reset, so it can be identified
+ * and initialised from scratch.
+ *
+ * @param data_pin The data pin of the port to move to.
+ */
+static void mouse_interface_bind(uint data_pin) {
+  uint32_t irq_state = save_and_disable_interrupts();
+  pio_sm_set_enabled(mouse_pio, mouse_sm, false);
+  INTERFACE_PROGRAM_INIT(mouse_pio, mouse_sm, mouse_offset, data_pin, mouse_clock_div);
+  mouse_queue_tail = mouse_queue_head;
+  restore_interrupts(irq_state);
+
+  mouse_data_pin = data_pin;
+  mouse_packet_index = 0;
+  mouse_resync_count = 0;
+  mouse_state = UNINITIALISED;
+  mouse_id = 0xFF;
+  flood_guard_init(&mouse_guard, "Mouse", mouse_pio, mouse_sm, mouse_offset, data_pin + 1,
+                   CONVERTER_FLOOD_MOUSE_BYTES);
+  pio_resync_init(&mouse_resync, mouse_pio, mouse_sm, data_pin + 1);
+  converter_set_state(CONVERTER_MOUSE_READY, false);
+  printf("[INFO] Mouse Interface moved to GPIO %u\n", data_pin);
+  if (gpio_get(data_pin + 1) == 1) {
+    mouse_state = INIT_AWAIT_ACK;
+    mouse_command_handler(0xFF);
+  }
+}
+#endif
+
 /**
  * @brief Initializes the AT/PS2 PIO interface for the mouse.
  * This function initializes the AT/PS2 PIO interface for the mouse by performing the following
  * steps:
- * 1. Resets the converter status if CONVERTER_LEDS is defined.
+ * 1. Resets the converter status.
  * 2. Finds an available PIO to use for the keyboard interface program.
  * 3. Claims the PIO and loads the program.
  * 4. Sets up the IRQ for the PIO state machine.
@@ -444,10 +874,7 @@ void mouse_interface_task() {
  * @param data_pin The data pin to be used for the mouse interface.
  */
 void mouse_interface_setup(uint data_pin) {
-#ifdef CONVERTER_LEDS
-  converter.state.mouse_ready = 0;
-  update_converter_status();  // Always reset Converter Status here
-#endif
+  converter_set_state(CONVERTER_MOUSE_READY, false);  // Always reset Converter Status here
   // First we need to determine which PIO to use for the Mouse Interface.
   // To do this, we check each PIO to see if there is space to load the Mouse Interface program.
   // If there is space, we claim the PIO and load the program.  If not, we continue to the next PIO.
@@ -455,7 +882,7 @@ void mouse_interface_setup(uint data_pin) {
   // `find_available_pio` is a helper function that will check both PIO0 and PIO1 for space.
   // If the function returns NULL, then there is no space available, and we should return.
   // mouse_state = INITIALISED;
-  mouse_pio = find_available_pio(&pio_interface_program);
+  mouse_pio = find_available_pio(&INTERFACE_PROGRAM);
   if (mouse_pio == NULL) {
     printf("[ERR] No PIO available for Mouse Interface Program\n");
     return;
@@ -463,7 +890,7 @@ void mouse_interface_setup(uint data_pin) {
 
   // Now we can claim the PIO and load the program.
   mouse_sm = (uint)pio_claim_unused_sm(mouse_pio, true);
-  mouse_offset = pio_add_program(mouse_pio, &pio_interface_program);
+  mouse_offset = pio_add_program(mouse_pio, &INTERFACE_PROGRAM);
   mouse_data_pin = data_pin;
 
   // Define the IRQ for the PIO State Machine.
@@ -494,7 +921,14 @@ void mouse_interface_setup(uint data_pin) {
          cycles_per_clock, clock_div);
   printf("[INFO] Effective SM Clock Speed: %.2fkHz\n", (float)(rp_clock_khz / clock_div));
 
-  pio_interface_program_init(mouse_pio, mouse_sm, mouse_offset, data_pin, clock_div);
+  INTERFACE_PROGRAM_INIT(mouse_pio, mouse_sm, mouse_offset, data_pin, clock_div);
+  mouse_clock_div = clock_div;
+  flood_guard_init(&mouse_guard, "Mouse", mouse_pio, mouse_sm, mouse_offset, data_pin + 1,
+                   CONVERTER_FLOOD_MOUSE_BYTES);
+  pio_resync_init(&mouse_resync, mouse_pio, mouse_sm, data_pin + 1);
+#ifdef CONVERTER_PORT_DETECT
+  interface_port_register(INTERFACE_ROLE_MOUSE, data_pin, mouse_interface_bind);
+#endif
 
   irq_set_exclusive_handler(pio_irq, &mouse_input_event_handler);
   irq_set_enabled(pio_irq, true);
@@ -21,9 +21,16 @@
 #ifndef MOUSE_INTERFACE_H
 #define MOUSE_INTERFACE_H
 
+#include "config.h"
 #include "pico/stdlib.h"
 
 void mouse_interface_setup(uint data_pin);
 void mouse_interface_task();
 
+#ifdef CONVERTER_LOADGEN
+bool mouse_interface_inject(uint8_t data_byte);
+uint8_t mouse_interface_packet_size(void);
+uint8_t mouse_interface_take_high_water(void);
+#endif
+
 #endif /* MOUSE_INTERFACE_H */
@@ -23,23 +23,45 @@
 #include <math.h>
 
 #include "bsp/board.h"
+#include "flood_guard.h"
 #include "hardware/clocks.h"
 #include "keyboard_interface.pio.h"
+#include "hid_interface.h"
 #include "led_helper.h"
 #include "pio_helper.h"
 #include "ringbuf.h"
 #include "scancode.h"
 
+#ifdef CONVERTER_TIMELINE
+#include "timeline.h"
+#endif
+
 uint keyboard_sm = 0;
 uint keyboard_offset = 0;
 PIO keyboard_pio = pio1;
 uint keyboard_data_pin;
 
+// Select the receiver variant of the XT Interface PIO program.
+#ifdef CONVERTER_OVERSAMPLE
+#define INTERFACE_PROGRAM keyboard_interface_oversample_program
+#define INTERFACE_PROGRAM_INIT keyboard_interface_oversample_program_init
+#define INTERFACE_PROGRAM_CHECK keyboard_interface_oversample_offset_check
+static pio_vote_stats_t keyboard_vote_stats = {0};
+#else
+#define INTERFACE_PROGRAM keyboard_interface_program
+#define INTERFACE_PROGRAM_INIT keyboard_interface_program_init
+#define INTERFACE_PROGRAM_CHECK keyboard_interface_offset_check
+#endif
+
 static enum {
   UNINITIALISED,
   INITIALISED,
 } keyboard_state = UNINITIALISED;
 
+static uint8_t keyboard_resync_count = 0;  // Consecutive misaligned frames since a valid one.
+static flood_guard_t keyboard_guard;       // Flood protection for the Keyboard port.
+static pio_resync_t keyboard_resync;       // Resynchronisation of the Keyboard port.
+
 /**
  * @brief Processes keyboard event data.
  * This function is responsible for processing keyboard events and updating the keyboard state
@@ -48,25 +70,26 @@ static enum {
  *
  * @param data_byte The data byte received from the keyboard.
  */
-static void keyboard_event_processor(uint8_t data_byte) {
+static void __not_in_flash_func(keyboard_event_processor)(uint8_t data_byte) {
   switch (keyboard_state) {
     case UNINITIALISED:
       if (data_byte == 0xAA) {
         printf("[DBG] Keyboard Self-Test Passed\n");
         keyboard_state = INITIALISED;
       } else {
+        if (!flood_guard_error(&keyboard_guard)) break;  // The port is inhibited, don't restart.
         printf("[ERR] Keyboard Self-Test Failed: 0x%02X\n", data_byte);
         keyboard_state = UNINITIALISED;
         pio_restart(keyboard_pio, keyboard_sm, keyboard_offset);
       }
       break;
     case INITIALISED:
+#ifdef CONVERTER_TIMELINE
+      timeline_record(TIMELINE_KEYBOARD_RX, data_byte);
+#endif
       if (!ringbuf_is_full()) ringbuf_put(data_byte);
   }
-#ifdef CONVERTER_LEDS
-  converter.state.kb_ready = keyboard_state == INITIALISED ? 1 : 0;
-  update_converter_status();
-#endif
+  converter_set_state(CONVERTER_KB_READY, keyboard_state == INITIALISED);
 }
 
 /**
@@ -86,8 +109,17 @@ static void keyboard_event_processor(uint8_t data_byte) {
  * as a single bit or a double bit.  This is handled transparently by the PIO code itself to filter
  * out the double start bit.
  */
-static void __isr keyboard_input_event_handler() {
+static void __isr __not_in_flash_func(keyboard_input_event_handler)() {
+#ifdef CONVERTER_OVERSAMPLE
+  // 25 bits are shifted in from the top of the ISR, so the Start Bit lands in bit 7, followed by
+  // three samples of each Data Bit to be majority voted.
+  uint32_t rxf = keyboard_pio->rxf[keyboard_sm];
+  io_ro_32 data_cast =
+      ((rxf >> 7) & 0x1) | (uint32_t)(pio_majority_vote(rxf >> 8, 8, &keyboard_vote_stats) << 1);
+#else
   io_ro_32 data_cast = keyboard_pio->rxf[keyboard_sm] >> 23;
+#endif
+  if (!flood_guard_byte(&keyboard_guard)) return;  // Drop anything received once inhibited.
   uint16_t data = (uint16_t)data_cast;
 
   // Extract the Start Bit.
@@ -95,14 +127,51 @@ static void __isr keyboard_input_event_handler() {
   uint8_t data_byte = (uint8_t)((data_cast >> 1) & 0xFF);
 
   if (start_bit != 1) {
+    converter_report_error();
+    if (!flood_guard_error(&keyboard_guard)) return;  // Too many errors, so the port is inhibited.
     printf("[ERR] Start Bit Validation Failed: start_bit=%i\n", start_bit);
+    // A bad Start Bit means we started reading part way through a frame.  Once initialised, we
+    // realign by returning to wait for the next Start Bit once the line is idle, skipping the Soft
+    // Reset at the start of the program and keeping any frames already queued.
+    if (keyboard_state == INITIALISED && ++keyboard_resync_count < CONVERTER_RESYNC_LIMIT) {
+      printf("[DBG] Resynchronising Keyboard (%u/%u)\n", keyboard_resync_count,
+             CONVERTER_RESYNC_LIMIT);
+      pio_resync(&keyboard_resync, keyboard_offset + INTERFACE_PROGRAM_CHECK);
+      return;
+    }
+    // Otherwise we should reset/restart the State Machine, which also resets the Keyboard.
+    keyboard_resync_count = 0;
     keyboard_state = UNINITIALISED;
     pio_restart(keyboard_pio, keyboard_sm, keyboard_offset);
     return;
   }
+  keyboard_resync_count = 0;
   keyboard_event_processor(data_byte);
 }
 
+#ifdef CONVERTER_LOADGEN
+/**
+ * @brief Injects a data byte as though it had just been received from the Keyboard.
+ * The byte is handed to keyboard_event_processor(), exactly as the IRQ handler would once a frame
+ * has been validated, so it passes through the rest of the pipeline as a real scancode.  Bytes are
+ * only accepted once the Keyboard has been initialised, so they can't be mistaken for the
+ * self-test result.
+ *
+ * @param data_byte The data byte to inject.
+ *
+ * @return true if the byte was queued, false if the Keyboard isn't initialised or the ring buffer
+ *         is full.
+ *
+ * @note This must be called at the same IRQ priority as the PIO, so it can't interleave with the
+ *       IRQ handler.
+ */
+bool __not_in_flash_func(keyboard_interface_inject)(uint8_t data_byte) {
+  if (keyboard_state != INITIALISED || ringbuf_is_full()) return false;
+  keyboard_event_processor(data_byte);
+  return true;
+}
+#endif
+
 /**
  * @brief Task function for the keyboard interface.
  * This function handles the initialization and communication with the keyboard.
@@ -115,17 +184,40 @@ static void __isr keyboard_input_event_handler() {
 void keyboard_interface_task() {
   static uint8_t detect_stall_count = 0;
 
+#ifdef CONVERTER_OVERSAMPLE
+  pio_vote_report("Keyboard", &keyboard_vote_stats);
+#endif
+
+  if (flood_guard_task(&keyboard_guard)) {
+    // The port is inhibited.  Releasing it restarts the program, which also resets the keyboard.
+    keyboard_resync_count = 0;
+    keyboard_state = UNINITIALISED;
+    detect_stall_count = 0;
+    converter_set_state(CONVERTER_KB_READY, false);
+    return;
+  }
+  pio_resync_task(&keyboard_resync);  // Resume the interface once the line is idle after a resync.
+
   if (keyboard_state == INITIALISED) {
     detect_stall_count = 0;  // Reset the stall count if we're initialised.
-    if (!ringbuf_is_empty() && tud_hid_ready()) {
-      // We only process the ringbuffer if it's not empty and we're ready to send a HID report.
-      // If we don't check for HID ready, we can end up having reports fail to send.
+    if (!ringbuf_is_empty() && hid_keyboard_ready()) {
+      // We only process the ringbuffer if it's not empty and we're ready to send a HID report,
+      // or the host is away.  If we don't check for HID ready, we can end up having reports fail
+      // to send.
 
       // Previously we would pause all interrupts while reading the ringbuffer.
       // However, this didn't seem to do anything other than cause latency for keypresses.
       // We may need to revisit this if we encounter issues.
       int c = ringbuf_get();  // Pull from the ringbuffer
-      if (c != -1) process_scancode((uint8_t)c);
+      if (c != -1) {
+#ifdef CONVERTER_REPORT_TRACE
+        hid_decode_begin();  // Time the decode, up to the report being built.
+#endif
+        process_scancode((uint8_t)c);
+#ifdef CONVERTER_REPORT_TRACE
+        hid_decode_end();
+#endif
+      }
     }
   } else {
     // This portion helps with initialisation of the keyboard.
@@ -152,10 +244,7 @@ void keyboard_interface_task() {
         printf("[DBG] Awaiting keyboard detection. Please ensure a keyboard is connected.\n");
         detect_stall_count = 0;
       }
-#ifdef CONVERTER_LEDS
-      converter.state.kb_ready = keyboard_state == INITIALISED ? 1 : 0;
-      update_converter_status();
-#endif
+      converter_set_state(CONVERTER_KB_READY, keyboard_state == INITIALISED);
     }
   }
 }
@@ -164,7 +253,7 @@ void keyboard_interface_task() {
  * @brief Initializes the XT PIO interface for the keyboard.
  * This function initializes the XT PIO interface for the keyboard by performing the following
  * steps:
- * 1. Resets the converter status if CONVERTER_LEDS is defined.
+ * 1. Resets the converter status.
  * 2. Resets the ring buffer.
  * 3. Finds an available PIO to use for the keyboard interface program.
  * 4. Claims the PIO and loads the program.
@@ -177,10 +266,7 @@ void keyboard_interface_task() {
  * @param data_pin The data pin to be used for the keyboard interface.
  */
 void keyboard_interface_setup(uint data_pin) {
-#ifdef CONVERTER_LEDS
-  converter.state.kb_ready = 0;
-  update_converter_status();  // Always reset Converter Status here
-#endif
+  converter_set_state(CONVERTER_KB_READY, false);  // Always reset Converter Status here
 
   ringbuf_reset();  // Even though Ringbuf is statically initialised, we reset it here to be sure
                     // it's empty.
@@ -192,7 +278,7 @@ void keyboard_interface_setup(uint data_pin) {
   // `find_available_pio` is a helper function that will check both PIO0 and PIO1 for space.
   // If the function returns NULL, then there is no space available, and we should return.
 
-  keyboard_pio = find_available_pio(&keyboard_interface_program);
+  keyboard_pio = find_available_pio(&INTERFACE_PROGRAM);
   if (keyboard_pio == NULL) {
     printf("[ERR] No PIO available for Keyboard Interface Program\n");
     return;
@@ -200,7 +286,7 @@ void keyboard_interface_setup(uint data_pin) {
 
   // Now we can claim the PIO and load the program.
   keyboard_sm = (uint)pio_claim_unused_sm(keyboard_pio, true);
-  keyboard_offset = pio_add_program(keyboard_pio, &keyboard_interface_program);
+  keyboard_offset = pio_add_program(keyboard_pio, &INTERFACE_PROGRAM);
   keyboard_data_pin = data_pin;
 
   // Define the IRQ for the PIO State Machine.
@@ -234,7 +320,10 @@ void keyboard_interface_setup(uint data_pin) {
          cycles_per_clock, clock_div);
   printf("[INFO] Effective SM Clock Speed: %.2fkHz\n", (float)(rp_clock_khz / clock_div));
 
-  keyboard_interface_program_init(keyboard_pio, keyboard_sm, keyboard_offset, data_pin, clock_div);
+  INTERFACE_PROGRAM_INIT(keyboard_pio, keyboard_sm, keyboard_offset, data_pin, clock_div);
+  flood_guard_init(&keyboard_guard, "Keyboard", keyboard_pio, keyboard_sm, keyboard_offset,
+                   data_pin + 1, CONVERTER_FLOOD_KEYBOARD_BYTES);
+  pio_resync_init(&keyboard_resync, keyboard_pio, keyboard_sm, data_pin + 1);
 
   irq_set_exclusive_handler(pio_irq, &keyboard_input_event_handler);
   irq_set_enabled(pio_irq, true);
@@ -21,9 +21,14 @@
 #ifndef KEYBOARD_INTERFACE_H
 #define KEYBOARD_INTERFACE_H
 
+#include "config.h"
 #include "pico/stdlib.h"
 
 void keyboard_interface_setup(uint data_pin);
 void keyboard_interface_task();
 
+#ifdef CONVERTER_LOADGEN
+bool keyboard_interface_inject(uint8_t data_byte);
+#endif
+
 #endif /* KEYBOARD_INTERFACE_H */
@@ -23,35 +23,7 @@
 #include <stdio.h>
 
 #include "hid_interface.h"
-
-// clang-format off
-// Some XT Keyboards use EO-prefixed codes for some keys.
-// This macro translates these codes.
-#define SWITCH_E0_CODE(code) \
-  (code == 0x37 ? 0x54 : /* Print Screen */ \
-  (code == 0x46 ? 0x55 : /* Pause / Break */ \
-  (code == 0x5E ? 0x70 : /* Power */ \
-  (code == 0x5F ? 0x79 : /* Sleep */ \
-  (code == 0x63 ? 0x7B : /* Wake */ \
-  (code == 0x52 ? 0x71 : /* Insert */ \
-  (code == 0x47 ? 0x74 : /* Home */ \
-  (code == 0x49 ? 0x77 : /* Page Up */ \
-  (code == 0x35 ? 0x7F : /* Keypad Slash */ \
-  (code == 0x53 ? 0x72 : /* Delete */ \
-  (code == 0x4F ? 0x75 : /* End */ \
-  (code == 0x51 ? 0x78 : /* Page Down */ \
-  (code == 0x48 ? 0x60 : /* Up Arrow */ \
-  (code == 0x1C ? 0x6F : /* Keypad Enter */ \
-  (code == 0x5B ? 0x5A : /* Left GUI */ \
-  (code == 0x38 ? 0x7C : /* Right Alt */ \
-  (code == 0x5C ? 0x5B : /* Right GUI */ \
-  (code == 0x5D ? 0x5C : /* Application */ \
-  (code == 0x1D ? 0x7A : /* Right Control */ \
-  (code == 0x4B ? 0x61 : /* Left Arrow */ \
-  (code == 0x50 ? 0x62 : /* Down Arrow */ \
-  (code == 0x4D ? 0x63 : /* Right Arrow */ \
-  0))))))))))))))))))))))
-// clang-format on
+#include "keymaps.h"
 
 /**
  * @brief Process Keyboard Input (Scancode Set 1) Data
@@ -62,13 +34,17 @@
  * value received.  Any value above 0x80 is considered a key release event and processed as value
  * `code & 0x7F`.
  *
+ * E0-prefixed codes are reported on the extended plane of the keymap (see KEYMAP_E0), so they never
+ * share a position with an unprefixed code.  The Pause key reports at the same position as E0 46,
+ * which is sent for it instead when Control is held (Break).
+ *
  * @param code The keycode to process.
  *
  * @note handle_keyboard_report() function directly handles translation from scancode to HID report.
  * It used a lookup against the relevant keyboard configuration to determine the associated Keycode,
  * and then sends the relevant HID report to the host.
  */
-void process_scancode(uint8_t code) {
+void __not_in_flash_func(process_scancode)(uint8_t code) {
   // clang-format off
   static enum {
     INIT,
@@ -110,9 +86,9 @@ void process_scancode(uint8_t code) {
         default:
           state = INIT;
           if (code < 0x80) {
-            handle_keyboard_report(SWITCH_E0_CODE(code), true);
+            handle_keyboard_report(KEYMAP_E0(code), true);
           } else {
-            handle_keyboard_report(SWITCH_E0_CODE((code & 0x7F)), false);
+            handle_keyboard_report(KEYMAP_E0(code & 0x7F), false);
           }
       }
       break;
@@ -134,7 +110,7 @@ void process_scancode(uint8_t code) {
     case E1_1D:  // E1-prefixed 1D
       switch (code) {
         case 0x45:
-          handle_keyboard_report(0x55, true);
+          handle_keyboard_report(KEYMAP_E0(0x46), true);
           state = INIT;
           break;
         default:
@@ -146,7 +122,7 @@ void process_scancode(uint8_t code) {
     case E1_9D:  // E1-prefixed 9D
       switch (code) {
         case 0xC5:
-          handle_keyboard_report(0x55, false);
+          handle_keyboard_report(KEYMAP_E0(0x46), false);
           state = INIT;
           break;
         default:
@@ -23,6 +23,36 @@
 
 #include <stdint.h>
 
+#include "hid_keycodes.h"
+#include "keymaps.h"
+
+// clang-format off
+// Multimedia and ACPI keys are E0-prefixed, and send the same codes on any Set 1 keyboard which
+// has them, so keymaps include these positions mapped directly to their Consumer/System usages.
+#define SCANCODE_MEDIA_KEYS \
+  [KEYMAP_E0(0x10)] = KC_MPRV, /* Previous Track */ \
+  [KEYMAP_E0(0x19)] = KC_MNXT, /* Next Track */ \
+  [KEYMAP_E0(0x20)] = KC_MUTE, /* Mute */ \
+  [KEYMAP_E0(0x21)] = KC_CALC, /* Calculator */ \
+  [KEYMAP_E0(0x22)] = KC_PLPS, /* Play/Pause */ \
+  [KEYMAP_E0(0x24)] = KC_MSTP, /* Stop */ \
+  [KEYMAP_E0(0x2E)] = KC_VOLD, /* Volume Down */ \
+  [KEYMAP_E0(0x30)] = KC_VOLU, /* Volume Up */ \
+  [KEYMAP_E0(0x32)] = KC_WHME, /* WWW Home */ \
+  [KEYMAP_E0(0x5E)] = KC_PWR,  /* ACPI Power */ \
+  [KEYMAP_E0(0x5F)] = KC_SLEP, /* ACPI Sleep */ \
+  [KEYMAP_E0(0x63)] = KC_WAKE, /* ACPI Wake */ \
+  [KEYMAP_E0(0x65)] = KC_WSCH, /* WWW Search */ \
+  [KEYMAP_E0(0x66)] = KC_WBKM, /* WWW Favourites */ \
+  [KEYMAP_E0(0x67)] = KC_WREF, /* WWW Refresh */ \
+  [KEYMAP_E0(0x68)] = KC_WSTP, /* WWW Stop */ \
+  [KEYMAP_E0(0x69)] = KC_WFWD, /* WWW Forward */ \
+  [KEYMAP_E0(0x6A)] = KC_WBAK, /* WWW Back */ \
+  [KEYMAP_E0(0x6B)] = KC_MYCM, /* My Computer */ \
+  [KEYMAP_E0(0x6C)] = KC_MAIL, /* Email */ \
+  [KEYMAP_E0(0x6D)] = KC_CCNF  /* Media Select */
+// clang-format on
+
 void process_scancode(uint8_t code);
 
 #endif /* SCANCODES_H */
@@ -23,54 +23,7 @@
 #include <stdio.h>
 
 #include "hid_interface.h"
-
-// clang-format off
-// AT Keyboards use EO-prefixed codes for some keys.
-// This macro translates these codes.
-#define SWITCH_E0_CODE(code) \
-  (code == 0x11 ? 0x0F : /* Right Alt */ \
-  (code == 0x14 ? 0x19 : /* Right Ctrl */ \
-  (code == 0x1F ? 0x17 : /* Left GUI */ \
-  (code == 0x27 ? 0x1F : /* Right GUI */ \
-  (code == 0x2F ? 0x27 : /* Menu/App */ \
-  (code == 0x4A ? 0x60 : /* Keypad / */ \
-  (code == 0x5A ? 0x62 : /* Keypad Enter */ \
-  (code == 0x69 ? 0x5C : /* End */ \
-  (code == 0x6B ? 0x53 : /* Cursor Left */ \
-  (code == 0x6C ? 0x2F : /* Home */ \
-  (code == 0x70 ? 0x39 : /* Insert */ \
-  (code == 0x71 ? 0x37 : /* Delete */ \
-  (code == 0x72 ? 0x3F : /* Cursor Down */ \
-  (code == 0x74 ? 0x47 : /* Cursor Right */ \
-  (code == 0x75 ? 0x4F : /* Cursor Up */ \
-  (code == 0x77 ? 0x00 : /* Unicomp New Model M Pause/Break key fix */ \
-  (code == 0x7A ? 0x56 : /* Page Down */ \
-  (code == 0x7D ? 0x5E : /* Page Up */ \
-  (code == 0x7C ? 0x7F : /* Print Screen */ \
-  (code == 0x7E ? 0x00 : /* Control'd Pause */ \
-  (code == 0x21 ? 0x65 : /* Volume Down */ \
-  (code == 0x32 ? 0x6E : /* Volume Up */ \
-  (code == 0x23 ? 0x6F : /* Mute */ \
-  (code == 0x10 ? 0x08 : /* WWW Search -> F13 */ \
-  (code == 0x18 ? 0x10 : /* WWW Favourites -> F14 */ \
-  (code == 0x20 ? 0x18 : /* WWW Refresh -> F15 */ \
-  (code == 0x28 ? 0x20 : /* WWW Stop -> F16 */ \
-  (code == 0x30 ? 0x28 : /* WWW Forward -> F17 */ \
-  (code == 0x38 ? 0x30 : /* WWW Back -> F18 */ \
-  (code == 0x3A ? 0x38 : /* WWW Home -> F19 */ \
-  (code == 0x40 ? 0x40 : /* My Computer -> F20 */ \
-  (code == 0x48 ? 0x48 : /* Email -> F21 */ \
-  (code == 0x2B ? 0x50 : /* Calculator -> F22 */ \
-  (code == 0x34 ? 0x08 : /* Play/Pause -> F13 */ \
-  (code == 0x3B ? 0x10 : /* Stop -> F14 */ \
-  (code == 0x15 ? 0x18 : /* Previous Track -> F15 */ \
-  (code == 0x4D ? 0x20 : /* Next Track -> F16 */ \
-  (code == 0x50 ? 0x28 : /* Media Select -> F17 */ \
-  (code == 0x5E ? 0x50 : /* ACPI Wake -> F22 */ \
-  (code == 0x3F ? 0x57 : /* ACPI Sleep -> F23 */ \
-  (code == 0x37 ? 0x5F : /* ACPI Power -> F24 */ \
-  0)))))))))))))))))))))))))))))))))))))))))
-// clang-format on
+#include "keymaps.h"
 
 /**
  * @brief Process Keyboard Input (Scancode Set 2) Data
@@ -80,13 +33,18 @@
  * to the host.  Key press and release events are also determined here depending on the scancode
  * sequence relating to any received Break code (0xF0).
  *
+ * E0-prefixed codes are reported on the extended plane of the keymap (see KEYMAP_E0), so they never
+ * share a position with an unprefixed code.  F7 (0x83) and SysReq (0x84) are the only codes above
+ * 0x7F, and are reported at the unused positions 0x02 and 0x7F.  The Pause key reports at the same
+ * position as E0 77, which some keyboards send for it instead.
+ *
  * @param code The keycode to process.
  *
  * @note handle_keyboard_report() function directly handles translation from scancode to HID report.
  * It used a lookup against the relevant keyboard configuration to determine the associated Keycode,
  * and then sends the relevant HID report to the host.
  */
-void process_scancode(uint8_t code) {
+void __not_in_flash_func(process_scancode)(uint8_t code) {
   // clang-format off
   static enum {
     INIT,
@@ -161,7 +119,7 @@ void process_scancode(uint8_t code) {
         default:
           state = INIT;
           if (code < 0x80) {
-            handle_keyboard_report(SWITCH_E0_CODE(code), true);
+            handle_keyboard_report(KEYMAP_E0(code), true);
           } else {
             printf("[DBG] !E0! (0x%02X)\n", code);
           }
@@ -176,9 +134,9 @@ void process_scancode(uint8_t code) {
           break;
         default:
           if (code < 0x80) {
-            handle_keyboard_report(SWITCH_E0_CODE(code), false);
+            handle_keyboard_report(KEYMAP_E0(code), false);
           } else {
-            printf("!E0_F0! (0x%02X)\n", code);
+            printf("[DBG] !E0_F0! (0x%02X)\n", code);
           }
       }
       break;
@@ -201,7 +159,7 @@ void process_scancode(uint8_t code) {
       state = INIT;
       switch (code) {
         case 0x77:  // Pause
-          handle_keyboard_report(SWITCH_E0_CODE(code), true);
+          handle_keyboard_report(KEYMAP_E0(code), true);
           break;
         default:
           printf("[DBG] !E1_14! (0x%02X)\n", code);
@@ -234,7 +192,7 @@ void process_scancode(uint8_t code) {
       state = INIT;
       switch (code) {
         case 0x77:  // Pause
-          handle_keyboard_report(SWITCH_E0_CODE(code), false);
+          handle_keyboard_report(KEYMAP_E0(code), false);
           break;
         default:
           printf("[DBG] !E1_F0_14_F0! (0x%02X)\n", code);
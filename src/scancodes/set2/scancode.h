@@ -23,6 +23,36 @@
 
 #include <stdint.h>
 
+#include "hid_keycodes.h"
+#include "keymaps.h"
+
+// clang-format off
+// Multimedia and ACPI keys are E0-prefixed, and send the same codes on any Set 2 keyboard which
+// has them, so keymaps include these positions mapped directly to their Consumer/System usages.
+#define SCANCODE_MEDIA_KEYS \
+  [KEYMAP_E0(0x10)] = KC_WSCH, /* WWW Search */ \
+  [KEYMAP_E0(0x15)] = KC_MPRV, /* Previous Track */ \
+  [KEYMAP_E0(0x18)] = KC_WBKM, /* WWW Favourites */ \
+  [KEYMAP_E0(0x20)] = KC_WREF, /* WWW Refresh */ \
+  [KEYMAP_E0(0x21)] = KC_VOLD, /* Volume Down */ \
+  [KEYMAP_E0(0x23)] = KC_MUTE, /* Mute */ \
+  [KEYMAP_E0(0x28)] = KC_WSTP, /* WWW Stop */ \
+  [KEYMAP_E0(0x2B)] = KC_CALC, /* Calculator */ \
+  [KEYMAP_E0(0x30)] = KC_WFWD, /* WWW Forward */ \
+  [KEYMAP_E0(0x32)] = KC_VOLU, /* Volume Up */ \
+  [KEYMAP_E0(0x34)] = KC_PLPS, /* Play/Pause */ \
+  [KEYMAP_E0(0x37)] = KC_PWR,  /* ACPI Power */ \
+  [KEYMAP_E0(0x38)] = KC_WBAK, /* WWW Back */ \
+  [KEYMAP_E0(0x3A)] = KC_WHME, /* WWW Home */ \
+  [KEYMAP_E0(0x3B)] = KC_MSTP, /* Stop */ \
+  [KEYMAP_E0(0x3F)] = KC_SLEP, /* ACPI Sleep */ \
+  [KEYMAP_E0(0x40)] = KC_MYCM, /* My Computer */ \
+  [KEYMAP_E0(0x48)] = KC_MAIL, /* Email */ \
+  [KEYMAP_E0(0x4D)] = KC_MNXT, /* Next Track */ \
+  [KEYMAP_E0(0x50)] = KC_CCNF, /* Media Select */ \
+  [KEYMAP_E0(0x5E)] = KC_WAKE  /* ACPI Wake */
+// clang-format on
+
 void process_scancode(uint8_t code);
 
 #endif /* SCANCODES_H */
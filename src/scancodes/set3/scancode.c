@@ -42,7 +42,7 @@
  * we assume that the keyboard has been configured to send make/break codes, and as such we don't
  * need to handle typematic mode, and will process release events from the Break code.
  */
-void process_scancode(uint8_t code) {
+void __not_in_flash_func(process_scancode)(uint8_t code) {
   // clang-format off
   static enum {
     INIT,
@@ -0,0 +1,54 @@
+# This file is part of RP2040 Keyboard Converter.
+#
+# Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+#
+# RP2040 Keyboard Converter is free software: you can redistribute it
+# and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation, either version 3 of
+# the License, or (at your option) any later version.
+#
+# RP2040 Keyboard Converter is distributed in the hope that it will be
+# useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+# of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with RP2040 Keyboard Converter.
+# If not, see <https://www.gnu.org/licenses/>.
+
+# Runs RUNNER against INPUT, writing its output to OUTPUT, and compares it to GOLDEN.
+# With UPDATE_GOLDEN set, GOLDEN is replaced with the output instead.
+
+execute_process(
+  COMMAND ${RUNNER} ${INPUT}
+  OUTPUT_FILE ${OUTPUT}
+  RESULT_VARIABLE RESULT
+)
+
+if(NOT RESULT EQUAL 0)
+  message(FATAL_ERROR "${RUNNER} failed (${RESULT}), see ${OUTPUT}")
+endif()
+
+if(UPDATE_GOLDEN)
+  file(COPY_FILE ${OUTPUT} ${GOLDEN})
+  message("Updated ${GOLDEN}")
+  return()
+endif()
+
+if(NOT EXISTS ${GOLDEN})
+  message(FATAL_ERROR "${GOLDEN} does not exist, configure with -DUPDATE_GOLDEN=ON to create it")
+endif()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E compare_files --ignore-eol ${GOLDEN} ${OUTPUT}
+  RESULT_VARIABLE DIFFERENT
+)
+
+if(DIFFERENT)
+  # Show where the output went wrong, if diff is available.
+  find_program(DIFF diff)
+  if(DIFF)
+    execute_process(COMMAND ${DIFF} -u ${GOLDEN} ${OUTPUT})
+  endif()
+  message(FATAL_ERROR "Output differs from ${GOLDEN}, see ${OUTPUT}")
+endif()
@@ -0,0 +1,122 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Feeds a stream of scancodes through the Keyboard's scancode decoder, keymap and HID path,
+// printing each HID report the host would receive.  The stream is a text file of hex bytes, one
+// event per line, with `#` lines echoed as comments.  Each line is echoed before it is decoded, so
+// the output reads as the input interleaved with the reports it produced, and is compared against a
+// golden file for the Keyboard.
+//
+// The host time spent in process_scancode() is measured across the stream, and reported on stderr
+// as a CTest measurement, so it is kept out of the output compared against the golden file.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "config.h"
+#include "hid_interface.h"
+#include "scancode.h"
+#include "sim.h"
+
+#define SCANCODE_TEST_EVENT_US 10000  // Virtual time between each line of the stream
+
+/**
+ * @brief Returns the host's monotonic clock, for timing the decoder.
+ *
+ * @return The time in nanoseconds.
+ */
+static uint64_t scancode_test_host_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <scancode stream>\n", argv[0]);
+    return 2;
+  }
+  FILE *stream = fopen(argv[1], "r");
+  if (!stream) {
+    perror(argv[1]);
+    return 2;
+  }
+
+  printf("# %s %s (%s %s)\n", KEYBOARD_MAKE, KEYBOARD_MODEL, KEYBOARD_PROTOCOL, KEYBOARD_CODESET);
+  hid_device_setup();
+  sim_usb_mount(true);
+
+  char line[256];
+  unsigned line_num = 0;
+  uint64_t decode_ns = 0;
+  unsigned decode_count = 0;
+  while (fgets(line, sizeof(line), stream)) {
+    line_num++;
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '#') {
+      printf("%s\n", line);
+      continue;
+    }
+
+    uint8_t codes[64];
+    uint count = 0;
+    char *pos = line;
+    while (*pos) {
+      if (isspace((unsigned char)*pos)) {
+        pos++;
+        continue;
+      }
+      char *end;
+      unsigned long code = strtoul(pos, &end, 16);
+      if (end == pos || code > 0xFF || count == sizeof(codes)) {
+        fprintf(stderr, "%s:%u: invalid scancode stream\n", argv[1], line_num);
+        return 2;
+      }
+      codes[count++] = (uint8_t)code;
+      pos = end;
+    }
+    if (!count) continue;
+
+    printf(">");
+    for (uint i = 0; i < count; i++) printf(" %02X", codes[i]);
+    printf("\n");
+    uint64_t start_ns = scancode_test_host_ns();
+    for (uint i = 0; i < count; i++) process_scancode(codes[i]);
+    decode_ns += scancode_test_host_ns() - start_ns;
+    decode_count += count;
+
+    sim_run_until(sim_time_us() + SCANCODE_TEST_EVENT_US);
+    tud_task();
+  }
+
+  fclose(stream);
+
+  // Host timings vary from run to run, so they are only reported to CTest, never in the output.
+  fprintf(stderr,
+          "<CTestMeasurement type=\"numeric/double\" name=\"scancodes\">%u</CTestMeasurement>\n",
+          decode_count);
+  fprintf(stderr,
+          "<CTestMeasurement type=\"numeric/double\" name=\"decode_ns_per_scancode\">%.1f"
+          "</CTestMeasurement>\n",
+          decode_count ? (double)decode_ns / decode_count : 0.0);
+  return 0;
+}
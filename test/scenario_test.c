@@ -0,0 +1,300 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Runs the whole converter, from main() down, against a scripted scenario in virtual time.  The
+// Keyboard's frames are raised through the PIO interrupt exactly as the State Machine would raise
+// them, and the scenario plays the part of the Keyboard and the USB host around it.  Everything
+// seen on the wire or by the host is logged with its virtual time, along with the converter's own
+// diagnostics, so a run can be compared against a golden file.
+//
+// Each line of a scenario is one command, and `#` lines are echoed as comments:
+//   wait <ms>           Let the converter run for a while.
+//   at <ms>             Let the converter run until the given time from power on.
+//   rx <frame>...       Frames from the Keyboard, one frame time apart.
+//   burst <frame>...    Frames from the Keyboard, all queued in the RX FIFO before the interrupt
+//                       is taken, as when it is held off.
+//   mouse rx|burst <frame>...
+//                       Frames from the Mouse, as rx and burst, when built with a Mouse.
+//   clk high|low        Level the Keyboard drives onto the CLK line.
+//   usb attach|detach   Attach or detach the host.
+//   usb suspend|resume  Suspend or resume the bus.
+//   usb poll <us>       Interval the host polls each endpoint at, or 0 for immediately.
+//   leds <hex>          Keyboard Lock LED output report from the host.
+// A frame is a hex byte, followed by /p for a bad Parity Bit or /s for a bad Start Bit.  The
+// Keyboard and the Mouse clock their frames in independently, so a command sending frames runs once
+// the device's earlier frames have all been received, while the other device may still be sending.
+// Any other command runs once the frames of both have all been received.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "sim.h"
+#include "usb_descriptors.h"
+
+#if !defined(_KEYBOARD_PROTOCOL_XT) || MOUSE_ENABLED
+#include "common_interface.h"
+#endif
+
+#define SCENARIO_LOOP_US 10     // Virtual time taken by each pass of the main loop
+#define SCENARIO_FRAME_US 1000  // Time taken to clock in each frame from the Keyboard
+
+int converter_main(void);
+
+// Frames waiting to be received from a device.
+typedef struct {
+  const char *name;
+  uint data_pin;
+  bool xt;  // Whether the frames are XT frames, rather than AT/PS2 frames
+  uint32_t frames[64];
+  uint count;
+  uint next;
+  bool burst;
+  uint64_t due_us;
+} scenario_stream_t;
+
+static FILE *scenario;
+static const char *scenario_name;
+static unsigned scenario_line = 0;
+static uint64_t scenario_resume_us = 0;  // Time the next command runs at
+static char scenario_command[256];       // Command waiting for its device's frames to be received
+static bool scenario_command_waiting = false;
+
+#ifdef _KEYBOARD_PROTOCOL_XT
+static scenario_stream_t keyboard_stream = {.name = "Keyboard", .data_pin = KEYBOARD_DATA_PIN,
+                                            .xt = true};
+#else
+static scenario_stream_t keyboard_stream = {.name = "Keyboard", .data_pin = KEYBOARD_DATA_PIN};
+#endif
+#if MOUSE_ENABLED
+static scenario_stream_t mouse_stream = {.name = "Mouse", .data_pin = MOUSE_DATA_PIN};
+#endif
+
+static void scenario_error(const char *message) {
+  fprintf(stderr, "%s:%u: %s\n", scenario_name, scenario_line, message);
+  exit(2);
+}
+
+/**
+ * @brief Encodes a frame as a device's interface program would push it to the RX FIFO.
+ *
+ * @param stream The device sending the frame.
+ * @param token  The frame, as a hex byte followed by any /p or /s error.
+ *
+ * @return The RX FIFO word.
+ */
+static uint32_t scenario_frame(const scenario_stream_t *stream, const char *token) {
+  char *end;
+  unsigned long data = strtoul(token, &end, 16);
+  if (end == token || data > 0xFF) scenario_error("invalid frame");
+  bool bad_parity = strcmp(end, "/p") == 0;
+  bool bad_start = strcmp(end, "/s") == 0;
+  if (*end && !bad_parity && !bad_start) scenario_error("invalid frame error");
+
+  if (stream->xt) {
+    // Start Bit (HIGH), then 8 Data Bits, shifted in from the top of the ISR.
+    if (bad_parity) scenario_error("XT frames have no Parity Bit");
+    uint32_t frame = (bad_start ? 0u : 1u) | (uint32_t)data << 1;
+    return frame << 23;
+  }
+#if !defined(_KEYBOARD_PROTOCOL_XT) || MOUSE_ENABLED
+  // Start Bit (LOW), 8 Data Bits, odd Parity Bit and Stop Bit (HIGH), shifted in from the top.
+  uint32_t parity = interface_parity_table[data] ^ (bad_parity ? 1u : 0u);
+  uint32_t frame = (bad_start ? 1u : 0u) | (uint32_t)data << 1 | parity << 9 | 1u << 10;
+  return frame << 21;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Queues the frames of an rx or burst command.
+ *
+ * @param stream The device sending the frames.
+ * @param args   The rest of the command line.
+ * @param burst  Whether the frames are all received together.
+ */
+static void scenario_queue_frames(scenario_stream_t *stream, char *args, bool burst) {
+  stream->count = stream->next = 0;
+  for (char *token = strtok(args, " \t"); token; token = strtok(NULL, " \t")) {
+    if (stream->count == count_of(stream->frames)) scenario_error("too many frames");
+    stream->frames[stream->count++] = scenario_frame(stream, token);
+  }
+  stream->burst = burst;
+  stream->due_us = sim_time_us() + SCENARIO_FRAME_US;
+}
+
+/**
+ * @brief Receives any frames from a device which have finished being clocked in.
+ *
+ * @param stream The device sending the frames.
+ */
+static void scenario_receive_frames(scenario_stream_t *stream) {
+  if (stream->next == stream->count || sim_time_us() < stream->due_us) return;
+
+  PIO pio;
+  uint sm;
+  if (!sim_pio_find(stream->data_pin, &pio, &sm)) scenario_error("no interface for the frames");
+  uint count = stream->burst ? stream->count - stream->next : 1;
+  for (uint i = 0; i < count; i++) {
+    uint32_t frame = stream->frames[stream->next + i];
+    if (stream->xt) {
+      sim_log("%s frame 0x%02X%s", stream->name, (frame >> 24) & 0xFF,
+              frame & (1u << 23) ? "" : " (bad start)");
+      continue;
+    }
+#if !defined(_KEYBOARD_PROTOCOL_XT) || MOUSE_ENABLED
+    uint data = (frame >> 22) & 0xFF;
+    bool bad_start = frame & (1u << 21);
+    bool bad_parity = ((frame >> 30) & 1) != interface_parity_table[data];
+    sim_log("%s frame 0x%02X%s%s", stream->name, data, bad_parity ? " (bad parity)" : "",
+            bad_start ? " (bad start)" : "");
+#endif
+  }
+  sim_pio_receive(pio, sm, &stream->frames[stream->next], count);
+  stream->next += count;
+  stream->due_us += SCENARIO_FRAME_US;
+}
+
+/**
+ * @brief Checks whether a device, or every device if none is given, has no frames left to receive.
+ *
+ * @param stream The device, or NULL for every device.
+ *
+ * @return true if there are no frames left to receive.
+ */
+static bool scenario_frames_received(const scenario_stream_t *stream) {
+#if MOUSE_ENABLED
+  if (!stream) {
+    return keyboard_stream.next == keyboard_stream.count &&
+           mouse_stream.next == mouse_stream.count;
+  }
+#endif
+  if (!stream) stream = &keyboard_stream;
+  return stream->next == stream->count;
+}
+
+/**
+ * @brief Runs the next command of the scenario once the frames it waits for have been received,
+ * ending the run once there are no commands left.
+ */
+static void scenario_run_command(void) {
+  if (!scenario_command_waiting) {
+    do {
+      if (!fgets(scenario_command, sizeof(scenario_command), scenario)) {
+        if (!scenario_frames_received(NULL)) return;
+        sim_log("End of scenario");
+        fflush(stdout);
+        exit(0);
+      }
+      scenario_line++;
+      scenario_command[strcspn(scenario_command, "\r\n")] = '\0';
+    } while (!scenario_command[0]);
+    scenario_command_waiting = true;
+  }
+
+  char line[sizeof(scenario_command)];
+  strcpy(line, scenario_command);
+  char *args = line;
+  while (*args && !isspace((unsigned char)*args)) args++;
+  if (*args) *args++ = '\0';
+  while (isspace((unsigned char)*args)) args++;
+
+  scenario_stream_t *stream = NULL;
+  if (strcmp(line, "rx") == 0 || strcmp(line, "burst") == 0) stream = &keyboard_stream;
+#if MOUSE_ENABLED
+  if (strcmp(line, "mouse") == 0) stream = &mouse_stream;
+#endif
+  if (!scenario_frames_received(stream)) return;
+  scenario_command_waiting = false;
+
+  if (line[0] == '#') {
+    printf("%s\n", scenario_command);
+    return;
+  }
+  sim_log("> %s", scenario_command);
+
+  if (strcmp(line, "wait") == 0) {
+    scenario_resume_us = sim_time_us() + (uint64_t)(atof(args) * 1000);
+  } else if (strcmp(line, "at") == 0) {
+    scenario_resume_us = (uint64_t)(atof(args) * 1000);
+  } else if (strcmp(line, "rx") == 0 || strcmp(line, "burst") == 0) {
+    scenario_queue_frames(&keyboard_stream, args, strcmp(line, "burst") == 0);
+#if MOUSE_ENABLED
+  } else if (strcmp(line, "mouse") == 0) {
+    char *frames = args + strcspn(args, " \t");
+    if (*frames) *frames++ = '\0';
+    if (strcmp(args, "rx") != 0 && strcmp(args, "burst") != 0) {
+      scenario_error("unknown mouse command");
+    }
+    scenario_queue_frames(&mouse_stream, frames, strcmp(args, "burst") == 0);
+#endif
+  } else if (strcmp(line, "clk") == 0) {
+    sim_gpio_set(KEYBOARD_DATA_PIN + 1, strcmp(args, "low") != 0);
+  } else if (strcmp(line, "usb") == 0) {
+    if (strcmp(args, "attach") == 0 || strcmp(args, "detach") == 0) {
+      sim_usb_mount(strcmp(args, "attach") == 0);
+    } else if (strcmp(args, "suspend") == 0 || strcmp(args, "resume") == 0) {
+      sim_usb_suspend(strcmp(args, "suspend") == 0);
+    } else if (strncmp(args, "poll ", 5) == 0) {
+      sim_usb_set_poll_us((uint32_t)atoi(args + 5));
+    } else {
+      scenario_error("unknown usb command");
+    }
+  } else if (strcmp(line, "leds") == 0) {
+    uint8_t leds = (uint8_t)strtoul(args, NULL, 16);
+    sim_usb_set_report(usb_hid_report_instance(REPORT_ID_KEYBOARD), REPORT_ID_KEYBOARD, &leds, 1);
+  } else {
+    scenario_error("unknown command");
+  }
+}
+
+/**
+ * @brief Moves virtual time on by one pass of the main loop, and plays the next step of the
+ * scenario once it is due.
+ */
+static void scenario_loop_hook(void) {
+  sim_run_until(sim_time_us() + SCENARIO_LOOP_US);
+  scenario_receive_frames(&keyboard_stream);
+#if MOUSE_ENABLED
+  scenario_receive_frames(&mouse_stream);
+#endif
+  if (sim_time_us() < scenario_resume_us) return;
+  scenario_run_command();
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <scenario>\n", argv[0]);
+    return 2;
+  }
+  scenario_name = argv[1];
+  scenario = fopen(scenario_name, "r");
+  if (!scenario) {
+    perror(scenario_name);
+    return 2;
+  }
+
+  // Output from the converter and the simulator is interleaved, so it must be written in order.
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  sim_set_loop_hook(scenario_loop_hook);
+  return converter_main();
+}
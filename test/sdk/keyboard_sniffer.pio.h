@@ -0,0 +1,37 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYBOARD_SNIFFER_PIO_H
+#define KEYBOARD_SNIFFER_PIO_H
+
+// Stands in for the header pioasm generates, recording which pins each State Machine is given.
+
+#include "sim_sdk.h"
+
+static const pio_program_t keyboard_sniffer_program = {
+    .instructions = NULL, .length = 28, .origin = -1};
+
+static inline void keyboard_sniffer_program_init(PIO pio, uint sm, uint offset,
+                                                 uint pin, float div) {
+  (void)div;
+  sim_pio_program_init(pio, sm, offset, pin);
+}
+
+#endif /* KEYBOARD_SNIFFER_PIO_H */
@@ -0,0 +1,46 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+// Controls for the virtual hardware behind sim_sdk.c, used by the test runners to drive the
+// converter.  Everything the virtual hardware does which the host would see, or which a device on
+// the wire would see, is printed as a [SIM] line stamped with the virtual time, so two runs of the
+// same scenario produce identical output.
+
+#include "sim_sdk.h"
+
+void sim_log(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+uint64_t sim_time_us(void);
+void sim_run_until(uint64_t time_us);
+void sim_set_loop_hook(void (*hook)(void));
+
+void sim_usb_mount(bool mounted);
+void sim_usb_suspend(bool suspended);
+void sim_usb_set_poll_us(uint32_t poll_us);
+void sim_usb_set_report(uint8_t instance, uint8_t report_id, const uint8_t *data, uint16_t len);
+
+void sim_gpio_set(uint gpio, bool level);
+bool sim_pio_find(uint pin, PIO *pio, uint *sm);
+uint sim_pio_receive(PIO pio, uint sm, const uint32_t *frames, uint count);
+
+#endif /* SIM_H */
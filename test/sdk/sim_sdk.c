@@ -0,0 +1,979 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include "sim.h"
+
+#define SIM_ALARMS 32
+#define SIM_HW_ALARMS 4
+#define SIM_GPIOS 30
+#define SIM_PIO_SMS 4
+#define SIM_PIO_INSTRUCTIONS 32
+#define SIM_PIO_FIFO_DEPTH 4
+#define SIM_DMA_CHANNELS 12
+#define SIM_HID_INSTANCES 4
+#define SIM_SYS_CLOCK_HZ 125000000u
+
+// Virtual clock
+static uint64_t sim_now_us = 0;
+static uint32_t sim_irq_disabled = 0;  // Nesting depth of save_and_disable_interrupts()
+static bool sim_in_irq = false;        // Set while an interrupt handler or alarm is running
+static uint64_t sim_event_seq = 0;     // Orders events due at the same time by when they were set
+
+static timer_hw_t sim_timer_hw;
+static systick_hw_t sim_systick_hw;
+timer_hw_t *timer_hw = &sim_timer_hw;
+systick_hw_t *systick_hw = &sim_systick_hw;
+
+// Alarms, repeating timers and hardware alarms
+typedef struct {
+  bool active;
+  alarm_id_t id;
+  uint64_t due_us;
+  uint64_t seq;
+  alarm_callback_t callback;
+  void *user_data;
+  repeating_timer_t *timer;  // Set for the alarm behind a repeating timer
+} sim_alarm_t;
+
+static sim_alarm_t sim_alarms[SIM_ALARMS];
+static alarm_id_t sim_next_alarm_id = 1;
+
+static struct {
+  bool claimed;
+  bool armed;
+  uint64_t due_us;
+  uint64_t seq;
+  hardware_alarm_callback_t callback;
+} sim_hw_alarms[SIM_HW_ALARMS];
+
+// Interrupts
+static irq_handler_t sim_irq_handlers[SIM_NUM_IRQS];
+static bool sim_irq_enabled[SIM_NUM_IRQS];
+static uint8_t sim_irq_priority[SIM_NUM_IRQS];
+static bool sim_irq_priority_set[SIM_NUM_IRQS];
+
+// GPIO, where a pin reads back what the converter drives onto it, or otherwise what the device
+// drives onto it (pulled HIGH when idle).
+static struct {
+  bool device_low;
+  bool output;
+  bool driven;
+} sim_gpio[SIM_GPIOS];
+
+// PIO
+pio_hw_t sim_pio_hw[2];
+
+static struct {
+  uint used;
+  struct {
+    bool claimed;
+    bool has_pin;
+    uint pin;
+    uint32_t fifo[SIM_PIO_FIFO_DEPTH];
+    uint fifo_count;
+  } sm[SIM_PIO_SMS];
+} sim_pio[2];
+
+// PWM and DMA
+static pwm_hw_t sim_pwm_hw;
+static dma_hw_t sim_dma_hw;
+pwm_hw_t *pwm_hw = &sim_pwm_hw;
+dma_hw_t *dma_hw = &sim_dma_hw;
+static bool sim_dma_claimed[SIM_DMA_CHANNELS];
+static volatile void *sim_dma_write_addr[SIM_DMA_CHANNELS];
+
+// USB, where the host is attached and configures the device whenever the device is connected.
+static bool sim_usb_host = false;
+static bool sim_usb_connected = false;
+static bool sim_usb_suspended = false;
+static uint32_t sim_usb_poll_us = 0;  // 0 completes each report immediately
+
+static void (*sim_loop_hook)(void) = NULL;  // Called from each pass of the main loop
+
+static struct {
+  bool busy;
+  uint64_t done_us;
+  uint8_t report[64];
+  uint16_t len;
+} sim_hid[SIM_HID_INSTANCES];
+
+/**
+ * @brief Prints a line of simulator output, stamped with the virtual time in milliseconds.
+ *
+ * @param format printf() style format of the line, without the trailing newline.
+ */
+void sim_log(const char *format, ...) {
+  va_list args;
+  printf("[SIM] %5llu.%03llu ", (unsigned long long)(sim_now_us / 1000),
+         (unsigned long long)(sim_now_us % 1000));
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  printf("\n");
+}
+
+static void sim_fatal(const char *message) {
+  sim_log("FATAL: %s", message);
+  fflush(stdout);
+  exit(1);
+}
+
+// ----------------------------------------------------------------------------------------------
+// Virtual clock
+// ----------------------------------------------------------------------------------------------
+
+static void sim_clock_set(uint64_t time_us) {
+  sim_now_us = time_us;
+  sim_timer_hw.timerawl = (uint32_t)time_us;
+  sim_timer_hw.timerawh = (uint32_t)(time_us >> 32);
+  // SysTick counts down at the system clock, wrapping at 24 bits.
+  sim_systick_hw.cvr = (0xFFFFFFu - (uint32_t)(time_us * (SIM_SYS_CLOCK_HZ / 1000000u))) &
+                       0xFFFFFFu;
+}
+
+/**
+ * @brief Runs the earliest alarm due no later than the given time, moving the clock up to it.
+ *
+ * @param limit_us The latest time an alarm may be due to be run.
+ *
+ * @return true if an alarm was run, false if none were due.
+ */
+static bool sim_run_next_alarm(uint64_t limit_us) {
+  sim_alarm_t *next = NULL;
+  int next_hw = -1;
+  uint64_t due_us = limit_us;
+  uint64_t seq = UINT64_MAX;
+
+  for (uint i = 0; i < SIM_ALARMS; i++) {
+    sim_alarm_t *alarm = &sim_alarms[i];
+    if (!alarm->active || alarm->due_us > due_us) continue;
+    if (alarm->due_us == due_us && alarm->seq > seq) continue;
+    next = alarm;
+    due_us = alarm->due_us;
+    seq = alarm->seq;
+  }
+  for (int i = 0; i < SIM_HW_ALARMS; i++) {
+    if (!sim_hw_alarms[i].armed || sim_hw_alarms[i].due_us > due_us) continue;
+    if (sim_hw_alarms[i].due_us == due_us && sim_hw_alarms[i].seq > seq) continue;
+    next = NULL;
+    next_hw = i;
+    due_us = sim_hw_alarms[i].due_us;
+    seq = sim_hw_alarms[i].seq;
+  }
+  if (next == NULL && next_hw < 0) return false;
+
+  if (due_us > sim_now_us) sim_clock_set(due_us);
+  sim_in_irq = true;
+  if (next_hw >= 0) {
+    sim_hw_alarms[next_hw].armed = false;
+    if (sim_hw_alarms[next_hw].callback) sim_hw_alarms[next_hw].callback((uint)next_hw);
+  } else {
+    // The slot is freed first, as the callback may add alarms of its own.
+    sim_alarm_t fired = *next;
+    next->active = false;
+    uint64_t reschedule_us = 0;
+    if (fired.timer) {
+      if (fired.timer->callback(fired.timer) && fired.timer->alarm_id == fired.id) {
+        int64_t delay_us = fired.timer->delay_us;
+        reschedule_us = delay_us >= 0 ? sim_now_us + (uint64_t)delay_us
+                                      : fired.due_us + (uint64_t)-delay_us;
+      }
+    } else {
+      int64_t result = fired.callback(fired.id, fired.user_data);
+      if (result > 0) reschedule_us = sim_now_us + (uint64_t)result;
+      if (result < 0) reschedule_us = fired.due_us + (uint64_t)-result;
+    }
+    if (reschedule_us) {
+      for (uint i = 0; i < SIM_ALARMS; i++) {
+        if (sim_alarms[i].active) continue;
+        sim_alarms[i] = fired;
+        sim_alarms[i].active = true;
+        sim_alarms[i].due_us = reschedule_us;
+        sim_alarms[i].seq = sim_event_seq++;
+        break;
+      }
+    }
+  }
+  sim_in_irq = false;
+  return true;
+}
+
+/**
+ * @brief Moves the virtual clock forward, running any alarms which fall due on the way.
+ * Alarms only run while interrupts are enabled and no other handler is running, so a busy-wait
+ * inside a handler or critical section just moves the clock.
+ *
+ * @param time_us The time to move the clock to.
+ */
+void sim_run_until(uint64_t time_us) {
+  if (sim_irq_disabled == 0 && !sim_in_irq) {
+    while (sim_run_next_alarm(time_us)) {
+    }
+  }
+  if (time_us > sim_now_us) sim_clock_set(time_us);
+}
+
+uint64_t sim_time_us(void) { return sim_now_us; }
+
+void sim_spin(void) { sim_run_until(sim_now_us + 1); }
+
+absolute_time_t get_absolute_time(void) { return sim_now_us; }
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+uint32_t time_us_32(void) { return (uint32_t)sim_now_us; }
+uint64_t time_us_64(void) { return sim_now_us; }
+uint32_t board_millis(void) { return (uint32_t)(sim_now_us / 1000); }
+void busy_wait_us(uint64_t delay_us) { sim_run_until(sim_now_us + delay_us); }
+void busy_wait_us_32(uint32_t delay_us) { sim_run_until(sim_now_us + delay_us); }
+void sleep_us(uint64_t us) { sim_run_until(sim_now_us + us); }
+void sleep_ms(uint32_t ms) { sim_run_until(sim_now_us + (uint64_t)ms * 1000); }
+
+static alarm_id_t sim_alarm_add(uint64_t due_us, alarm_callback_t callback, void *user_data,
+                                repeating_timer_t *timer) {
+  for (uint i = 0; i < SIM_ALARMS; i++) {
+    sim_alarm_t *alarm = &sim_alarms[i];
+    if (alarm->active) continue;
+    alarm->active = true;
+    alarm->id = sim_next_alarm_id++;
+    alarm->due_us = due_us;
+    alarm->seq = sim_event_seq++;
+    alarm->callback = callback;
+    alarm->user_data = user_data;
+    alarm->timer = timer;
+    return alarm->id;
+  }
+  return -1;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data,
+                           bool fire_if_past) {
+  (void)fire_if_past;
+  return sim_alarm_add(sim_now_us + us, callback, user_data, NULL);
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data,
+                           bool fire_if_past) {
+  return add_alarm_in_us((uint64_t)ms * 1000, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id) {
+  for (uint i = 0; i < SIM_ALARMS; i++) {
+    if (sim_alarms[i].active && sim_alarms[i].id == alarm_id) {
+      sim_alarms[i].active = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+  out->delay_us = delay_us;
+  out->user_data = user_data;
+  out->callback = callback;
+  uint64_t interval_us = (uint64_t)(delay_us < 0 ? -delay_us : delay_us);
+  out->alarm_id = sim_alarm_add(sim_now_us + interval_us, NULL, NULL, out);
+  return out->alarm_id >= 0;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+  return add_repeating_timer_us((int64_t)delay_ms * 1000, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+  bool cancelled = cancel_alarm(timer->alarm_id);
+  timer->alarm_id = -1;
+  return cancelled;
+}
+
+int hardware_alarm_claim_unused(bool required) {
+  // The last alarm belongs to the SDK's default alarm pool, behind add_alarm_in_us().
+  for (int i = 0; i < SIM_HW_ALARMS; i++) {
+    if (i == PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM || sim_hw_alarms[i].claimed) continue;
+    sim_hw_alarms[i].claimed = true;
+    return i;
+  }
+  if (required) sim_fatal("No hardware alarm available");
+  return -1;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback) {
+  sim_hw_alarms[alarm_num].callback = callback;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t) {
+  if (t <= sim_now_us) return true;  // Missed, just as the hardware would report it.
+  sim_hw_alarms[alarm_num].armed = true;
+  sim_hw_alarms[alarm_num].due_us = t;
+  sim_hw_alarms[alarm_num].seq = sim_event_seq++;
+  return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num) { sim_hw_alarms[alarm_num].armed = false; }
+
+// ----------------------------------------------------------------------------------------------
+// Interrupts
+// ----------------------------------------------------------------------------------------------
+
+uint get_core_num(void) { return 0; }
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+  if (sim_irq_handlers[num] && sim_irq_handlers[num] != handler) {
+    sim_fatal("IRQ already has an exclusive handler");
+  }
+  sim_irq_handlers[num] = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) { sim_irq_enabled[num] = enabled; }
+
+void irq_set_priority(uint num, uint8_t priority) {
+  sim_irq_priority[num] = priority;
+  sim_irq_priority_set[num] = true;
+}
+
+uint irq_get_priority(uint num) {
+  return sim_irq_priority_set[num] ? sim_irq_priority[num] : PICO_DEFAULT_IRQ_PRIORITY;
+}
+
+uint32_t __get_current_exception(void) { return sim_in_irq ? 16 : 0; }
+
+uint32_t save_and_disable_interrupts(void) { return sim_irq_disabled++; }
+
+void restore_interrupts(uint32_t status) { sim_irq_disabled = status; }
+
+void critical_section_init(critical_section_t *crit_sec) { crit_sec->save = 0; }
+
+void critical_section_enter_blocking(critical_section_t *crit_sec) {
+  crit_sec->save = save_and_disable_interrupts();
+}
+
+void critical_section_exit(critical_section_t *crit_sec) { restore_interrupts(crit_sec->save); }
+
+// ----------------------------------------------------------------------------------------------
+// Clocks, board and boot
+// ----------------------------------------------------------------------------------------------
+
+uint32_t clock_get_hz(int clk_index) {
+  (void)clk_index;
+  return SIM_SYS_CLOCK_HZ;
+}
+
+void board_init(void) {}
+
+void pico_get_unique_board_id_string(char *id_out, uint len) {
+  snprintf(id_out, len, "0123456789ABCDEF");
+}
+
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask) {
+  (void)gpio_activity_pin_mask;
+  (void)disable_interface_mask;
+  sim_log("Reboot into BOOTSEL");
+}
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) {
+  (void)pause_on_debug;
+  sim_log("Watchdog enabled (%ums)", (unsigned)delay_ms);
+}
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) {
+  (void)pc;
+  (void)sp;
+  sim_log("Watchdog reboot (%ums)", (unsigned)delay_ms);
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+  (void)entry;
+  sim_log("Core 1 launched");
+}
+
+void multicore_reset_core1(void) { sim_log("Core 1 reset"); }
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+  sim_log("Flash erase 0x%06X (%zu bytes)", (unsigned)flash_offs, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+  (void)data;
+  sim_log("Flash program 0x%06X (%zu bytes)", (unsigned)flash_offs, count);
+}
+
+// ----------------------------------------------------------------------------------------------
+// GPIO and PWM
+// ----------------------------------------------------------------------------------------------
+
+static void sim_gpio_drive(uint gpio, bool output, bool level) {
+  if (gpio >= SIM_GPIOS) return;
+  if (sim_gpio[gpio].output == output && (!output || sim_gpio[gpio].driven == level)) return;
+  sim_gpio[gpio].output = output;
+  sim_gpio[gpio].driven = level;
+  if (output) {
+    sim_log("GPIO %u driven %s", gpio, level ? "HIGH" : "LOW");
+  } else {
+    sim_log("GPIO %u released", gpio);
+  }
+}
+
+/**
+ * @brief Sets the level a device drives onto a pin, seen whenever the converter isn't driving it.
+ *
+ * @param gpio  The pin.
+ * @param level The level driven by the device, or HIGH when released.
+ */
+void sim_gpio_set(uint gpio, bool level) {
+  if (gpio < SIM_GPIOS) sim_gpio[gpio].device_low = !level;
+}
+
+void gpio_init(uint gpio) { sim_gpio_drive(gpio, false, false); }
+
+void gpio_set_function(uint gpio, int fn) {
+  (void)gpio;
+  (void)fn;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+  if (gpio < SIM_GPIOS) sim_gpio_drive(gpio, out, sim_gpio[gpio].driven);
+}
+
+void gpio_put(uint gpio, bool value) {
+  if (gpio < SIM_GPIOS) {
+    if (sim_gpio[gpio].output) {
+      sim_gpio_drive(gpio, true, value);
+    } else {
+      sim_gpio[gpio].driven = value;
+    }
+  }
+}
+
+bool gpio_get(uint gpio) {
+  if (gpio >= SIM_GPIOS) return false;
+  if (sim_gpio[gpio].output) return sim_gpio[gpio].driven;
+  return !sim_gpio[gpio].device_low;
+}
+
+void gpio_pull_up(uint gpio) { (void)gpio; }
+void gpio_pull_down(uint gpio) { (void)gpio; }
+void gpio_disable_pulls(uint gpio) { (void)gpio; }
+
+uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1) & 7; }
+
+pwm_config pwm_get_default_config(void) {
+  pwm_config config = {0, 1 << 4, 0xFFFF};
+  return config;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start) {
+  sim_pwm_hw.slice[slice_num].div = c->div;
+  sim_pwm_hw.slice[slice_num].top = c->top;
+  pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level) {
+  sim_pwm_hw.slice[pwm_gpio_to_slice_num(gpio)].cc = level;
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {
+  bool was_enabled = sim_pwm_hw.en & (1u << slice_num);
+  if (enabled == was_enabled) return;
+  if (enabled) {
+    sim_pwm_hw.en |= 1u << slice_num;
+    // The slice runs at the system clock divided by div (8.4 fixed point), wrapping at top.
+    uint32_t div = sim_pwm_hw.slice[slice_num].div ? sim_pwm_hw.slice[slice_num].div : 16;
+    uint64_t hz = (uint64_t)SIM_SYS_CLOCK_HZ * 16 / div / (sim_pwm_hw.slice[slice_num].top + 1);
+    sim_log("PWM %u on (%lluHz)", slice_num, (unsigned long long)hz);
+  } else {
+    sim_pwm_hw.en &= ~(1u << slice_num);
+    sim_log("PWM %u off", slice_num);
+  }
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) { sim_pwm_hw.slice[slice_num].top = wrap; }
+
+void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract) {
+  sim_pwm_hw.slice[slice_num].div = ((uint32_t)integer << 4) | fract;
+}
+
+void pwm_set_counter(uint slice_num, uint16_t c) { sim_pwm_hw.slice[slice_num].ctr = c; }
+
+// ----------------------------------------------------------------------------------------------
+// PIO
+// ----------------------------------------------------------------------------------------------
+
+static uint sim_pio_index(PIO pio) { return pio == pio1 ? 1 : 0; }
+
+static bool sim_pio_sm_enabled(PIO pio, uint sm) {
+  return pio->ctrl & (1u << (PIO_CTRL_SM_ENABLE_LSB + sm));
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program) {
+  return sim_pio[sim_pio_index(pio)].used + program->length <= SIM_PIO_INSTRUCTIONS;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+  // Just as the SDK does, programs are placed from the top of instruction memory down.
+  uint index = sim_pio_index(pio);
+  if (!pio_can_add_program(pio, program)) sim_fatal("No space for PIO program");
+  sim_pio[index].used += program->length;
+  return SIM_PIO_INSTRUCTIONS - sim_pio[index].used;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+  uint index = sim_pio_index(pio);
+  for (uint sm = 0; sm < SIM_PIO_SMS; sm++) {
+    if (sim_pio[index].sm[sm].claimed) continue;
+    sim_pio[index].sm[sm].claimed = true;
+    return (int)sm;
+  }
+  if (required) sim_fatal("No PIO State Machine available");
+  return -1;
+}
+
+/**
+ * @brief Records the pins a State Machine was given, from the stand-in for a pioasm header.
+ * The State Machine is left enabled, just as each program's init function leaves it.
+ *
+ * @param pio    The PIO instance.
+ * @param sm     The State Machine.
+ * @param offset The offset the program was loaded at.
+ * @param pin    The first pin used by the program.
+ */
+void sim_pio_program_init(PIO pio, uint sm, uint offset, uint pin) {
+  uint index = sim_pio_index(pio);
+  sim_pio[index].sm[sm].has_pin = true;
+  sim_pio[index].sm[sm].pin = pin;
+  sim_pio[index].sm[sm].fifo_count = 0;
+  pio->sm[sm].addr = offset;
+  pio->ctrl |= 1u << (PIO_CTRL_SM_ENABLE_LSB + sm);
+}
+
+/**
+ * @brief Finds the State Machine running a program on the given pin.
+ *
+ * @param pin The first pin used by the program.
+ * @param pio Set to the PIO instance.
+ * @param sm  Set to the State Machine.
+ *
+ * @return true if a State Machine was found, false otherwise.
+ */
+bool sim_pio_find(uint pin, PIO *pio, uint *sm) {
+  for (uint index = 0; index < 2; index++) {
+    for (uint i = 0; i < SIM_PIO_SMS; i++) {
+      if (!sim_pio[index].sm[i].has_pin || sim_pio[index].sm[i].pin != pin) continue;
+      *pio = &sim_pio_hw[index];
+      *sm = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Places frames received from a device in a State Machine's RX FIFO, and services them.
+ * The frames are queued together, as they would be if they arrived while the PIO interrupt was
+ * held off, and the handler then runs once per frame with the frame in the RX FIFO register, and
+ * any frames behind it still queued.  Frames arriving while the State Machine is disabled, or
+ * beyond the depth of the FIFO, are lost.
+ *
+ * @param pio    The PIO instance.
+ * @param sm     The State Machine.
+ * @param frames The raw RX FIFO words, as the program would push them.
+ * @param count  The number of frames.
+ *
+ * @return The number of frames accepted into the FIFO.
+ */
+uint sim_pio_receive(PIO pio, uint sm, const uint32_t *frames, uint count) {
+  uint index = sim_pio_index(pio);
+  uint accepted = 0;
+  for (uint i = 0; i < count; i++) {
+    if (!sim_pio_sm_enabled(pio, sm)) {
+      sim_log("PIO%u SM%u disabled, frame lost", index, sm);
+      continue;
+    }
+    if (sim_pio[index].sm[sm].fifo_count == SIM_PIO_FIFO_DEPTH) {
+      sim_log("PIO%u SM%u RX FIFO full, frame lost", index, sm);
+      continue;
+    }
+    sim_pio[index].sm[sm].fifo[sim_pio[index].sm[sm].fifo_count++] = frames[i];
+    accepted++;
+  }
+
+  uint irq = index ? PIO1_IRQ_0 : PIO0_IRQ_0;
+  while (sim_pio[index].sm[sm].fifo_count && sim_irq_enabled[irq] && sim_irq_handlers[irq]) {
+    pio->rxf[sm] = pio_sm_get(pio, sm);
+    sim_in_irq = true;
+    sim_irq_handlers[irq]();
+    sim_in_irq = false;
+  }
+  return accepted;
+}
+
+void pio_gpio_init(PIO pio, uint pin) {
+  (void)pio;
+  (void)pin;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+  (void)config;
+  pio->sm[sm].addr = initial_pc;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+  if (enabled == sim_pio_sm_enabled(pio, sm)) return;
+  if (enabled) {
+    pio->ctrl |= 1u << (PIO_CTRL_SM_ENABLE_LSB + sm);
+  } else {
+    pio->ctrl &= ~(1u << (PIO_CTRL_SM_ENABLE_LSB + sm));
+  }
+  sim_log("PIO%u SM%u %s", sim_pio_index(pio), sm, enabled ? "enabled" : "disabled");
+}
+
+void pio_sm_restart(PIO pio, uint sm) { (void)pio, (void)sm; }
+
+void pio_sm_exec(PIO pio, uint sm, uint instr) {
+  // Only jumps are executed by the converter, which encode as the target address.
+  pio->sm[sm].addr = instr & 0x1F;
+  sim_log("PIO%u SM%u jump to %u", sim_pio_index(pio), sm, instr & 0x1F);
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm) { return (uint8_t)pio->sm[sm].addr; }
+
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div) {
+  pio->sm[sm].clkdiv = (uint32_t)(div * 256.0f) << 8;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm) { sim_pio[sim_pio_index(pio)].sm[sm].fifo_count = 0; }
+
+void pio_sm_drain_tx_fifo(PIO pio, uint sm) { (void)pio, (void)sm; }
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+  sim_log("PIO%u SM%u TX 0x%03X", sim_pio_index(pio), sm, (unsigned)data);
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data) { pio_sm_put(pio, sm, data); }
+
+uint32_t pio_sm_get(PIO pio, uint sm) {
+  uint index = sim_pio_index(pio);
+  if (!sim_pio[index].sm[sm].fifo_count) return 0;
+  uint32_t data = sim_pio[index].sm[sm].fifo[0];
+  sim_pio[index].sm[sm].fifo_count--;
+  memmove(&sim_pio[index].sm[sm].fifo[0], &sim_pio[index].sm[sm].fifo[1],
+          sim_pio[index].sm[sm].fifo_count * sizeof(uint32_t));
+  return data;
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm) {
+  return sim_pio[sim_pio_index(pio)].sm[sm].fifo_count == 0;
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm) { return (void)pio, (void)sm, false; }
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm) {
+  return sim_pio[sim_pio_index(pio)].sm[sm].fifo_count;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+  (void)pio, (void)sm, (void)pin_base, (void)pin_count, (void)is_out;
+}
+
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask) {
+  (void)pio, (void)sm;
+  for (uint gpio = 0; gpio < SIM_GPIOS; gpio++) {
+    if (pin_mask & (1u << gpio)) gpio_put(gpio, pin_values & (1u << gpio));
+  }
+}
+
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask) {
+  (void)pio, (void)sm;
+  for (uint gpio = 0; gpio < SIM_GPIOS; gpio++) {
+    if (pin_mask & (1u << gpio)) gpio_set_dir(gpio, pin_dirs & (1u << gpio));
+  }
+}
+
+void pio_set_irq0_source_enabled(PIO pio, int source, bool enabled) {
+  if (enabled) {
+    pio->inte0 |= 1u << source;
+  } else {
+    pio->inte0 &= ~(1u << source);
+  }
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx) { return sim_pio_index(pio) * 8 + sm + !is_tx * 4; }
+
+uint pio_encode_jmp(uint addr) { return addr; }
+
+pio_sm_config pio_get_default_sm_config(void) {
+  pio_sm_config config = {0, 0, 0, 0};
+  return config;
+}
+
+void sm_config_set_in_pins(pio_sm_config *c, uint in_base) { (void)c, (void)in_base; }
+void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {
+  (void)c, (void)out_base, (void)out_count;
+}
+void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count) {
+  (void)c, (void)set_base, (void)set_count;
+}
+void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base) {
+  (void)c, (void)sideset_base;
+}
+void sm_config_set_jmp_pin(pio_sm_config *c, uint pin) { (void)c, (void)pin; }
+void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint threshold) {
+  (void)c, (void)shift_right, (void)autopush, (void)threshold;
+}
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint threshold) {
+  (void)c, (void)shift_right, (void)autopull, (void)threshold;
+}
+void sm_config_set_clkdiv(pio_sm_config *c, float div) { c->clkdiv = (uint32_t)(div * 256.0f); }
+void sm_config_set_fifo_join(pio_sm_config *c, int join) { (void)c, (void)join; }
+
+// ----------------------------------------------------------------------------------------------
+// DMA.  Transfers complete as soon as they are started.
+// ----------------------------------------------------------------------------------------------
+
+int dma_claim_unused_channel(bool required) {
+  for (int i = 0; i < SIM_DMA_CHANNELS; i++) {
+    if (sim_dma_claimed[i]) continue;
+    sim_dma_claimed[i] = true;
+    return i;
+  }
+  if (required) sim_fatal("No DMA channel available");
+  return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+  dma_channel_config config = {channel};
+  return config;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, int size) { (void)c, (void)size; }
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) { (void)c, (void)incr; }
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) { (void)c, (void)incr; }
+void channel_config_set_dreq(dma_channel_config *c, uint dreq) { (void)c, (void)dreq; }
+void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits) {
+  (void)c, (void)write, (void)size_bits;
+}
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to) { (void)c, (void)chain_to; }
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger) {
+  (void)config, (void)read_addr, (void)trigger;
+  sim_dma_write_addr[channel] = write_addr;
+  sim_dma_hw.ch[channel].transfer_count = transfer_count;
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger) {
+  (void)channel, (void)read_addr, (void)trigger;
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger) {
+  (void)trigger;
+  sim_dma_write_addr[channel] = write_addr;
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+  (void)trigger;
+  sim_dma_hw.ch[channel].transfer_count = trans_count;
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr,
+                                          uint32_t transfer_count) {
+  dma_channel_set_trans_count(channel, transfer_count, true);
+
+  // Transfers into a State Machine's TX FIFO are logged as the words the program would send.
+  for (uint index = 0; index < 2; index++) {
+    for (uint sm = 0; sm < SIM_PIO_SMS; sm++) {
+      if (sim_dma_write_addr[channel] != &sim_pio_hw[index].txf[sm]) continue;
+      char words[9 * 16 + 1] = "";
+      const volatile uint32_t *data = read_addr;
+      for (uint32_t i = 0; i < transfer_count && i < 16; i++) {
+        sprintf(&words[i * 9], " %08X", (unsigned)data[i]);
+      }
+      sim_log("PIO%u SM%u TX (DMA)%s", index, sm, words);
+    }
+  }
+}
+
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr,
+                                        uint32_t transfer_count) {
+  dma_channel_set_write_addr(channel, write_addr, false);
+  dma_channel_set_trans_count(channel, transfer_count, true);
+}
+
+void dma_channel_start(uint channel) { (void)channel; }
+void dma_channel_abort(uint channel) { (void)channel; }
+bool dma_channel_is_busy(uint channel) { return (void)channel, false; }
+
+// ----------------------------------------------------------------------------------------------
+// TinyUSB
+// ----------------------------------------------------------------------------------------------
+
+static bool sim_usb_mounted(void) { return sim_usb_host && sim_usb_connected; }
+
+bool tusb_init(void) {
+  sim_usb_connected = true;
+  return true;
+}
+
+/**
+ * @brief Sets a function to be called from each pass of the converter's main loop.
+ * The hook is how a runner moves virtual time on and drives the devices and host, as the main loop
+ * itself never returns.
+ *
+ * @param hook The function to call, or NULL for none.
+ */
+void sim_set_loop_hook(void (*hook)(void)) { sim_loop_hook = hook; }
+
+/**
+ * @brief Completes any reports the host has polled for since they were submitted.
+ * This is called from the main loop, as TinyUSB would be, so it is also where reports complete, and
+ * where the loop hook is called.
+ */
+void tud_task(void) {
+  if (sim_loop_hook) sim_loop_hook();
+  for (uint8_t instance = 0; instance < SIM_HID_INSTANCES; instance++) {
+    if (!sim_hid[instance].busy || sim_now_us < sim_hid[instance].done_us) continue;
+    sim_hid[instance].busy = false;
+    if (tud_hid_report_complete_cb) {
+      tud_hid_report_complete_cb(instance, sim_hid[instance].report, sim_hid[instance].len);
+    }
+  }
+}
+
+bool tud_mounted(void) { return sim_usb_mounted(); }
+bool tud_suspended(void) { return sim_usb_suspended; }
+
+bool tud_connect(void) {
+  if (!sim_usb_connected) {
+    sim_usb_connected = true;
+    sim_log("USB connected%s", sim_usb_host ? ", host configured the device" : "");
+  }
+  return true;
+}
+
+bool tud_disconnect(void) {
+  if (sim_usb_connected) {
+    sim_usb_connected = false;
+    memset(sim_hid, 0, sizeof(sim_hid));
+    sim_log("USB disconnected");
+  }
+  return true;
+}
+
+bool tud_remote_wakeup(void) {
+  sim_log("USB remote wakeup");
+  sim_usb_suspend(false);
+  return true;
+}
+
+bool tud_hid_n_ready(uint8_t instance) {
+  return sim_usb_mounted() && !sim_usb_suspended && instance < SIM_HID_INSTANCES &&
+         !sim_hid[instance].busy;
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len) {
+  if (!tud_hid_n_ready(instance)) return false;
+
+  char bytes[3 * 64 + 1] = "";
+  const uint8_t *data = report;
+  for (uint16_t i = 0; i < len && i < 64; i++) sprintf(&bytes[i * 3], " %02X", data[i]);
+  sim_log("HID %u ID %u:%s", instance, report_id, bytes);
+
+  sim_hid[instance].len = len < sizeof(sim_hid[instance].report) ? len : 64;
+  memcpy(sim_hid[instance].report, report, sim_hid[instance].len);
+  if (sim_usb_poll_us) {
+    // The report is collected at the host's next poll of the endpoint.
+    sim_hid[instance].busy = true;
+    sim_hid[instance].done_us = (sim_now_us / sim_usb_poll_us + 1) * sim_usb_poll_us;
+  } else if (tud_hid_report_complete_cb) {
+    tud_hid_report_complete_cb(instance, sim_hid[instance].report, sim_hid[instance].len);
+  }
+  return true;
+}
+
+bool tud_hid_ready(void) { return tud_hid_n_ready(0); }
+
+bool tud_hid_report(uint8_t report_id, void const *report, uint16_t len) {
+  return tud_hid_n_report(0, report_id, report, len);
+}
+
+uint32_t tud_vendor_n_available(uint8_t itf) { return (void)itf, 0; }
+
+uint32_t tud_vendor_n_read(uint8_t itf, void *buffer, uint32_t bufsize) {
+  return (void)itf, (void)buffer, (void)bufsize, 0;
+}
+
+uint32_t tud_vendor_n_write(uint8_t itf, void const *buffer, uint32_t bufsize) {
+  return (void)itf, (void)buffer, bufsize;
+}
+
+uint32_t tud_vendor_n_write_flush(uint8_t itf) { return (void)itf, 0; }
+uint32_t tud_vendor_n_write_available(uint8_t itf) { return (void)itf, 64; }
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize) { return (void)buffer, bufsize; }
+
+/**
+ * @brief Attaches or detaches the host, which configures the device whenever it is connected.
+ *
+ * @param mounted Whether the host is attached.
+ */
+void sim_usb_mount(bool mounted) {
+  sim_usb_host = mounted;
+  if (!mounted) memset(sim_hid, 0, sizeof(sim_hid));
+  sim_log("USB host %s", mounted ? "attached" : "detached");
+}
+
+/**
+ * @brief Suspends or resumes the bus, calling the converter back as TinyUSB would.
+ *
+ * @param suspended Whether the bus is suspended.
+ */
+void sim_usb_suspend(bool suspended) {
+  if (suspended == sim_usb_suspended) return;
+  sim_usb_suspended = suspended;
+  sim_log("USB %s", suspended ? "suspended" : "resumed");
+  if (suspended && tud_suspend_cb) tud_suspend_cb(true);
+  if (!suspended && tud_resume_cb) tud_resume_cb();
+}
+
+/**
+ * @brief Sets how often the host polls each interrupt endpoint.
+ *
+ * @param poll_us The polling interval, or 0 to complete each report as soon as it is submitted.
+ */
+void sim_usb_set_poll_us(uint32_t poll_us) { sim_usb_poll_us = poll_us; }
+
+/**
+ * @brief Sends an output report from the host, such as the Keyboard Lock LED state.
+ *
+ * @param instance  The HID interface instance.
+ * @param report_id The report ID.
+ * @param data      The report data.
+ * @param len       The length of the report data.
+ */
+void sim_usb_set_report(uint8_t instance, uint8_t report_id, const uint8_t *data, uint16_t len) {
+  if (tud_hid_set_report_cb) {
+    tud_hid_set_report_cb(instance, report_id, HID_REPORT_TYPE_OUTPUT, data, len);
+  }
+}
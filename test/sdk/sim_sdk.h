@@ -0,0 +1,394 @@
+/*
+ * This file is part of RP2040 Keyboard Converter.
+ *
+ * Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+ *
+ * RP2040 Keyboard Converter is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * RP2040 Keyboard Converter is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RP2040 Keyboard Converter.
+ * If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIM_SDK_H
+#define SIM_SDK_H
+
+// The subset of the pico-sdk, TinyUSB and board support APIs used by the converter, declared for a
+// host build.  Every pico-sdk and TinyUSB header the converter includes resolves to this file, and
+// the functions are implemented against a virtual clock and virtual hardware in sim_sdk.c.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef unsigned int uint;
+
+typedef volatile uint32_t io_rw_32;
+typedef const volatile uint32_t io_ro_32;
+typedef volatile uint32_t io_wo_32;
+
+// clang-format off
+// Platform
+#define __isr
+#define __not_in_flash_func(f) f
+#define __no_inline_not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define __not_in_flash(group)
+#define __in_flash(group)
+#define __scratch_x(name)
+#define __scratch_y(name)
+#define __force_inline inline
+#define __unused __attribute__((unused))
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+// clang-format on
+
+// Busy-wait loops would never see the virtual clock move, so each spin advances it slightly.
+void sim_spin(void);
+static inline void tight_loop_contents(void) { sim_spin(); }
+static inline void __compiler_memory_barrier(void) { __asm__ volatile("" ::: "memory"); }
+static inline void __dmb(void) { __compiler_memory_barrier(); }
+static inline void __sev(void) {}
+static inline void __wfe(void) {}
+static inline void __wfi(void) {}
+uint get_core_num(void);
+
+// Interrupts
+enum {
+  TIMER_IRQ_0 = 0,
+  TIMER_IRQ_1 = 1,
+  TIMER_IRQ_2 = 2,
+  TIMER_IRQ_3 = 3,
+  USBCTRL_IRQ = 5,
+  PIO0_IRQ_0 = 7,
+  PIO0_IRQ_1 = 8,
+  PIO1_IRQ_0 = 9,
+  PIO1_IRQ_1 = 10,
+  DMA_IRQ_0 = 11,
+  DMA_IRQ_1 = 12,
+  UART0_IRQ = 20,
+  SIM_NUM_IRQS = 32
+};
+#define PICO_HIGHEST_IRQ_PRIORITY 0x00
+#define PICO_DEFAULT_IRQ_PRIORITY 0x80
+#define PICO_LOWEST_IRQ_PRIORITY 0xff
+typedef void (*irq_handler_t)(void);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+void irq_set_priority(uint num, uint8_t priority);
+uint irq_get_priority(uint num);
+uint32_t __get_current_exception(void);
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+typedef struct {
+  uint32_t save;
+} critical_section_t;
+void critical_section_init(critical_section_t *crit_sec);
+void critical_section_enter_blocking(critical_section_t *crit_sec);
+void critical_section_exit(critical_section_t *crit_sec);
+
+// Time
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+typedef struct repeating_timer {
+  int64_t delay_us;
+  void *user_data;
+  alarm_id_t alarm_id;
+  bool (*callback)(struct repeating_timer *rt);
+} repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+#define PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM 3
+
+absolute_time_t get_absolute_time(void);
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us);
+absolute_time_t from_us_since_boot(uint64_t us);
+uint64_t to_us_since_boot(absolute_time_t t);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void busy_wait_us(uint64_t delay_us);
+void busy_wait_us_32(uint32_t delay_us);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data,
+                           bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data,
+                           bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+int hardware_alarm_claim_unused(bool required);
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback);
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(uint alarm_num);
+
+typedef struct {
+  io_rw_32 timehw, timelw, timehr, timelr, alarm[4], armed, timerawh, timerawl;
+} timer_hw_t;
+extern timer_hw_t *timer_hw;
+
+typedef struct {
+  io_rw_32 csr, rvr, cvr, calib;
+} systick_hw_t;
+extern systick_hw_t *systick_hw;
+#define M0PLUS_SYST_CSR_ENABLE_BITS 0x1u
+#define M0PLUS_SYST_CSR_CLKSOURCE_BITS 0x4u
+
+// Clocks, board and boot
+enum { clk_sys = 5 };
+uint32_t clock_get_hz(int clk_index);
+void board_init(void);
+uint32_t board_millis(void);
+void pico_get_unique_board_id_string(char *id_out, uint len);
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask);
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms);
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+
+// GPIO and PWM
+enum { GPIO_IN = 0, GPIO_OUT = 1 };
+enum { GPIO_FUNC_PWM = 4, GPIO_FUNC_SIO = 5, GPIO_FUNC_PIO0 = 6, GPIO_FUNC_PIO1 = 7 };
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, int fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_disable_pulls(uint gpio);
+
+typedef struct {
+  uint32_t csr, div, top;
+} pwm_config;
+typedef struct {
+  struct {
+    io_rw_32 csr, div, ctr, cc, top;
+  } slice[8];
+  io_rw_32 en;
+} pwm_hw_t;
+extern pwm_hw_t *pwm_hw;
+uint pwm_gpio_to_slice_num(uint gpio);
+pwm_config pwm_get_default_config(void);
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_enabled(uint slice_num, bool enabled);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract);
+void pwm_set_counter(uint slice_num, uint16_t c);
+
+// PIO
+// The RX FIFOs are writable here, as the simulator places each received frame in them.
+typedef struct {
+  io_rw_32 ctrl;
+  io_rw_32 fstat;
+  io_rw_32 txf[4];
+  io_rw_32 rxf[4];
+  io_rw_32 irq;
+  struct {
+    io_rw_32 clkdiv, execctrl, shiftctrl, addr, instr, pinctrl;
+  } sm[4];
+  io_rw_32 inte0;
+  io_rw_32 ints0;
+} pio_hw_t;
+typedef pio_hw_t *PIO;
+extern pio_hw_t sim_pio_hw[2];
+#define pio0 (&sim_pio_hw[0])
+#define pio1 (&sim_pio_hw[1])
+#define PIO_CTRL_SM_ENABLE_LSB 0
+
+typedef struct {
+  const uint16_t *instructions;
+  uint8_t length;
+  int8_t origin;
+} pio_program_t;
+typedef struct {
+  uint32_t clkdiv, execctrl, shiftctrl, pinctrl;
+} pio_sm_config;
+enum { PIO_FIFO_JOIN_NONE, PIO_FIFO_JOIN_TX, PIO_FIFO_JOIN_RX };
+enum { pis_sm0_rx_fifo_not_empty = 0 };
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_drain_tx_fifo(PIO pio, uint sm);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get(PIO pio, uint sm);
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t pin_values, uint32_t pin_mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t pin_dirs, uint32_t pin_mask);
+void pio_set_irq0_source_enabled(PIO pio, int source, bool enabled);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+uint pio_encode_jmp(uint addr);
+pio_sm_config pio_get_default_sm_config(void);
+void sm_config_set_in_pins(pio_sm_config *c, uint in_base);
+void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count);
+void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count);
+void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base);
+void sm_config_set_jmp_pin(pio_sm_config *c, uint pin);
+void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint threshold);
+void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint threshold);
+void sm_config_set_clkdiv(pio_sm_config *c, float div);
+void sm_config_set_fifo_join(pio_sm_config *c, int join);
+void sim_pio_program_init(PIO pio, uint sm, uint offset, uint pin);
+
+// DMA
+enum { DMA_SIZE_8, DMA_SIZE_16, DMA_SIZE_32 };
+typedef struct {
+  uint32_t ctrl;
+} dma_channel_config;
+typedef struct {
+  struct {
+    io_rw_32 read_addr, write_addr, transfer_count, ctrl_trig;
+  } ch[12];
+} dma_hw_t;
+extern dma_hw_t *dma_hw;
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, int size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits);
+void channel_config_set_chain_to(dma_channel_config *c, uint chain_to);
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr,
+                                          uint32_t transfer_count);
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr,
+                                        uint32_t transfer_count);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+
+// Flash
+#define XIP_BASE 0x10000000u
+#define FLASH_PAGE_SIZE 256u
+#define FLASH_SECTOR_SIZE 4096u
+#define PICO_FLASH_SIZE_BYTES (2u * 1024 * 1024)
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+// TinyUSB
+#define CFG_TUSB_MCU 1
+#define TU_ATTR_PACKED __attribute__((packed))
+#define TU_ARRAY_SIZE count_of
+#define CFG_TUD_ENDPOINT0_SIZE 64
+enum { TUSB_DESC_DEVICE = 1, TUSB_DESC_CONFIGURATION = 2, TUSB_DESC_STRING = 3 };
+enum { HID_ITF_PROTOCOL_NONE, HID_ITF_PROTOCOL_KEYBOARD, HID_ITF_PROTOCOL_MOUSE };
+typedef enum {
+  HID_REPORT_TYPE_INVALID,
+  HID_REPORT_TYPE_INPUT,
+  HID_REPORT_TYPE_OUTPUT,
+  HID_REPORT_TYPE_FEATURE
+} hid_report_type_t;
+typedef struct TU_ATTR_PACKED {
+  uint8_t modifier;
+  uint8_t reserved;
+  uint8_t keycode[6];
+} hid_keyboard_report_t;
+typedef struct TU_ATTR_PACKED {
+  uint8_t buttons;
+  int8_t x, y, wheel, pan;
+} hid_mouse_report_t;
+typedef struct TU_ATTR_PACKED {
+  uint8_t bLength, bDescriptorType;
+  uint16_t bcdUSB;
+  uint8_t bDeviceClass, bDeviceSubClass, bDeviceProtocol, bMaxPacketSize0;
+  uint16_t idVendor, idProduct, bcdDevice;
+  uint8_t iManufacturer, iProduct, iSerialNumber, bNumConfigurations;
+} tusb_desc_device_t;
+
+// clang-format off
+// The descriptor macros only need to produce descriptors of the right length, as the host build
+// never enumerates.
+#define TUD_CONFIG_DESC_LEN 9
+#define TUD_HID_DESC_LEN 25
+#define TUD_HID_INOUT_DESC_LEN 32
+#define TUD_VENDOR_DESC_LEN 23
+#define TUD_CONFIG_DESCRIPTOR(num, itf, str, len, attr, ma) \
+  9, TUSB_DESC_CONFIGURATION, (len) & 0xff, ((len) >> 8) & 0xff, itf, num, str, (1 << 7) | (attr), \
+  (ma) / 2
+#define TUD_HID_DESCRIPTOR(itf, str, proto, len, ep, size, poll) \
+  itf, str, proto, (len) & 0xff, ((len) >> 8) & 0xff, ep, (size) & 0xff, ((size) >> 8) & 0xff, \
+  poll, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+#define TUD_HID_INOUT_DESCRIPTOR(itf, str, proto, len, epout, epin, size, poll) \
+  itf, str, proto, (len) & 0xff, ((len) >> 8) & 0xff, epout, epin, (size) & 0xff, \
+  ((size) >> 8) & 0xff, poll, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+#define TUD_VENDOR_DESCRIPTOR(itf, str, epout, epin, size) \
+  itf, str, epout, epin, size, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+#define HID_REPORT_ID(x) 0x85, x,
+#define TUD_HID_REPORT_DESC_KEYBOARD(...) 0x05, 0x01, __VA_ARGS__ 0xc0
+#define TUD_HID_REPORT_DESC_CONSUMER(...) 0x05, 0x0c, __VA_ARGS__ 0xc0
+#define TUD_HID_REPORT_DESC_MOUSE(...) 0x05, 0x01, __VA_ARGS__ 0xc0
+#define TUD_HID_REPORT_DESC_SYSTEM_CONTROL(...) 0x05, 0x01, __VA_ARGS__ 0xc0
+#define TUD_HID_REPORT_DESC_GENERIC_INOUT(len, ...) 0x06, 0x00, 0xff, __VA_ARGS__ 0xc0
+// clang-format on
+
+bool tusb_init(void);
+void tud_task(void);
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_connect(void);
+bool tud_disconnect(void);
+bool tud_remote_wakeup(void);
+bool tud_hid_n_ready(uint8_t instance);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len);
+bool tud_hid_ready(void);
+bool tud_hid_report(uint8_t report_id, void const *report, uint16_t len);
+uint32_t tud_vendor_n_available(uint8_t itf);
+uint32_t tud_vendor_n_read(uint8_t itf, void *buffer, uint32_t bufsize);
+uint32_t tud_vendor_n_write(uint8_t itf, void const *buffer, uint32_t bufsize);
+uint32_t tud_vendor_n_write_flush(uint8_t itf);
+uint32_t tud_vendor_n_write_available(uint8_t itf);
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize);
+
+// Callbacks into the converter, as TinyUSB would make them.  Those the converter doesn't implement
+// are left NULL, just as TinyUSB declares them weak.
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               uint8_t *buffer, uint16_t reqlen) __attribute__((weak));
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                           uint8_t const *buffer, uint16_t bufsize) __attribute__((weak));
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len)
+    __attribute__((weak));
+void tud_suspend_cb(bool remote_wakeup_en) __attribute__((weak));
+void tud_resume_cb(void) __attribute__((weak));
+
+#endif /* SIM_SDK_H */
@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+#
+# This file is part of RP2040 Keyboard Converter.
+#
+# Copyright 2023 Paul Bramhall (paulwamp@gmail.com)
+#
+# RP2040 Keyboard Converter is free software: you can redistribute it
+# and/or modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation, either version 3 of
+# the License, or (at your option) any later version.
+#
+# RP2040 Keyboard Converter is distributed in the hope that it will be
+# useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+# of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with RP2040 Keyboard Converter.
+# If not, see <https://www.gnu.org/licenses/>.
+
+"""Streams a new Firmware to any number of converters at once, over their vendor HID interface.
+
+Each converter built with CONVERTER_FW_UPDATE is found through Linux hidraw, and updated from its
+own thread, so updating many converters takes no longer than updating one.  Converters can be
+picked by serial number, otherwise every converter found is updated.  Only the Python standard
+library is needed, but the user must be able to open the converters' /dev/hidraw* nodes.
+
+    tools/fw_update.py build/rp2040-converter.bin
+    tools/fw_update.py --list
+    tools/fw_update.py --serial E6614C311B4A8F2B --serial E6614C311B3B7C28 build/rp2040-converter.bin
+
+The protocol is described in the README, and in src/common/lib/fw_update.h.
+"""
+
+import argparse
+import glob
+import os
+import select
+import struct
+import sys
+import threading
+import time
+import zlib
+
+USB_VID = 0x5515
+VENDOR_PID_FLAG = 0x0004  # Added to the Product ID when the vendor interface is present
+VENDOR_USAGE_PAGE = bytes([0x06, 0x00, 0xFF])  # Usage Page (0xFF00), first item of the descriptor
+
+PACKET_SIZE = 64
+DATA_MAX = PACKET_SIZE - 8
+
+CMD_BEGIN = 0x01
+CMD_DATA = 0x02
+CMD_FINISH = 0x03
+CMD_SWAP = 0x04
+CMD_ABORT = 0x05
+CMD_STATUS = 0x06
+
+STATUS_OK = 0
+STATUS_BUSY = 1
+STATUS_NAMES = ["OK", "Busy", "Invalid State", "Invalid Size", "Invalid Offset", "Invalid Image",
+                "Flash Failed", "CRC Mismatch", "Unknown Command"]
+
+STATE_VERIFIED = 3
+
+REPLY_TIMEOUT_S = 2.0
+VERIFY_TIMEOUT_S = 30.0
+RETRIES = 5
+
+print_lock = threading.Lock()
+
+
+def log(serial, message):
+    with print_lock:
+        print(f"[{serial}] {message}", flush=True)
+
+
+class UpdateError(Exception):
+    pass
+
+
+class Converter:
+    """A single converter, reached through the hidraw node of its vendor interface."""
+
+    def __init__(self, path, serial):
+        self.path = path
+        self.serial = serial
+        self.fd = None
+
+    def open(self):
+        self.fd = os.open(self.path, os.O_RDWR)
+        # Discard anything already queued, such as Event Stamps or replies to an earlier host.
+        while select.select([self.fd], [], [], 0)[0]:
+            os.read(self.fd, PACKET_SIZE)
+
+    def close(self):
+        if self.fd is not None:
+            os.close(self.fd)
+            self.fd = None
+
+    def command(self, command, fields=b"", byte1=0):
+        """Sends a command and returns its reply as (status, state, received, crc, slot_size).
+
+        The vendor interface has no Report IDs, so each write starts with a zero report number.
+        Event Stamp and Sniffer packets (0x80 and above) share the interface and are skipped, as are
+        any late replies to an earlier command.
+        """
+        packet = bytes([command, byte1, 0, 0]) + fields
+        packet = packet.ljust(PACKET_SIZE, b"\0")
+        for _ in range(RETRIES):
+            os.write(self.fd, b"\0" + packet)
+            deadline = time.monotonic() + REPLY_TIMEOUT_S
+            while True:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0 or not select.select([self.fd], [], [], remaining)[0]:
+                    break
+                reply = os.read(self.fd, PACKET_SIZE)
+                if len(reply) < 16 or reply[0] != command:
+                    continue
+                received, crc, slot_size = struct.unpack_from("<III", reply, 4)
+                return reply[1], reply[2], received, crc, slot_size
+        raise UpdateError(f"No reply to command 0x{command:02X}")
+
+
+def find_converters():
+    """Returns a Converter for the vendor interface of every converter attached."""
+    converters = []
+    for node in sorted(glob.glob("/sys/class/hidraw/hidraw*")):
+        try:
+            with open(os.path.join(node, "device", "uevent")) as uevent:
+                fields = dict(line.strip().split("=", 1) for line in uevent if "=" in line)
+            with open(os.path.join(node, "device", "report_descriptor"), "rb") as desc:
+                descriptor = desc.read()
+        except OSError:
+            continue
+        _, vid, pid = (int(part, 16) for part in fields.get("HID_ID", "0:0:0").split(":"))
+        if vid != USB_VID or not pid & VENDOR_PID_FLAG:
+            continue
+        if not descriptor.startswith(VENDOR_USAGE_PAGE):
+            continue
+        serial = fields.get("HID_UNIQ") or os.path.basename(node)
+        converters.append(Converter(os.path.join("/dev", os.path.basename(node)), serial))
+    return converters
+
+
+def expect_ok(serial, what, status):
+    if status != STATUS_OK:
+        name = STATUS_NAMES[status] if status < len(STATUS_NAMES) else f"Status {status}"
+        raise UpdateError(f"{what} failed: {name}")
+
+
+def update(converter, image, results):
+    serial = converter.serial
+    size = len(image)
+    crc = zlib.crc32(image) & 0xFFFFFFFF
+    try:
+        converter.open()
+        status, _, _, _, slot_size = converter.command(CMD_BEGIN, struct.pack("<II", size, crc))
+        expect_ok(serial, "Begin", status)
+        log(serial, f"Sending {size} bytes (staging slot {slot_size} bytes)")
+
+        offset = 0
+        next_report = 0
+        while offset < size:
+            chunk = image[offset:offset + DATA_MAX]
+            status, _, received, _, _ = converter.command(
+                CMD_DATA, struct.pack("<I", offset) + chunk, byte1=len(chunk))
+            if status == STATUS_BUSY:
+                continue
+            expect_ok(serial, f"Data at offset {offset}", status)
+            # The converter reports how much it has accepted, so always carry on from there.
+            offset = received
+            if offset * 10 >= next_report * size:
+                log(serial, f"{offset * 100 // size}%")
+                next_report += 1
+
+        status, _, _, _, _ = converter.command(CMD_FINISH)
+        expect_ok(serial, "Finish", status)
+        deadline = time.monotonic() + VERIFY_TIMEOUT_S
+        while True:
+            status, state, _, read_crc, _ = converter.command(CMD_STATUS)
+            if status != STATUS_BUSY:
+                break
+            if time.monotonic() > deadline:
+                raise UpdateError("Timed out verifying")
+            time.sleep(0.05)
+        expect_ok(serial, "Verify", status)
+        if state != STATE_VERIFIED or read_crc != crc:
+            raise UpdateError(f"Verify failed: CRC32 0x{read_crc:08X}, expected 0x{crc:08X}")
+
+        status, _, _, _, _ = converter.command(CMD_SWAP)
+        expect_ok(serial, "Swap", status)
+        log(serial, "Verified, swapping and rebooting")
+        results[serial] = True
+    except (OSError, UpdateError) as error:
+        log(serial, f"ERROR: {error}")
+        try:
+            converter.command(CMD_ABORT)
+        except (OSError, UpdateError):
+            pass
+        results[serial] = False
+    finally:
+        converter.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", nargs="?", help="raw firmware image (build/rp2040-converter.bin)")
+    parser.add_argument("--serial", action="append", default=[],
+                        help="only update the converter with this serial number (repeatable)")
+    parser.add_argument("--list", action="store_true", help="list the converters found and exit")
+    args = parser.parse_args()
+
+    converters = find_converters()
+    if args.serial:
+        converters = [c for c in converters if c.serial in args.serial]
+        missing = set(args.serial) - {c.serial for c in converters}
+        for serial in sorted(missing):
+            print(f"[{serial}] ERROR: not found", file=sys.stderr)
+        if missing:
+            return 1
+
+    if args.list:
+        for converter in converters:
+            print(f"{converter.serial} {converter.path}")
+        return 0
+    if not args.image:
+        parser.error("an image is required unless --list is given")
+    if not converters:
+        print("No converters with Firmware Update support found", file=sys.stderr)
+        return 1
+
+    with open(args.image, "rb") as image_file:
+        image = image_file.read()
+
+    results = {}
+    threads = [threading.Thread(target=update, args=(c, image, results)) for c in converters]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    failed = [serial for serial, ok in results.items() if not ok]
+    print(f"{len(results) - len(failed)} of {len(results)} converters updated")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())